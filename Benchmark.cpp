@@ -0,0 +1,181 @@
+/**
+ * @brief Lequel? benchmarks
+ *
+ * Command line of lequel_bench: picks a mode and parses the options shared by every mode (see
+ * Benchmark.h).
+ */
+
+#include <string.h>
+
+#include <iostream>
+#include <string>
+
+#include "Benchmark.h"
+#include "CommandLine.h"
+
+using namespace std;
+
+// Corpora bundled with the repository and their language codes
+static const char* NATURAL_CORPORA[][2] = {
+    {"resources/corpus/corpus_asturian.txt", "ast"},
+    {"resources/corpus/corpus_catalan.txt", "cat"},
+    {"resources/corpus/corpus_guarani.txt", "grn"},
+};
+
+static const char* CODE_CORPORA[][2] = {
+    {"resources/corpus/corpus_c.txt", "c"},
+    {"resources/corpus/corpus_cpp.txt", "cpp"},
+    {"resources/corpus/corpus_python.txt", "py"},
+};
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [mode] [options] [CORPUS:CODE ...]\n"
+         << "Modes:\n"
+         << "  identify             every algorithm with normalized and real values (default)\n"
+         << "  code                 C/C++/Python: trigrams vs. trigrams plus tokens, held out\n"
+         << "  segment              segmentation of the samples interleaved as paragraphs\n"
+         << "  cache                identification with and without the result cache\n"
+         << "  sampling             files with a foreign header: first lines vs. windows\n"
+         << "  prefilter            noisy samples with and without the trigram filter\n"
+         << "  sketch               corpus profiles: exact counts vs. count-min sketch\n"
+         << "  profiles             size and read time of CSV vs. binary profiles\n"
+         << "  clusters             flat scoring vs. scoring the best language clusters\n"
+         << "  scaling              up to thousands of synthetic languages: tables vs. index\n"
+         << "  parallel             whole text profile: one thread vs. 1 to N threads\n"
+         << "  verify               similarity scores against their definitions\n"
+         << "  deadline             accuracy and latency under decreasing time budgets (us)\n"
+         << "  compressed           plain vs. gzip, zstd and xz files: bytes decoded, speed\n"
+         << "  encoding             UTF-16 and code page files: detection and accuracy\n"
+         << "Options:\n"
+         << "  --sample-lines N     lines per sample (default 10)\n"
+         << "  --repeat N           repetitions (default 5)\n"
+         << "  --lines N            line limit (default 100)\n"
+         << "  --trigrams N         trigram limit (default 100)\n"
+         << "  --window N           segmentation window in trigrams (default 200)\n"
+         << "  --min-span N         shortest segmentation span in trigrams (default 100)\n"
+         << "  --duplicates N       percentage of repeated requests for cache (default 50)\n"
+         << "  --windows N          sampling windows per file (default 16)\n"
+         << "  --window-bytes N     bytes per sampling window (default 4096)\n"
+         << "  --sketch-kb N        count-min sketch size for sketch (default 64)\n"
+         << "  --variants N         maximum variants per language for scaling (default 20)\n"
+         << "  --index-mb N         index memory budget for scaling (default 64)\n"
+         << "  --postings N         posting budget per sample for scaling (default 20000)\n"
+         << "  --parallel-mb N      text size for parallel (default 64)\n"
+         << "  --threads N          most threads for parallel (default 8)\n"
+         << "Without CORPUS:CODE arguments the bundled corpora are used.\n";
+}
+
+int main(int argc, char* argv[]) {
+    benchmarkOptions_t options;
+    int (*runBenchmark)(benchmarkOptions_t&) = runIdentifyBenchmark;
+    const char* (*defaultCorpora)[2] = NATURAL_CORPORA;
+    size_t defaultCorporaCount = sizeof(NATURAL_CORPORA) / sizeof(NATURAL_CORPORA[0]);
+    int first = 1;
+
+    if (argc > 1 && !strcmp(argv[1], "identify"))
+        first = 2;
+    else if (argc > 1 && !strcmp(argv[1], "code")) {
+        runBenchmark = runCodeBenchmark;
+        defaultCorpora = CODE_CORPORA;
+        defaultCorporaCount = sizeof(CODE_CORPORA) / sizeof(CODE_CORPORA[0]);
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "segment")) {
+        runBenchmark = runSegmentBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "cache")) {
+        runBenchmark = runCacheBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "sampling")) {
+        runBenchmark = runSamplingBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "prefilter")) {
+        runBenchmark = runPrefilterBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "sketch")) {
+        runBenchmark = runSketchBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "profiles")) {
+        runBenchmark = runProfilesBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "clusters")) {
+        runBenchmark = runClustersBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "scaling")) {
+        runBenchmark = runScalingBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "parallel")) {
+        runBenchmark = runParallelBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "verify")) {
+        runBenchmark = runVerifyBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "deadline")) {
+        runBenchmark = runDeadlineBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "compressed")) {
+        runBenchmark = runCompressedBenchmark;
+        first = 2;
+    } else if (argc > 1 && !strcmp(argv[1], "encoding")) {
+        runBenchmark = runEncodingBenchmark;
+        first = 2;
+    }
+
+    for (int i = first; i < argc; i++) {
+        string option = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "";
+        bool valid = true;
+
+        if (option == "--sample-lines")
+            valid = parseUnsigned(value, options.sampleLines);
+        else if (option == "--repeat")
+            valid = parseUnsigned(value, options.repetitions);
+        else if (option == "--lines")
+            valid = parseUnsigned(value, options.globalSettings.lineLimit);
+        else if (option == "--trigrams")
+            valid = parseUnsigned(value, options.globalSettings.trigramLimit);
+        else if (option == "--window")
+            valid = parseUnsigned(value, options.segmentationSettings.windowTrigrams);
+        else if (option == "--min-span")
+            valid = parseUnsigned(value, options.segmentationSettings.minSpanTrigrams);
+        else if (option == "--windows")
+            valid = parseUnsigned(value, options.globalSettings.sampleWindows);
+        else if (option == "--window-bytes")
+            valid = parseUnsigned(value, options.globalSettings.sampleWindowBytes);
+        else if (option == "--variants")
+            valid = parseUnsigned(value, options.maxVariants);
+        else if (option == "--index-mb")
+            valid = parseUnsigned(value, options.indexMegabytes);
+        else if (option == "--postings")
+            valid = parseUnsigned(value, options.maxPostings);
+        else if (option == "--parallel-mb")
+            valid = parseUnsigned(value, options.parallelMegabytes);
+        else if (option == "--threads")
+            valid = parseUnsigned(value, options.maxThreads);
+        else if (option == "--sketch-kb")
+            valid = parseUnsigned(value, options.sketchKilobytes);
+        else if (option == "--duplicates")
+            valid = parseUnsigned(value, options.duplicatePercent) &&
+                    options.duplicatePercent < 100;
+        else {
+            size_t separator = option.rfind(':');
+            valid = separator != string::npos && separator > 0 && separator + 1 < option.size();
+            if (valid)
+                options.corpora.push_back(
+                    make_pair(option.substr(0, separator), option.substr(separator + 1)));
+            i--;  // No option value
+        }
+
+        if (!valid) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        i++;  // Skips the option value
+    }
+
+    if (options.corpora.empty()) {
+        for (size_t i = 0; i < defaultCorporaCount; i++)
+            options.corpora.push_back(make_pair(defaultCorpora[i][0], defaultCorpora[i][1]));
+    }
+
+    return runBenchmark(options);
+}
@@ -0,0 +1,99 @@
+/**
+ * @brief Lequel? benchmarks
+ *
+ * Measures accuracy and speed of the identification pipeline on labeled samples, so the
+ * different settings can be compared side by side. lequel_bench runs one mode per invocation
+ * (see Benchmark.cpp); the modes are grouped by area in the Benchmark*.cpp files and share the
+ * options, the model and sample loading and the identification timing declared here.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Lequel.h"
+#include "Segmentation.h"
+
+extern const std::string LANGUAGECODE_NAMES_FILE;
+extern const std::string TRIGRAMS_PATH;
+
+extern const char* ALGORITHM_NAMES[ALGORITHM_COUNT];
+extern const char* VALUE_PROCESSING_NAMES[VALUE_PROCESSING_COUNT];
+
+// benchmarkSample_t: a text and its expected language code
+struct benchmarkSample_t {
+    std::string expectedCode;
+    std::string text;
+};
+
+// benchmarkOptions_t: command line options shared by every benchmark
+struct benchmarkOptions_t {
+    unsigned int sampleLines = 10;  // Lines per sample
+    unsigned int repetitions = 5;
+    settings_t globalSettings;
+    segmentationSettings_t segmentationSettings;
+    unsigned int duplicatePercent = 50;  // Share of repeated requests in the cache benchmark
+    unsigned int sketchKilobytes = 64;   // Count-min sketch size in the sketch benchmark
+    unsigned int parallelMegabytes = 64;  // Size of the text in the parallel benchmark
+    unsigned int maxThreads = 8;          // Most threads tried in the parallel benchmark
+    unsigned int maxVariants = 20;        // Synthetic variants per language (scaling benchmark)
+    unsigned int indexMegabytes = 64;     // Memory budget of the index (scaling benchmark)
+    unsigned int maxPostings = 20000;     // Posting budget per text (scaling benchmark)
+    std::vector<std::pair<std::string, std::string>> corpora;  // Path, expected language code
+};
+
+// identificationTiming_t: accuracy and speed of identifying a set of samples
+struct identificationTiming_t {
+    double accuracy;          // Share of the samples identified correctly
+    double secondsPerSample;  // Mean time per identification
+};
+
+double timestamp_seconds();
+
+bool loadSamples(const benchmarkOptions_t& options,
+                 std::vector<benchmarkSample_t>& samples,
+                 double skipShare = 0.0);
+bool loadModel(LanguageModel& model);
+bool loadModelAndSamples(const benchmarkOptions_t& options,
+                         LanguageModel& model,
+                         std::vector<benchmarkSample_t>& samples);
+
+identificationTiming_t timeIdentification(std::vector<benchmarkSample_t>& samples,
+                                          LanguageModel& model,
+                                          settings_t& settings,
+                                          unsigned int repetitions,
+                                          identificationProgress_t* progress = nullptr);
+
+void keepMostFrequent(TrigramProfile& profile, size_t maxEntries);
+
+// Benchmark modes, by the file that defines them
+
+// BenchmarkIdentify.cpp
+int runIdentifyBenchmark(benchmarkOptions_t& options);
+int runSegmentBenchmark(benchmarkOptions_t& options);
+int runCacheBenchmark(benchmarkOptions_t& options);
+int runPrefilterBenchmark(benchmarkOptions_t& options);
+int runClustersBenchmark(benchmarkOptions_t& options);
+int runScalingBenchmark(benchmarkOptions_t& options);
+int runDeadlineBenchmark(benchmarkOptions_t& options);
+
+// BenchmarkCode.cpp
+int runCodeBenchmark(benchmarkOptions_t& options);
+
+// BenchmarkProfiles.cpp
+int runSketchBenchmark(benchmarkOptions_t& options);
+int runProfilesBenchmark(benchmarkOptions_t& options);
+int runParallelBenchmark(benchmarkOptions_t& options);
+
+// BenchmarkVerify.cpp
+int runVerifyBenchmark(benchmarkOptions_t& options);
+
+// BenchmarkInput.cpp
+int runSamplingBenchmark(benchmarkOptions_t& options);
+int runCompressedBenchmark(benchmarkOptions_t& options);
+int runEncodingBenchmark(benchmarkOptions_t& options);
+
+#endif
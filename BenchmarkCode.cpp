@@ -0,0 +1,169 @@
+/**
+ * @brief Lequel? benchmarks: programming language identification
+ */
+
+#include "Benchmark.h"
+
+#include <stdio.h>
+
+#include <iostream>
+
+#include "CodeFeatures.h"
+#include "ProfileFile.h"
+#include "Text.h"
+
+using namespace std;
+
+const string CODE_NAMES_FILE = "resources/code/languagecode_names_es.csv";
+const string CODE_PROFILES_PATH = "resources/code/";
+
+// Share of every code corpus used to build its profile, the rest is used for testing
+#define CODE_TRAIN_SHARE 0.7
+// Entries kept per code profile, as in resources/code
+#define CODE_PROFILE_SIZE 2000
+
+/**
+ * @name buildCodeModel
+ * @brief Builds code language profiles from the first CODE_TRAIN_SHARE of every corpus.
+ *
+ * @param options The benchmark options
+ * @param features Whether to add source code tokens to the trigrams
+ * @param model The destination model
+ * @return true Succeeded
+ */
+static bool buildCodeModel(const benchmarkOptions_t& options,
+                           featureSetting_t features,
+                           LanguageModel& model) {
+    for (auto& corpus : options.corpora) {
+        Text text;
+        if (!getTextFromFile(corpus.first, text))
+            return false;
+
+        model.languages.push_back(LanguageProfile());
+        LanguageProfile& language = model.languages.back();
+        language.languageCode = corpus.second;
+        model.languageCodeNames[corpus.second] = corpus.second;
+
+        size_t trainLines = (size_t)(CODE_TRAIN_SHARE * text.size());
+        for (auto& line : text) {
+            if (!trainLines--)
+                break;
+
+            addToTrigramProfile(line, language.trigramProfile);
+            if (features == FEATURES_CODE)
+                addToCodeProfile(line, language.trigramProfile);
+        }
+
+        keepMostFrequent(language.trigramProfile, CODE_PROFILE_SIZE);
+        normalizeTrigramProfile(language.trigramProfile);
+    }
+
+    indexLanguageModel(model);
+    return true;
+}
+
+/**
+ * @name loadCodeModel
+ * @brief Loads the code profiles of resources/code as lequel_server --code does, and checks
+ * that every code feature of their files is kept with its count.
+ *
+ * @param model The language model
+ * @return true Succeeded and every feature was kept
+ */
+static bool loadCodeModel(LanguageModel& model) {
+    cout.setstate(ios::failbit);
+    bool loaded = loadLanguagesData(CODE_NAMES_FILE, CODE_PROFILES_PATH, model);
+    cout.clear();
+
+    if (!loaded) {
+        cerr << "Could not load code profiles." << endl;
+        return false;
+    }
+
+    size_t fileFeatures = 0;
+    size_t lostFeatures = 0;
+    for (auto& language : model.languages) {
+        string path = CODE_PROFILES_PATH + language.languageCode + ".csv";
+        TrigramProfile fileProfile;
+        if (!readProfileCSV(path, fileProfile)) {
+            cerr << "Error: could not read " << path << endl;
+            return false;
+        }
+
+        for (auto& entry : fileProfile) {
+            if (!isCodeFeature(entry.first))
+                continue;
+
+            fileFeatures++;
+            auto loadedEntry = language.trigramProfile.find(entry.first);
+            if (loadedEntry == language.trigramProfile.end() ||
+                loadedEntry->second.real != entry.second.real)
+                lostFeatures++;
+        }
+    }
+
+    printf("%zu code features in %s, %zu lost when loading\n\n",
+           fileFeatures,
+           CODE_PROFILES_PATH.c_str(),
+           lostFeatures);
+    return fileFeatures && !lostFeatures;
+}
+
+/**
+ * @name runCodeBenchmark
+ * @brief Compares plain trigram profiles against trigram plus token profiles for
+ * programming languages. Profiles are built from the beginning of every corpus and tested on
+ * the held-out rest. The profiles of resources/code are then loaded from disk and tested the
+ * same way; they were built from the whole corpora, held-out lines included.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runCodeBenchmark(benchmarkOptions_t& options) {
+    vector<benchmarkSample_t> samples;
+    if (!loadSamples(options, samples, CODE_TRAIN_SHARE) || samples.empty()) {
+        cerr << "Error: no samples to benchmark" << endl;
+        return 1;
+    }
+
+    printf("%zu held-out samples of %u lines, %u repetitions, line limit %u, trigram limit %u\n\n",
+           samples.size(),
+           options.sampleLines,
+           options.repetitions,
+           options.globalSettings.lineLimit,
+           options.globalSettings.trigramLimit);
+
+    LanguageModel diskModel;
+    if (!loadCodeModel(diskModel))
+        return 1;
+
+    printf("%-14s %-17s %10s %14s\n", "algorithm", "features", "accuracy", "us/sample");
+
+    // The last row uses the profiles loaded from resources/code
+    static const char* FEATURE_NAMES[] = {"trigrams", "trigrams+tokens", "resources/code"};
+
+    for (int features = FEATURES_TRIGRAMS; features <= FEATURES_CODE + 1; features++) {
+        LanguageModel builtModel;
+        if (features <= FEATURES_CODE &&
+            !buildCodeModel(options, (featureSetting_t)features, builtModel))
+            return 1;
+        LanguageModel& model = features <= FEATURES_CODE ? builtModel : diskModel;
+
+        for (int algorithm = 0; algorithm < ALGORITHM_COUNT; algorithm++) {
+            settings_t settings = options.globalSettings;
+            settings.algorithmSetting = (algorithmSetting_t)algorithm;
+            settings.featureSetting = features == FEATURES_TRIGRAMS ? FEATURES_TRIGRAMS
+                                                                   : FEATURES_CODE;
+
+            identificationTiming_t timing =
+                timeIdentification(samples, model, settings, options.repetitions);
+            printf("%-14s %-17s %9.1f%% %14.2f\n",
+                   ALGORITHM_NAMES[algorithm],
+                   FEATURE_NAMES[features],
+                   100.0 * timing.accuracy,
+                   1e6 * timing.secondsPerSample);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+/**
+ * @brief Lequel? benchmarks: model and sample loading and identification timing shared by
+ * every mode
+ */
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "Text.h"
+
+using namespace std;
+
+const string LANGUAGECODE_NAMES_FILE = "resources/languagecode_names_es.csv";
+const string TRIGRAMS_PATH = "resources/trigrams/";
+
+const char* ALGORITHM_NAMES[ALGORITHM_COUNT] = {"Cosine", "Jaccard", "CavnarTrenkle", "NaiveBayes"};
+const char* VALUE_PROCESSING_NAMES[VALUE_PROCESSING_COUNT] = {"normalized", "real"};
+
+/**
+ * @name timestamp_seconds
+ * @brief Returns a monotonic timestamp.
+ *
+ * @return Seconds since an arbitrary epoch
+ */
+double timestamp_seconds() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @name loadSamples
+ * @brief Splits every corpus into samples of sampleLines non-empty lines.
+ *
+ * @param options The benchmark options
+ * @param samples The destination samples
+ * @param skipShare Share of the lines of each corpus to skip (used for training)
+ * @return true Succeeded
+ * @return false A corpus could not be read
+ */
+bool loadSamples(const benchmarkOptions_t& options,
+                 vector<benchmarkSample_t>& samples,
+                 double skipShare) {
+    for (auto& corpus : options.corpora) {
+        Text text;
+        if (!getTextFromFile(corpus.first, text))
+            return false;
+
+        benchmarkSample_t sample;
+        sample.expectedCode = corpus.second;
+        unsigned int lineCount = 0;
+        size_t skipLines = (size_t)(skipShare * text.size());
+
+        for (auto& line : text) {
+            if (skipLines) {
+                skipLines--;
+                continue;
+            }
+            if (line.empty())
+                continue;
+
+            sample.text += line;
+            sample.text += '\n';
+
+            if (++lineCount == options.sampleLines) {
+                samples.push_back(sample);
+                sample.text.clear();
+                lineCount = 0;
+            }
+        }
+        if (!sample.text.empty())
+            samples.push_back(sample);
+    }
+
+    return true;
+}
+
+/**
+ * @name loadModel
+ * @brief Loads the natural language model, without the loading messages.
+ *
+ * @param model The language model
+ * @return true Succeeded
+ */
+bool loadModel(LanguageModel& model) {
+    cout.setstate(ios::failbit);
+    bool loaded = loadLanguagesData(LANGUAGECODE_NAMES_FILE, TRIGRAMS_PATH, model);
+    cout.clear();
+
+    if (!loaded)
+        cerr << "Could not load trigram data." << endl;
+    return loaded;
+}
+
+/**
+ * @name loadModelAndSamples
+ * @brief Loads the natural language model and the samples of every corpus.
+ *
+ * @param options The benchmark options
+ * @param model The language model
+ * @param samples The destination samples
+ * @return true Succeeded, with at least one sample
+ */
+bool loadModelAndSamples(const benchmarkOptions_t& options,
+                         LanguageModel& model,
+                         vector<benchmarkSample_t>& samples) {
+    if (!loadModel(model))
+        return false;
+
+    if (!loadSamples(options, samples) || samples.empty()) {
+        cerr << "Error: no samples to benchmark" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @name timeIdentification
+ * @brief Identifies every sample repetitions times. Accuracy is taken from the first pass.
+ *
+ * @param samples The samples
+ * @param model The language model
+ * @param settings The identification settings
+ * @param repetitions Passes over the samples
+ * @param progress Optional progress report, accumulated over every identification
+ * @return The accuracy and the mean time per identification
+ */
+identificationTiming_t timeIdentification(vector<benchmarkSample_t>& samples,
+                                          LanguageModel& model,
+                                          settings_t& settings,
+                                          unsigned int repetitions,
+                                          identificationProgress_t* progress) {
+    size_t correct = 0;
+    double start = timestamp_seconds();
+
+    for (unsigned int repetition = 0; repetition < repetitions; repetition++) {
+        for (auto& sample : samples) {
+            string languageCode =
+                identifyLanguageFromClipboard(sample.text, model, settings, progress);
+            if (repetition == 0 && languageCode == sample.expectedCode)
+                correct++;
+        }
+    }
+
+    identificationTiming_t timing;
+    timing.accuracy = (double)correct / samples.size();
+    timing.secondsPerSample = (timestamp_seconds() - start) / (samples.size() * repetitions);
+    return timing;
+}
+
+/**
+ * @name keepMostFrequent
+ * @brief Keeps the most frequent entries of a profile, like the profile CSV files.
+ *
+ * @param profile The profile
+ * @param maxEntries Entries to keep
+ */
+void keepMostFrequent(TrigramProfile& profile, size_t maxEntries) {
+    if (profile.size() <= maxEntries)
+        return;
+
+    vector<pair<float, string>> entries;
+    for (auto& entry : profile)
+        entries.push_back(make_pair(-entry.second.real, entry.first));
+    sort(entries.begin(), entries.end());
+
+    for (size_t i = maxEntries; i < entries.size(); i++)
+        profile.erase(entries[i].second);
+}
@@ -0,0 +1,695 @@
+/**
+ * @brief Lequel? benchmarks: identification of the corpus samples (algorithms, segmentation,
+ * result cache, trigram filter, language clusters, thousands of languages and deadlines)
+ */
+
+#include "Benchmark.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_set>
+
+#include "LanguageClusters.h"
+#include "LanguageIndex.h"
+#include "ResultCache.h"
+#include "TextNormalization.h"
+
+using namespace std;
+
+// Noise tokens (identifiers, URLs, emoji) appended to every line in the prefilter benchmark
+#define PREFILTER_NOISE_TOKENS 4
+
+// Languages returned by the index in the scaling benchmark
+#define SCALING_TOP_K 10
+
+// Time budgets of the deadline benchmark, in microseconds (0: no deadline)
+static const unsigned int DEADLINE_BUDGETS[] = {0, 2000, 1000, 500, 200, 100, 50};
+
+/**
+ * @name runIdentifyBenchmark
+ * @brief Times every algorithm with normalized and real values over the corpus samples.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runIdentifyBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    vector<benchmarkSample_t> samples;
+    if (!loadModelAndSamples(options, model, samples))
+        return 1;
+
+    printf("%zu samples of %u lines, %u repetitions, line limit %u, trigram limit %u\n\n",
+           samples.size(),
+           options.sampleLines,
+           options.repetitions,
+           options.globalSettings.lineLimit,
+           options.globalSettings.trigramLimit);
+    printf("%-14s %-11s %10s %14s\n", "algorithm", "values", "accuracy", "us/sample");
+
+    for (int algorithm = 0; algorithm < ALGORITHM_COUNT; algorithm++) {
+        for (int valueProcessing = 0; valueProcessing < VALUE_PROCESSING_COUNT;
+             valueProcessing++) {
+            settings_t settings = options.globalSettings;
+            settings.algorithmSetting = (algorithmSetting_t)algorithm;
+            settings.valueProcessingSetting = (valueProcessingSetting_t)valueProcessing;
+
+            identificationTiming_t timing =
+                timeIdentification(samples, model, settings, options.repetitions);
+            printf("%-14s %-11s %9.1f%% %14.2f\n",
+                   ALGORITHM_NAMES[algorithm],
+                   VALUE_PROCESSING_NAMES[valueProcessing],
+                   100.0 * timing.accuracy,
+                   1e6 * timing.secondsPerSample);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @name runSegmentBenchmark
+ * @brief Interleaves samples of every corpus into one mixed document (each sample is a
+ * paragraph) and measures how many bytes segmentLanguages labels correctly.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runSegmentBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    vector<benchmarkSample_t> samples;
+    if (!loadModelAndSamples(options, model, samples))
+        return 1;
+
+    // Round robin over the corpora, keeping the expected language of every byte range
+    vector<vector<benchmarkSample_t*>> corpusSamples(options.corpora.size());
+    for (auto& sample : samples) {
+        for (size_t i = 0; i < options.corpora.size(); i++) {
+            if (sample.expectedCode == options.corpora[i].second) {
+                corpusSamples[i].push_back(&sample);
+                break;
+            }
+        }
+    }
+
+    string document;
+    vector<pair<size_t, const string*>> paragraphs;  // Start offset, expected code
+    for (size_t round = 0;; round++) {
+        bool added = false;
+        for (auto& corpus : corpusSamples) {
+            if (round >= corpus.size())
+                continue;
+            paragraphs.push_back(make_pair(document.length(), &corpus[round]->expectedCode));
+            document += corpus[round]->text;
+            added = true;
+        }
+        if (!added)
+            break;
+    }
+
+    LanguageSpans spans;
+    double start = timestamp_seconds();
+    for (unsigned int repetition = 0; repetition < options.repetitions; repetition++)
+        segmentLanguages(document, model, options.segmentationSettings, spans);
+    double elapsed = (timestamp_seconds() - start) / options.repetitions;
+
+    size_t correctBytes = 0;
+    size_t span = 0;
+    for (size_t i = 0; i < paragraphs.size(); i++) {
+        size_t end = i + 1 < paragraphs.size() ? paragraphs[i + 1].first : document.length();
+
+        for (size_t offset = paragraphs[i].first; offset < end;) {
+            while (spans[span].end <= offset)
+                span++;
+
+            size_t overlapEnd = min(end, spans[span].end);
+            if (spans[span].languageCode && *spans[span].languageCode == *paragraphs[i].second)
+                correctBytes += overlapEnd - offset;
+            offset = overlapEnd;
+        }
+    }
+
+    printf("%zu paragraphs of %u lines, %zu bytes, window %u trigrams, minimum span %u\n\n",
+           paragraphs.size(),
+           options.sampleLines,
+           document.length(),
+           options.segmentationSettings.windowTrigrams,
+           options.segmentationSettings.minSpanTrigrams);
+    printf("%-10s %10s %14s %10s\n", "spans", "paragraphs", "bytes correct", "MB/s");
+    printf("%-10zu %10zu %13.1f%% %10.2f\n",
+           spans.size(),
+           paragraphs.size(),
+           100.0 * correctBytes / document.length(),
+           document.length() / elapsed / 1e6);
+
+    return 0;
+}
+
+/**
+ * @name runCacheBenchmark
+ * @brief Identifies a request stream where a share of the requests repeats an earlier one,
+ * with and without the result cache, and checks that different settings give different keys.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runCacheBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    vector<benchmarkSample_t> samples;
+    if (!loadModelAndSamples(options, model, samples))
+        return 1;
+
+    // Deterministic stream: new samples in order, repeats drawn from the ones already sent
+    vector<string*> stream;
+    size_t nextSample = 0;
+    uint32_t random = 12345;
+    size_t requestCount = samples.size() * options.repetitions;
+
+    for (size_t i = 0; i < requestCount; i++) {
+        random = random * 1103515245 + 12345;
+        bool repeat = !stream.empty() && (random >> 16) % 100 < options.duplicatePercent;
+
+        if (repeat)
+            stream.push_back(stream[(random >> 8) % stream.size()]);
+        else
+            stream.push_back(&samples[nextSample++ % samples.size()].text);
+    }
+
+    settings_t settings = options.globalSettings;
+    vector<string> expected(stream.size());
+
+    double start = timestamp_seconds();
+    for (size_t i = 0; i < stream.size(); i++)
+        expected[i] = identifyLanguageFromClipboard(*stream[i], model, settings);
+    double uncachedElapsed = timestamp_seconds() - start;
+
+    resultCache_t cache;
+    initResultCache(cache, samples.size());
+    size_t mismatches = 0;
+
+    start = timestamp_seconds();
+    for (size_t i = 0; i < stream.size(); i++) {
+        string languageCode;
+        resultCacheKey_t key = getResultCacheKey(*stream[i], settings, model);
+
+        if (!lookupResultCache(cache, key, languageCode)) {
+            languageCode = identifyLanguageFromClipboard(*stream[i], model, settings);
+            storeResultCache(cache, key, languageCode);
+        }
+        if (languageCode != expected[i])
+            mismatches++;
+    }
+    double cachedElapsed = timestamp_seconds() - start;
+
+    printf("%zu requests of %u lines, %u%% repeated, cache of %zu entries\n\n",
+           stream.size(),
+           options.sampleLines,
+           options.duplicatePercent,
+           samples.size());
+    printf("%-10s %14s %10s %10s %12s\n", "cache", "us/request", "hits", "misses", "mismatches");
+    printf("%-10s %14.2f %10s %10s %12s\n",
+           "off",
+           1e6 * uncachedElapsed / stream.size(),
+           "-",
+           "-",
+           "-");
+    printf("%-10s %14.2f %10llu %10llu %12zu\n",
+           "on",
+           1e6 * cachedElapsed / stream.size(),
+           (unsigned long long)cache.hits,
+           (unsigned long long)cache.misses,
+           mismatches);
+
+    // Settings that packed into one word would overlap (a large beam and a later generation)
+    static const unsigned int FIELD_VALUES[] = {0, 1, 2, 3, 1u << 20, 1u << 21};
+    unordered_set<resultCacheKey_t, resultCacheKeyHash_t> keys;
+    size_t combinations = 0;
+    for (unsigned int generation : FIELD_VALUES) {
+        for (unsigned int beam : FIELD_VALUES) {
+            for (unsigned int candidates : FIELD_VALUES) {
+                model.generation = generation;
+                settings.clusterBeam = beam;
+                settings.indexCandidates = candidates;
+                keys.insert(getResultCacheKey(samples[0].text, settings, model));
+                combinations++;
+            }
+        }
+    }
+    printf("\n%zu settings and generations, %zu key collisions\n",
+           combinations,
+           combinations - keys.size());
+
+    return 0;
+}
+
+/**
+ * @name appendNoiseToken
+ * @brief Appends a random identifier, URL or emoji, the kind of token that appears in real
+ * text but in no language profile.
+ *
+ * @param text The destination text
+ * @param random State of the random generator
+ */
+static void appendNoiseToken(string& text, uint32_t& random) {
+    static const char* EMOJI[] = {"\xF0\x9F\x98\x80", "\xF0\x9F\x91\x8D", "\xF0\x9F\x94\xA5"};
+
+    random = random * 1103515245 + 12345;
+    unsigned int kind = (random >> 16) % 3;
+    unsigned int length = 6 + (random >> 8) % 6;
+
+    string token;
+    for (unsigned int i = 0; i < length; i++) {
+        random = random * 1103515245 + 12345;
+        token += (char)('a' + (random >> 16) % 26);
+    }
+
+    text += ' ';
+    if (kind == 0)
+        text += token.substr(0, length / 2) + "_" + token.substr(length / 2);
+    else if (kind == 1)
+        text += "https://" + token + ".io/" + token.substr(length / 2);
+    else
+        text += token + EMOJI[(random >> 8) % 3];
+}
+
+/**
+ * @name runPrefilterBenchmark
+ * @brief Adds noise tokens to every line of the samples and identifies them counting the
+ * trigrams in the model vocabulary, and without it with and without the trigram filter.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runPrefilterBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    vector<benchmarkSample_t> samples;
+    if (!loadModelAndSamples(options, model, samples))
+        return 1;
+
+    uint32_t random = 12345;
+    size_t trigramCount = 0;
+    size_t rejectedCount = 0;
+
+    for (auto& sample : samples) {
+        string noisy;
+        size_t start = 0;
+        while (start < sample.text.length()) {
+            size_t end = sample.text.find('\n', start);
+            noisy.append(sample.text, start, end - start);
+            for (int i = 0; i < PREFILTER_NOISE_TOKENS; i++)
+                appendNoiseToken(noisy, random);
+            noisy += '\n';
+            start = end + 1;
+        }
+        sample.text = noisy;
+
+        forEachTrigram(sample.text, 0, sample.text.length(), [&](const string& trigram, size_t) {
+            trigramCount++;
+            if (!mayContain(model.trigramFilter, trigram))
+                rejectedCount++;
+            return true;
+        });
+    }
+
+    printf("%zu samples of %u lines, %d noise tokens per line, %.1f%% of the trigrams rejected "
+           "by a %zu KB filter\n\n",
+           samples.size(),
+           options.sampleLines,
+           PREFILTER_NOISE_TOKENS,
+           100.0 * rejectedCount / trigramCount,
+           model.trigramFilter.words.size() * sizeof(uint64_t) / 1024);
+    printf("%-10s %-14s %-12s %10s %14s\n", "lookup", "algorithm", "values", "accuracy",
+           "us/sample");
+
+    // Without a vocabulary, text profiles fall back to a table guarded by the filter
+    static const char* LOOKUP_NAMES[] = {"vocabulary", "filter", "none"};
+    perfectHash_t vocabulary = model.trigramHash;
+    bloomFilter_t filter = model.trigramFilter;
+    for (int lookup = 0; lookup < 3; lookup++) {
+        model.trigramHash = lookup == 0 ? vocabulary : perfectHash_t();
+        model.trigramFilter = lookup == 2 ? bloomFilter_t() : filter;
+
+        for (int algorithm = 0; algorithm < ALGORITHM_COUNT; algorithm++) {
+            for (int values = 0; values < VALUE_PROCESSING_COUNT; values++) {
+                settings_t settings = options.globalSettings;
+                settings.algorithmSetting = (algorithmSetting_t)algorithm;
+                settings.valueProcessingSetting = (valueProcessingSetting_t)values;
+
+                identificationTiming_t timing =
+                    timeIdentification(samples, model, settings, options.repetitions);
+                printf("%-10s %-14s %-12s %9.1f%% %14.2f\n",
+                       LOOKUP_NAMES[lookup],
+                       ALGORITHM_NAMES[algorithm],
+                       VALUE_PROCESSING_NAMES[values],
+                       100.0 * timing.accuracy,
+                       1e6 * timing.secondsPerSample);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @name runClustersBenchmark
+ * @brief Lists the language clusters of the Latin sub-model and compares flat scoring with
+ * scoring the best 1 to 3 clusters, and the best 5 to 20 languages of the language index.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runClustersBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    vector<benchmarkSample_t> samples;
+    if (!loadModelAndSamples(options, model, samples))
+        return 1;
+
+    double start = timestamp_seconds();
+    clusterLanguageModel(model);
+    double clusterElapsed = timestamp_seconds() - start;
+
+    LanguageCandidates& allLanguages = model.scriptLanguages[SCRIPT_UNKNOWN];
+    LanguageClusters& clusters = model.scriptClusters[SCRIPT_LATIN];
+    printf("%zu Latin script languages in %zu clusters (built in %.1f ms):\n",
+           model.scriptLanguages[SCRIPT_LATIN].size(),
+           clusters.size(),
+           1e3 * clusterElapsed);
+    for (auto& cluster : clusters) {
+        if (cluster.members.size() == 1)
+            continue;
+
+        printf(" ");
+        for (unsigned int member : cluster.members)
+            printf(" %s", allLanguages[member]->languageCode.c_str());
+        printf("\n");
+    }
+
+    printf("\n%zu samples of %u lines, %u repetitions, trigram limit %u\n\n",
+           samples.size(),
+           options.sampleLines,
+           options.repetitions,
+           options.globalSettings.trigramLimit);
+    printf("%-10s %10s %14s %16s\n", "scored", "accuracy", "us/sample", "profiles/sample");
+
+    static const unsigned int INDEX_CANDIDATES[] = {0, 0, 0, 0, 5, 10, 20};
+    for (unsigned int row = 0; row < sizeof(INDEX_CANDIDATES) / sizeof(unsigned int); row++) {
+        settings_t settings = options.globalSettings;
+        settings.indexCandidates = INDEX_CANDIDATES[row];
+        settings.clusterBeam = settings.indexCandidates ? 0 : row;
+
+        string label = settings.indexCandidates
+                           ? "index " + to_string(settings.indexCandidates)
+                           : (row ? "clusters " + to_string(row) : "all");
+
+        // Index candidates are not counted as profiles scored: they are ranked in one pass
+        identificationProgress_t progress;
+        identificationTiming_t timing =
+            timeIdentification(samples, model, settings, options.repetitions, &progress);
+        printf("%-10s %9.1f%% %14.2f %16.1f\n",
+               label.c_str(),
+               100.0 * timing.accuracy,
+               1e6 * timing.secondsPerSample,
+               (double)progress.profilesScored / (samples.size() * options.repetitions));
+    }
+
+    return 0;
+}
+
+/**
+ * @name addVariantProfiles
+ * @brief Adds synthetic variants of every language of a model, like dialects or tuned
+ * models: weights are perturbed, 10% of the entries dropped and 5% borrowed from another
+ * language. Variant codes are "<code>~<n>".
+ *
+ * @param model The model, its own languages are kept as variant 0
+ * @param variants Variants per language, including the original
+ * @param languages The destination languages (pointing into model.languages and variants)
+ * @param variantProfiles Storage for the variants
+ */
+static void addVariantProfiles(LanguageModel& model,
+                               unsigned int variants,
+                               LanguageCandidates& languages,
+                               LanguageProfiles& variantProfiles) {
+    LanguageCandidates& originals = model.scriptLanguages[SCRIPT_UNKNOWN];
+    mt19937 generator(12345);
+    normal_distribution<float> noise(0.0f, 0.5f);
+    uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    languages = originals;
+    for (unsigned int variant = 1; variant < variants; variant++) {
+        for (auto original : originals) {
+            variantProfiles.push_back(LanguageProfile());
+            LanguageProfile& language = variantProfiles.back();
+            language.languageCode = original->languageCode + "~" + to_string(variant);
+
+            LanguageProfile* donor = originals[generator() % originals.size()];
+            for (auto& entry : original->trigramProfile) {
+                if (uniform(generator) < 0.1f)
+                    continue;
+                language.trigramProfile[entry.first].real =
+                    entry.second.real * expf(noise(generator));
+            }
+            for (auto& entry : donor->trigramProfile) {
+                if (uniform(generator) < 0.05f)
+                    language.trigramProfile[entry.first].real += entry.second.real;
+            }
+
+            normalizeTrigramProfile(language.trigramProfile);
+            aggregateTrigramProfile(language.trigramProfile, language.aggregates);
+            languages.push_back(&language);
+        }
+    }
+}
+
+/**
+ * @name getBaseCode
+ * @brief Removes the variant suffix of a language code.
+ *
+ * @param languageCode The language code
+ * @return The code of the language the variant was made from
+ */
+static string getBaseCode(const string& languageCode) {
+    return languageCode.substr(0, languageCode.find('~'));
+}
+
+/**
+ * @name runScalingBenchmark
+ * @brief Grows the number of languages with synthetic variants and compares scoring every
+ * hash table profile with the compressed index, scoring every posting or a posting budget,
+ * and with scoring exactly only the best languages of the index (as indexCandidates does).
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runScalingBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    vector<benchmarkSample_t> samples;
+    if (!loadModelAndSamples(options, model, samples))
+        return 1;
+
+    bloomFilter_t noFilter;
+    vector<textProfile_t> profiles(samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        settings_t settings = options.globalSettings;
+        buildTextProfile(samples[i].text, profiles[i], noFilter, settings);
+    }
+
+    printf("%zu samples, index budget %u MB, posting budget %u, top %d\n\n",
+           samples.size(),
+           options.indexMegabytes,
+           options.maxPostings,
+           SCALING_TOP_K);
+    printf("%-9s %-8s %10s %10s %10s %10s\n",
+           "languages",
+           "scoring",
+           "memory MB",
+           "build ms",
+           "accuracy",
+           "us/sample");
+
+    static const unsigned int VARIANTS[] = {1, 5, 10, 20, 40};
+    for (unsigned int variants : VARIANTS) {
+        if (variants > options.maxVariants)
+            break;
+
+        LanguageCandidates languages;
+        LanguageProfiles variantProfiles;
+        addVariantProfiles(model, variants, languages, variantProfiles);
+
+        // Every hash table profile
+        size_t nodeBytes = sizeof(void*) + sizeof(pair<const string, value_t>) + sizeof(size_t);
+        size_t flatBytes = 0;
+        for (auto language : languages) {
+            flatBytes += language->trigramProfile.bucket_count() * sizeof(void*) +
+                         language->trigramProfile.size() * nodeBytes;
+        }
+
+        size_t correct = 0;
+        double start = timestamp_seconds();
+        for (size_t i = 0; i < samples.size(); i++) {
+            float best = 0.0f;
+            const string* bestCode = nullptr;
+
+            float textInvNorm = getTextInvNorm(profiles[i]);
+            for (auto language : languages) {
+                float dotProduct = 0.0f;
+                for (auto& entry : profiles[i].trigrams) {
+                    auto languageEntry = language->trigramProfile.find(entry.first);
+                    if (languageEntry != language->trigramProfile.end())
+                        dotProduct += entry.second.real * languageEntry->second.normalized;
+                }
+                dotProduct *= textInvNorm;
+                if (dotProduct > best) {
+                    best = dotProduct;
+                    bestCode = &language->languageCode;
+                }
+            }
+            if (bestCode && getBaseCode(*bestCode) == samples[i].expectedCode)
+                correct++;
+        }
+        double elapsed = timestamp_seconds() - start;
+
+        printf("%-9zu %-8s %10.1f %10s %9.1f%% %10.1f\n",
+               languages.size(),
+               "tables",
+               flatBytes / 1e6,
+               "-",
+               100.0 * correct / samples.size(),
+               1e6 * elapsed / samples.size());
+
+        // Compressed index
+        languageIndex_t index;
+        start = timestamp_seconds();
+        buildLanguageIndex(languages, (size_t)options.indexMegabytes << 20, index);
+        double buildElapsed = timestamp_seconds() - start;
+
+        for (int budget = 0; budget < 2; budget++) {
+            vector<languageScore_t> ranking;
+            correct = 0;
+            start = timestamp_seconds();
+            for (size_t i = 0; i < samples.size(); i++) {
+                rankLanguages(index, profiles[i], budget ? options.maxPostings : 0,
+                              SCALING_TOP_K, ranking);
+                if (!ranking.empty() &&
+                    getBaseCode(languages[ranking[0].language]->languageCode) ==
+                        samples[i].expectedCode)
+                    correct++;
+            }
+            elapsed = timestamp_seconds() - start;
+
+            printf("%-9zu %-8s %10.1f %10.1f %9.1f%% %10.1f\n",
+                   languages.size(),
+                   budget ? "budget" : "index",
+                   getLanguageIndexBytes(index) / 1e6,
+                   1e3 * buildElapsed,
+                   100.0 * correct / samples.size(),
+                   1e6 * elapsed / samples.size());
+        }
+
+        // Best languages of the index, then scored exactly
+        vector<languageScore_t> ranking;
+        correct = 0;
+        start = timestamp_seconds();
+        for (size_t i = 0; i < samples.size(); i++) {
+            rankLanguages(index, profiles[i], 0, SCALING_TOP_K, ranking);
+
+            float best = 0.0f;
+            const string* bestCode = nullptr;
+            for (auto& entry : ranking) {
+                const LanguageProfile& language = *languages[entry.language];
+                float value = getSimilarityScore(profiles[i], language, options.globalSettings);
+                if (value > best) {
+                    best = value;
+                    bestCode = &language.languageCode;
+                }
+            }
+            if (bestCode && getBaseCode(*bestCode) == samples[i].expectedCode)
+                correct++;
+        }
+        elapsed = timestamp_seconds() - start;
+
+        printf("%-9zu %-8s %10.1f %10.1f %9.1f%% %10.1f\n",
+               languages.size(),
+               "rescored",
+               getLanguageIndexBytes(index) / 1e6,
+               1e3 * buildElapsed,
+               100.0 * correct / samples.size(),
+               1e6 * elapsed / samples.size());
+    }
+
+    return 0;
+}
+
+/**
+ * @name runDeadlineBenchmark
+ * @brief Identifies the samples with cosine and Naive Bayes under decreasing time budgets and
+ * reports the accuracy, the share of partial results and the latency.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runDeadlineBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    vector<benchmarkSample_t> samples;
+    if (!loadModelAndSamples(options, model, samples))
+        return 1;
+
+    printf("%zu samples of %u lines, %u repetitions, line limit %u, trigram limit %u\n\n",
+           samples.size(),
+           options.sampleLines,
+           options.repetitions,
+           options.globalSettings.lineLimit,
+           options.globalSettings.trigramLimit);
+    printf("%-14s %8s %10s %9s %14s %12s\n",
+           "algorithm",
+           "budget",
+           "accuracy",
+           "partial",
+           "us/sample",
+           "max us");
+
+    algorithmSetting_t algorithms[] = {ALGORITHM_COSINE, ALGORITHM_NAIVE_BAYES};
+    for (algorithmSetting_t algorithm : algorithms) {
+        settings_t settings = options.globalSettings;
+        settings.algorithmSetting = algorithm;
+
+        for (unsigned int budget : DEADLINE_BUDGETS) {
+            size_t correct = 0;
+            size_t partial = 0;
+            double total = 0.0;
+            double slowest = 0.0;
+
+            for (unsigned int repetition = 0; repetition < options.repetitions; repetition++) {
+                for (auto& sample : samples) {
+                    identificationProgress_t progress;
+                    double start = timestamp_seconds();
+                    if (budget)
+                        setIdentificationBudget(progress, budget);
+
+                    string languageCode =
+                        identifyLanguageFromClipboard(sample.text, model, settings, &progress);
+
+                    double elapsed = timestamp_seconds() - start;
+                    total += elapsed;
+                    slowest = max(slowest, elapsed);
+                    if (repetition == 0 && languageCode == sample.expectedCode)
+                        correct++;
+                    if (repetition == 0 && progress.partial)
+                        partial++;
+                }
+            }
+
+            printf("%-14s %8s %9.1f%% %8.1f%% %14.2f %12.1f\n",
+                   ALGORITHM_NAMES[algorithm],
+                   budget ? to_string(budget).c_str() : "none",
+                   100.0 * correct / samples.size(),
+                   100.0 * partial / samples.size(),
+                   1e6 * total / (samples.size() * options.repetitions),
+                   1e6 * slowest);
+        }
+    }
+
+    return 0;
+}
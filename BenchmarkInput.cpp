@@ -0,0 +1,521 @@
+/**
+ * @brief Lequel? benchmarks: reading files (sampling windows, compressed files and text
+ * encodings)
+ */
+
+#include "Benchmark.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#ifdef LEQUEL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef LEQUEL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef LEQUEL_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#include "InputStream.h"
+#include "Text.h"
+#include "TextEncoding.h"
+#include "UnicodeScript.h"
+
+using namespace std;
+
+// Lines of another corpus prepended to every corpus in the sampling benchmark
+#define SAMPLING_HEADER_LINES 150
+// The corpus is repeated after the header until the file reaches this size
+#define SAMPLING_FILE_BYTES (1 << 20)
+#define SAMPLING_FILE "lequel_bench_sampling.tmp"
+
+// Size of every file of the compressed benchmark (the corpus repeated)
+#define COMPRESSED_FILE_BYTES (1 << 22)
+#define COMPRESSED_FILE "lequel_bench_compressed.tmp"
+
+// Largest share of the non-ASCII characters of a corpus a code page may lack to be tested
+#define ENCODING_UNMAPPED_SHARE 0.01
+#define ENCODING_FILE "lequel_bench_encoding.tmp"
+
+/**
+ * @name runSamplingBenchmark
+ * @brief Prepends a header in another language to every corpus (like a license header),
+ * repeats the corpus up to SAMPLING_FILE_BYTES and identifies the resulting file reading its
+ * first lines, evenly spaced windows, random windows and the whole file.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runSamplingBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    if (!loadModel(model))
+        return 1;
+
+    vector<Text> texts(options.corpora.size());
+    for (size_t i = 0; i < options.corpora.size(); i++) {
+        if (!getTextFromFile(options.corpora[i].first, texts[i])) {
+            cerr << "Error: could not read " << options.corpora[i].first << endl;
+            return 1;
+        }
+    }
+
+    static const char* SAMPLING_NAMES[] = {
+        "first lines", "even windows", "random windows", "whole file"};
+    size_t correct[4] = {0, 0, 0, 0};
+    double elapsed[4] = {0, 0, 0, 0};
+
+    for (size_t body = 0; body < texts.size(); body++) {
+        // The header comes from the next corpus
+        Text& header = texts[(body + 1) % texts.size()];
+        Text file;
+        for (auto& line : header) {
+            if (file.size() == SAMPLING_HEADER_LINES)
+                break;
+            file.push_back(line);
+        }
+
+        size_t fileBytes = 0;
+        while (fileBytes < SAMPLING_FILE_BYTES) {
+            for (auto& line : texts[body]) {
+                file.push_back(line);
+                fileBytes += line.size() + 1;
+            }
+        }
+
+        if (!writeTextToFile(file, SAMPLING_FILE)) {
+            cerr << "Error: could not write " << SAMPLING_FILE << endl;
+            return 1;
+        }
+
+        for (int sampling = SAMPLING_NONE; sampling <= SAMPLING_FULL; sampling++) {
+            settings_t settings = options.globalSettings;
+            settings.samplingSetting = (samplingSetting_t)sampling;
+            string path = SAMPLING_FILE;
+
+            double start = timestamp_seconds();
+            for (unsigned int repetition = 0; repetition < options.repetitions; repetition++) {
+                string languageCode = identifyLanguageFromPath(&path[0], model, settings);
+                if (repetition == 0 && languageCode == options.corpora[body].second)
+                    correct[sampling]++;
+            }
+            elapsed[sampling] += timestamp_seconds() - start;
+        }
+    }
+    remove(SAMPLING_FILE);
+
+    printf("%zu files of %d KB with a %d line foreign header, %u windows of %u bytes\n\n",
+           texts.size(),
+           SAMPLING_FILE_BYTES / 1024,
+           SAMPLING_HEADER_LINES,
+           options.globalSettings.sampleWindows,
+           options.globalSettings.sampleWindowBytes);
+    printf("%-16s %10s %14s\n", "read", "accuracy", "us/file");
+    for (int sampling = SAMPLING_NONE; sampling <= SAMPLING_FULL; sampling++)
+        printf("%-16s %9.1f%% %14.2f\n",
+               SAMPLING_NAMES[sampling],
+               100.0 * correct[sampling] / texts.size(),
+               1e6 * elapsed[sampling] / (texts.size() * options.repetitions));
+
+    return 0;
+}
+
+/**
+ * @name writeCompressedFile
+ * @brief Writes some data to a file, compressed.
+ *
+ * @param data The data
+ * @param compression The compression format
+ * @param path The file path
+ * @return false if the format is not supported by this build or the file could not be written
+ */
+static bool writeCompressedFile(const string& data, compression_t compression, const string& path) {
+    string output;
+
+    switch (compression) {
+        case COMPRESSION_NONE:
+            output = data;
+            break;
+#ifdef LEQUEL_HAVE_ZLIB
+        case COMPRESSION_GZIP: {
+            gzFile file = gzopen(path.c_str(), "wb6");
+            if (!file)
+                return false;
+            bool isWritten = gzwrite(file, data.data(), (unsigned int)data.size()) ==
+                             (int)data.size();
+            return gzclose(file) == Z_OK && isWritten;
+        }
+#endif
+#ifdef LEQUEL_HAVE_ZSTD
+        case COMPRESSION_ZSTD: {
+            output.resize(ZSTD_compressBound(data.size()));
+            size_t size = ZSTD_compress(&output[0], output.size(), data.data(), data.size(), 3);
+            if (ZSTD_isError(size))
+                return false;
+            output.resize(size);
+            break;
+        }
+#endif
+#ifdef LEQUEL_HAVE_LZMA
+        case COMPRESSION_XZ: {
+            output.resize(lzma_stream_buffer_bound(data.size()));
+            size_t size = 0;
+            if (lzma_easy_buffer_encode(6,
+                                        LZMA_CHECK_CRC64,
+                                        nullptr,
+                                        (const uint8_t*)data.data(),
+                                        data.size(),
+                                        (uint8_t*)&output[0],
+                                        &size,
+                                        output.size()) != LZMA_OK)
+                return false;
+            output.resize(size);
+            break;
+        }
+#endif
+        default:
+            return false;
+    }
+
+    ofstream file(path, ios::binary);
+    file.write(output.data(), output.size());
+
+    return !file.fail();
+}
+
+/**
+ * @name runCompressedBenchmark
+ * @brief Repeats every corpus up to COMPRESSED_FILE_BYTES, writes it plain, gzip, zstd and xz
+ * compressed, and identifies each file from its first lines and as a whole. Reports how much
+ * of the file the first lines decode, and checks that every format reads back the same text.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runCompressedBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    if (!loadModel(model))
+        return 1;
+
+    vector<string> files(options.corpora.size());
+    for (size_t i = 0; i < options.corpora.size(); i++) {
+        Text text;
+        if (!getTextFromFile(options.corpora[i].first, text)) {
+            cerr << "Error: could not read " << options.corpora[i].first << endl;
+            return 1;
+        }
+
+        while (files[i].size() < COMPRESSED_FILE_BYTES) {
+            for (auto& line : text)
+                files[i] += line + '\n';
+        }
+    }
+
+    printf("%zu files of %d KB, line limit %u, %u repetitions\n\n",
+           files.size(),
+           COMPRESSED_FILE_BYTES / 1024,
+           options.globalSettings.lineLimit,
+           options.repetitions);
+    printf("%-8s %10s %12s %12s %10s %10s %10s\n",
+           "format",
+           "file KB",
+           "decoded KB",
+           "us/file",
+           "whole ms",
+           "accuracy",
+           "same text");
+
+    compression_t formats[] = {
+        COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_ZSTD, COMPRESSION_XZ};
+    size_t failures = 0;
+
+    for (compression_t compression : formats) {
+        if (!isCompressionSupported(compression)) {
+            printf("%-8s not supported by this build\n", getCompressionName(compression));
+            continue;
+        }
+
+        size_t fileBytes = 0;
+        size_t decodedBytes = 0;
+        double firstElapsed = 0.0;
+        double wholeElapsed = 0.0;
+        size_t correct = 0;
+        size_t sameText = 0;
+
+        for (size_t i = 0; i < files.size(); i++) {
+            string path = COMPRESSED_FILE;
+            if (!writeCompressedFile(files[i], compression, path)) {
+                cerr << "Error: could not write " << path << endl;
+                return 1;
+            }
+
+            // Reads the file as identification does: the script detection bytes, then lines
+            inputStream_t stream;
+            string line;
+            if (!openInputStream(path.c_str(), stream))
+                return 1;
+            peekInputStream(stream, SCRIPT_DETECTION_BYTES, line);
+            for (unsigned int counter = 0; counter < options.globalSettings.lineLimit &&
+                                           readInputLine(stream, line);
+                 counter++)
+                ;
+            fileBytes += stream.fileSize;
+            decodedBytes += stream.decodedBytes;
+
+            settings_t settings = options.globalSettings;
+            string languageCode;
+            double start = timestamp_seconds();
+            for (unsigned int repetition = 0; repetition < options.repetitions; repetition++)
+                languageCode = identifyLanguageFromPath(&path[0], model, settings);
+            firstElapsed += timestamp_seconds() - start;
+
+            settings.samplingSetting = SAMPLING_FULL;
+            start = timestamp_seconds();
+            string wholeLanguageCode = identifyLanguageFromPath(&path[0], model, settings);
+            wholeElapsed += timestamp_seconds() - start;
+
+            if (languageCode == options.corpora[i].second &&
+                wholeLanguageCode == options.corpora[i].second)
+                correct++;
+
+            Text decoded;
+            Text expected;
+            getTextFromString(files[i], expected);
+            if (getTextFromFile(path, decoded) && decoded == expected)
+                sameText++;
+            else
+                failures++;
+        }
+        remove(COMPRESSED_FILE);
+
+        printf("%-8s %10zu %12.1f %12.2f %10.2f %9.1f%% %10s\n",
+               getCompressionName(compression),
+               fileBytes / 1024 / files.size(),
+               decodedBytes / 1024.0 / files.size(),
+               1e6 * firstElapsed / (files.size() * options.repetitions),
+               1e3 * wholeElapsed / files.size(),
+               100.0 * correct / files.size(),
+               sameText == files.size() ? "yes" : "NO");
+    }
+
+    return failures ? 1 : 0;
+}
+
+// encodingCase_t: an encoding tested by the encoding benchmark
+struct encodingCase_t {
+    encoding_t encoding;
+    bool hasByteOrderMark;
+};
+
+/**
+ * @name decodeCharacter
+ * @brief Decodes a UTF-8 character.
+ *
+ * @param text The UTF-8 text
+ * @param position Byte offset of the character
+ * @param length Destination for the length of the character in bytes
+ * @return Its codepoint
+ */
+static uint32_t decodeCharacter(const string& text, size_t position, size_t& length) {
+    unsigned char lead = (unsigned char)text[position];
+    length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+    uint32_t codepoint = length == 1 ? lead : lead & (0x7F >> length);
+
+    for (size_t i = 1; i < length && position + i < text.length(); i++)
+        codepoint = codepoint << 6 | ((unsigned char)text[position + i] & 0x3F);
+
+    return codepoint;
+}
+
+/**
+ * @name encodeText
+ * @brief Converts a UTF-8 text to another encoding. Characters the encoding lacks become '?'.
+ *
+ * @param text The UTF-8 text
+ * @param encodingCase The encoding and whether a byte order mark is written
+ * @param output The destination text
+ * @return Share of the non-ASCII characters the encoding lacks
+ */
+static double encodeText(const string& text, const encodingCase_t& encodingCase, string& output) {
+    encoding_t encoding = encodingCase.encoding;
+    unordered_map<uint32_t, char> codePage;  // Codepoint -> byte
+    if (encoding >= ENCODING_WINDOWS1250) {
+        for (int byte = 0x80; byte < 0x100; byte++) {
+            string character;
+            size_t length;
+            transcodeText(string(1, (char)byte), encoding, character);
+            codePage[decodeCharacter(character, 0, length)] = (char)byte;
+        }
+    }
+
+    output.clear();
+    if (encodingCase.hasByteOrderMark) {
+        if (encoding == ENCODING_UTF8)
+            output = "\xEF\xBB\xBF";
+        else if (encoding == ENCODING_UTF16LE)
+            output = "\xFF\xFE";
+        else if (encoding == ENCODING_UTF16BE)
+            output = "\xFE\xFF";
+    }
+
+    size_t nonASCII = 0;
+    size_t unmapped = 0;
+    for (size_t position = 0; position < text.length();) {
+        size_t length;
+        uint32_t codepoint = decodeCharacter(text, position, length);
+        nonASCII += length > 1;
+
+        if (encoding == ENCODING_UTF8)
+            output.append(text, position, length);
+        else if (encoding == ENCODING_UTF16LE || encoding == ENCODING_UTF16BE) {
+            uint32_t units[2] = {codepoint, 0};
+            size_t unitCount = 1;
+            if (codepoint >= 0x10000) {
+                units[0] = 0xD800 + ((codepoint - 0x10000) >> 10);
+                units[1] = 0xDC00 + ((codepoint - 0x10000) & 0x3FF);
+                unitCount = 2;
+            }
+            for (size_t i = 0; i < unitCount; i++) {
+                char high = (char)(units[i] >> 8);
+                char low = (char)(units[i] & 0xFF);
+                output += encoding == ENCODING_UTF16LE ? low : high;
+                output += encoding == ENCODING_UTF16LE ? high : low;
+            }
+        } else if (codepoint < 0x80)
+            output += (char)codepoint;
+        else {
+            auto byte = codePage.find(codepoint);
+            unmapped += byte == codePage.end();
+            output += byte == codePage.end() ? '?' : byte->second;
+        }
+
+        position += length;
+    }
+
+    return nonASCII ? (double)unmapped / nonASCII : 0.0;
+}
+
+/**
+ * @name runEncodingBenchmark
+ * @brief Writes every corpus in UTF-8, UTF-16 (with and without byte order mark) and the
+ * single-byte code pages that can represent it, and identifies every file from its first
+ * lines. Reports how often the encoding is detected and the language identified, and the cost
+ * of detecting UTF-8 text.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runEncodingBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    if (!loadModel(model))
+        return 1;
+
+    vector<string> corpora(options.corpora.size());
+    for (size_t i = 0; i < options.corpora.size(); i++) {
+        Text text;
+        if (!getTextFromFile(options.corpora[i].first, text)) {
+            cerr << "Error: could not read " << options.corpora[i].first << endl;
+            return 1;
+        }
+        for (auto& line : text)
+            corpora[i] += line + '\n';
+    }
+
+    static const encodingCase_t ENCODING_CASES[] = {
+        {ENCODING_UTF8, false},
+        {ENCODING_UTF8, true},
+        {ENCODING_UTF16LE, true},
+        {ENCODING_UTF16LE, false},
+        {ENCODING_UTF16BE, true},
+        {ENCODING_UTF16BE, false},
+        {ENCODING_WINDOWS1252, false},
+        {ENCODING_WINDOWS1250, false},
+        {ENCODING_WINDOWS1251, false},
+        {ENCODING_KOI8R, false},
+    };
+
+    printf("%zu corpora, line limit %u, %u repetitions\n\n",
+           corpora.size(),
+           options.globalSettings.lineLimit,
+           options.repetitions);
+    printf("%-14s %4s %7s %10s %10s %12s\n",
+           "encoding",
+           "BOM",
+           "files",
+           "detected",
+           "accuracy",
+           "us/file");
+
+    for (const encodingCase_t& encodingCase : ENCODING_CASES) {
+        size_t fileCount = 0;
+        size_t detected = 0;
+        size_t correct = 0;
+        double elapsed = 0.0;
+
+        for (size_t i = 0; i < corpora.size(); i++) {
+            string file;
+            if (encodeText(corpora[i], encodingCase, file) > ENCODING_UNMAPPED_SHARE)
+                continue;  // The code page can't write this language
+
+            ofstream output(ENCODING_FILE, ios::binary);
+            output.write(file.data(), file.size());
+            output.close();
+            if (output.fail()) {
+                cerr << "Error: could not write " << ENCODING_FILE << endl;
+                return 1;
+            }
+
+            size_t sampleLength = min(file.length(), (size_t)SCRIPT_DETECTION_BYTES);
+            fileCount++;
+            detected += detectEncoding(file.data(), sampleLength, &model.trigramFilter) ==
+                        encodingCase.encoding;
+
+            settings_t settings = options.globalSettings;
+            string path = ENCODING_FILE;
+            string languageCode;
+            double start = timestamp_seconds();
+            for (unsigned int repetition = 0; repetition < options.repetitions; repetition++)
+                languageCode = identifyLanguageFromPath(&path[0], model, settings);
+            elapsed += timestamp_seconds() - start;
+            correct += languageCode == options.corpora[i].second;
+        }
+        remove(ENCODING_FILE);
+
+        if (!fileCount) {
+            printf("%-14s %4s %7s\n",
+                   getEncodingName(encodingCase.encoding),
+                   encodingCase.hasByteOrderMark ? "yes" : "no",
+                   "-");
+            continue;
+        }
+        printf("%-14s %4s %7zu %9.1f%% %9.1f%% %12.2f\n",
+               getEncodingName(encodingCase.encoding),
+               encodingCase.hasByteOrderMark ? "yes" : "no",
+               fileCount,
+               100.0 * detected / fileCount,
+               100.0 * correct / fileCount,
+               1e6 * elapsed / (fileCount * options.repetitions));
+    }
+
+    // Cost of the check every UTF-8 text goes through
+    size_t checks = 0;
+    double start = timestamp_seconds();
+    for (unsigned int repetition = 0; repetition < 1000 * options.repetitions; repetition++) {
+        for (auto& corpus : corpora) {
+            size_t sampleLength = min(corpus.length(), (size_t)SCRIPT_DETECTION_BYTES);
+            checks += detectEncoding(corpus.data(), sampleLength, &model.trigramFilter) ==
+                      ENCODING_UTF8;
+        }
+    }
+    printf("\nUTF-8 detection: %.2f us per %d bytes (%zu checks)\n",
+           1e6 * (timestamp_seconds() - start) / checks,
+           SCRIPT_DETECTION_BYTES,
+           checks);
+
+    return 0;
+}
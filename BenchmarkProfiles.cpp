@@ -0,0 +1,312 @@
+/**
+ * @brief Lequel? benchmarks: building and storing profiles (count-min sketch, binary profile
+ * files and parallel text profiles)
+ */
+
+#include "Benchmark.h"
+
+#include <limits.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+#include "CSVData.h"
+#include "ProfileFile.h"
+#include "Text.h"
+#include "TrigramSketch.h"
+
+using namespace std;
+
+// Entries per profile compared in the sketch benchmark, as in resources/trigrams
+#define SKETCH_BENCH_ENTRIES 2000
+
+#define PROFILES_FILE "lequel_bench_profile.tmp.lqp"
+
+// Bytes of every very long line (the corpus without line breaks) in the parallel benchmark
+#define PARALLEL_LONG_LINE_BYTES (1 << 22)
+
+/**
+ * @name runSketchBenchmark
+ * @brief Builds the profile of every corpus with an exact hash map and with the fixed-memory
+ * sketch, and compares their most frequent entries.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runSketchBenchmark(benchmarkOptions_t& options) {
+    printf("profiles of %d entries, count-min sketch of %u KB monitoring %d keys\n\n",
+           SKETCH_BENCH_ENTRIES,
+           options.sketchKilobytes,
+           2 * SKETCH_BENCH_ENTRIES);
+    printf("%-6s %10s %12s %12s %8s %11s\n",
+           "code",
+           "distinct",
+           "exact ms",
+           "sketch ms",
+           "recall",
+           "count err");
+
+    for (auto& corpus : options.corpora) {
+        Text text;
+        if (!getTextFromFile(corpus.first, text)) {
+            cerr << "Error: could not read " << corpus.first << endl;
+            return 1;
+        }
+
+        TrigramProfile exact;
+        double start = timestamp_seconds();
+        for (unsigned int repetition = 0; repetition < options.repetitions; repetition++) {
+            exact.clear();
+            for (auto& line : text)
+                addToTrigramProfile(line, exact);
+        }
+        double exactElapsed = (timestamp_seconds() - start) / options.repetitions;
+        size_t distinctCount = exact.size();
+        keepMostFrequent(exact, SKETCH_BENCH_ENTRIES);
+
+        trigramSketch_t sketch;
+        TrigramProfile estimated;
+        start = timestamp_seconds();
+        for (unsigned int repetition = 0; repetition < options.repetitions; repetition++) {
+            initTrigramSketch(sketch, options.sketchKilobytes * 1024, 2 * SKETCH_BENCH_ENTRIES);
+            for (auto& line : text)
+                addToTrigramSketch(line, sketch);
+        }
+        double sketchElapsed = (timestamp_seconds() - start) / options.repetitions;
+        vector<pair<string, uint64_t>> counts;
+        getSketchCounts(sketch, counts);
+        for (auto& entry : counts)
+            estimated[entry.first].real = (float)entry.second;
+        keepMostFrequent(estimated, SKETCH_BENCH_ENTRIES);
+
+        // Share of the exact top entries found, and their mean relative overestimation
+        size_t found = 0;
+        double error = 0.0;
+        for (auto& entry : exact) {
+            auto estimate = estimated.find(entry.first);
+            if (estimate == estimated.end())
+                continue;
+
+            found++;
+            error += (estimate->second.real - entry.second.real) / entry.second.real;
+        }
+
+        printf("%-6s %10zu %12.2f %12.2f %7.1f%% %10.2f%%\n",
+               corpus.second.c_str(),
+               distinctCount,
+               1e3 * exactElapsed,
+               1e3 * sketchElapsed,
+               100.0 * found / exact.size(),
+               found ? 100.0 * error / found : 0.0);
+    }
+
+    return 0;
+}
+
+/**
+ * @name getFileSize
+ * @brief Returns the size of a file.
+ *
+ * @param path The file path
+ * @return Size in bytes, 0 if it can't be opened
+ */
+static size_t getFileSize(const string& path) {
+    ifstream file(path, ios::binary | ios::ate);
+
+    return file.is_open() ? (size_t)file.tellg() : 0;
+}
+
+/**
+ * @name runProfilesBenchmark
+ * @brief Converts every language profile to the binary format and compares the size and
+ * read time of both formats, checking that the binary profile reads back the same.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runProfilesBenchmark(benchmarkOptions_t& options) {
+    CSVData languageCodes;
+    if (!readCSV(LANGUAGECODE_NAMES_FILE, languageCodes)) {
+        cerr << "Error: could not read " << LANGUAGECODE_NAMES_FILE << endl;
+        return 1;
+    }
+
+    size_t profileCount = 0;
+    size_t csvBytes = 0;
+    size_t binaryBytes = 0;
+    size_t mismatches = 0;
+    double csvElapsed = 0.0;
+    double binaryElapsed = 0.0;
+
+    for (auto& fields : languageCodes) {
+        if (fields.size() != 2)
+            continue;
+
+        string csvPath = TRIGRAMS_PATH + fields[0] + ".csv";
+        TrigramProfile csvProfile;
+        TrigramProfile binaryProfile;
+
+        double start = timestamp_seconds();
+        for (unsigned int repetition = 0; repetition < options.repetitions; repetition++) {
+            if (!readProfileCSV(csvPath, csvProfile)) {
+                cerr << "Error: could not read " << csvPath << endl;
+                return 1;
+            }
+        }
+        csvElapsed += timestamp_seconds() - start;
+
+        if (!writeProfileFile(PROFILES_FILE, csvProfile)) {
+            cerr << "Error: could not write " << PROFILES_FILE << endl;
+            return 1;
+        }
+
+        start = timestamp_seconds();
+        for (unsigned int repetition = 0; repetition < options.repetitions; repetition++) {
+            if (!readProfileFile(PROFILES_FILE, binaryProfile)) {
+                cerr << "Error: could not read back " << csvPath << endl;
+                return 1;
+            }
+        }
+        binaryElapsed += timestamp_seconds() - start;
+
+        bool same = binaryProfile.size() == csvProfile.size();
+        for (auto& entry : csvProfile) {
+            auto binaryEntry = binaryProfile.find(entry.first);
+            if (!same || binaryEntry == binaryProfile.end() ||
+                binaryEntry->second.real != entry.second.real) {
+                same = false;
+                break;
+            }
+        }
+        if (!same)
+            mismatches++;
+
+        profileCount++;
+        csvBytes += getFileSize(csvPath);
+        binaryBytes += getFileSize(PROFILES_FILE);
+    }
+    remove(PROFILES_FILE);
+
+    printf("%zu profiles, %u repetitions, %zu mismatches\n\n",
+           profileCount,
+           options.repetitions,
+           mismatches);
+    printf("%-8s %12s %16s\n", "format", "KB", "ms/all profiles");
+    printf("%-8s %12.1f %16.2f\n",
+           "csv",
+           csvBytes / 1024.0,
+           1e3 * csvElapsed / options.repetitions);
+    printf("%-8s %12.1f %16.2f\n",
+           "binary",
+           binaryBytes / 1024.0,
+           1e3 * binaryElapsed / options.repetitions);
+
+    return mismatches ? 1 : 0;
+}
+
+/**
+ * @name isSameTextProfile
+ * @brief Compares the counts of two text profiles.
+ *
+ * @param a A text profile
+ * @param b Another text profile
+ * @return true if both hold the same trigrams with the same counts
+ */
+static bool isSameTextProfile(const textProfile_t& a, const textProfile_t& b) {
+    if (a.trigrams.size() != b.trigrams.size() || a.unknownCount != b.unknownCount)
+        return false;
+
+    for (auto& entry : a.trigrams) {
+        auto other = b.trigrams.find(entry.first);
+        if (other == b.trigrams.end() || other->second.real != entry.second.real)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @name runParallelBenchmark
+ * @brief Repeats the corpora, alternating normal lines with very long lines, up to
+ * parallelMegabytes and profiles the whole text with one thread (buildTextProfile without
+ * limits) and with 1 to maxThreads threads, checking that every profile is the same.
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runParallelBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    if (!loadModel(model))
+        return 1;
+
+    vector<string> corpora;
+    for (auto& corpus : options.corpora) {
+        ifstream file(corpus.first, ios::binary);
+        if (!file.is_open()) {
+            cerr << "Error: could not read " << corpus.first << endl;
+            return 1;
+        }
+        corpora.push_back(string(istreambuf_iterator<char>(file), istreambuf_iterator<char>()));
+    }
+
+    // Very long lines exercise the chunk boundaries that fall inside a line
+    size_t textBytes = (size_t)options.parallelMegabytes << 20;
+    string text;
+    text.reserve(textBytes + (corpora.empty() ? 0 : corpora[0].size()) + 1);
+    for (size_t i = 0; text.length() < textBytes && !corpora.empty(); i++) {
+        const string& corpus = corpora[i % corpora.size()];
+        if (i % 2 == 0) {
+            text += corpus;
+        } else {
+            string longLine = corpus.substr(0, PARALLEL_LONG_LINE_BYTES);
+            replace(longLine.begin(), longLine.end(), '\n', ' ');
+            text += longLine;
+        }
+        text += '\n';
+    }
+
+    settings_t settings = options.globalSettings;
+    settings.lineLimit = UINT_MAX;
+    settings.trigramLimit = UINT_MAX;
+
+    textProfile_t sequentialProfile;
+    double start = timestamp_seconds();
+    for (unsigned int repetition = 0; repetition < options.repetitions; repetition++)
+        buildTextProfile(text, sequentialProfile, model.trigramFilter, settings);
+    double sequentialElapsed = (timestamp_seconds() - start) / options.repetitions;
+
+    printf("%.1f MB, %zu distinct trigrams, %u repetitions, %u hardware threads\n\n",
+           text.length() / 1048576.0,
+           sequentialProfile.trigrams.size(),
+           options.repetitions,
+           thread::hardware_concurrency());
+    printf("%-12s %12s %10s %10s\n", "threads", "ms/text", "speedup", "same");
+    printf("%-12s %12.1f %10.2f %10s\n", "sequential", 1e3 * sequentialElapsed, 1.0, "-");
+
+    size_t mismatches = 0;
+    for (unsigned int threads = 1; threads <= options.maxThreads; threads *= 2) {
+        settings.profileThreads = threads;
+        textProfile_t parallelProfile;
+
+        start = timestamp_seconds();
+        for (unsigned int repetition = 0; repetition < options.repetitions; repetition++)
+            buildTextProfileParallel(text, parallelProfile, model.trigramFilter, settings);
+        double elapsed = (timestamp_seconds() - start) / options.repetitions;
+
+        bool same = isSameTextProfile(sequentialProfile, parallelProfile);
+        if (!same)
+            mismatches++;
+
+        printf("%-12u %12.1f %10.2f %10s\n",
+               threads,
+               1e3 * elapsed,
+               sequentialElapsed / elapsed,
+               same ? "yes" : "NO");
+    }
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,247 @@
+/**
+ * @brief Lequel? benchmarks: checks of the similarity scores, the vocabulary slots and model
+ * reloads
+ */
+
+#include "Benchmark.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+using namespace std;
+
+// Largest relative error of a similarity against its double precision definition
+#define VERIFY_TOLERANCE 1e-4
+// Text in the only language written in Hangul, identified across a model reload
+#define HANGUL_SAMPLE "모든 인간은 태어날 때부터 자유롭다."
+#define HANGUL_CODE "kor"
+
+/**
+ * @name getReferenceSimilarity
+ * @brief Computes a similarity straight from its definition, in double precision, from the
+ * text counts and the language counts only.
+ *
+ * @param text The text profile
+ * @param language The language profile
+ * @param algorithm Cosine, Jaccard or Cavnar Trenkle
+ * @param values Real or normalized values
+ * @return The similarity
+ */
+static double getReferenceSimilarity(const textProfile_t& text,
+                                     const LanguageProfile& language,
+                                     algorithmSetting_t algorithm,
+                                     valueProcessingSetting_t values) {
+    double textSquares = text.unknownCount;
+    forEachTextTrigram(text, [&](const string&, float count) {
+        textSquares += (double)count * count;
+    });
+    double languageSquares = 0.0;
+    for (auto& entry : language.trigramProfile)
+        languageSquares += (double)entry.second.real * entry.second.real;
+
+    double textScale = values == VALUE_NORMALIZE ? 1.0 / sqrt(textSquares) : 1.0;
+    double languageScale = values == VALUE_NORMALIZE ? 1.0 / sqrt(languageSquares) : 1.0;
+
+    double dotProduct = 0.0;
+    double inCommon = 0.0;
+    double textTotal = text.unknownCount * textScale;
+    double languageTotal = 0.0;
+    double distance = text.unknownCount;
+
+    for (auto& entry : language.trigramProfile)
+        languageTotal += entry.second.real * languageScale;
+
+    forEachTextTrigram(text, [&](const string& trigram, float count) {
+        double a = count * textScale;
+        textTotal += a;
+
+        auto languageEntry = language.trigramProfile.find(trigram);
+        if (languageEntry == language.trigramProfile.end()) {
+            distance += 1.0;
+            return;
+        }
+
+        double b = languageEntry->second.real * languageScale;
+        dotProduct += (double)count * languageEntry->second.real;
+        inCommon += min(a, b);
+        distance += fabs(a - b);
+    });
+
+    if (algorithm == ALGORITHM_COSINE)
+        return dotProduct / (sqrt(textSquares) * sqrt(languageSquares));
+    if (algorithm == ALGORITHM_JACCARD)
+        return inCommon / (textTotal + languageTotal - inCommon);
+    return 1.0 / (1.0 + distance);
+}
+
+/**
+ * @name countVocabularyMismatches
+ * @brief Checks the perfect hash of the model vocabulary: every key must find its own slot,
+ * and a text counted in slots must hold the same counts as the same text counted in a table.
+ *
+ * @param model The language model
+ * @param dense The profile of a text counted in slots
+ * @param table The profile of the same text counted in a table
+ * @return Number of mismatches
+ */
+static size_t countVocabularyMismatches(const LanguageModel& model,
+                                        const textProfile_t& dense,
+                                        const textProfile_t& table) {
+    size_t mismatches = 0;
+    size_t inVocabulary = 0;
+
+    for (auto& entry : table.trigrams) {
+        uint32_t slot = lookupPerfectHash(model.trigramHash, entry.first);
+        if (slot == PERFECT_HASH_MISSING) {
+            // Only a filter false positive may be missing from the vocabulary
+            mismatches += model.trigramIndex.count(entry.first);
+            continue;
+        }
+
+        inVocabulary++;
+        if (dense.slotCounts[slot] != entry.second.real)
+            mismatches++;
+    }
+
+    return mismatches + (inVocabulary != dense.touchedSlots.size());
+}
+
+/**
+ * @name runVerifyBenchmark
+ * @brief Checks the similarity loops against their definitions: every sample is compared
+ * with every language through getSimilarityScore and getReferenceSimilarity, every language
+ * profile must be identical to itself (similarity 1), and the norms accumulated during
+ * extraction must match the ones computed from the finished profile. Samples are counted in
+ * vocabulary slots, and checked against the same samples counted in a table. Last, a batch is
+ * identified again after the model it was identified with is freed (a reload).
+ *
+ * @param options The benchmark options
+ * @return Process exit code
+ */
+int runVerifyBenchmark(benchmarkOptions_t& options) {
+    LanguageModel model;
+    vector<benchmarkSample_t> samples;
+    if (!loadModelAndSamples(options, model, samples))
+        return 1;
+
+    LanguageCandidates& languages = model.scriptLanguages[SCRIPT_UNKNOWN];
+    size_t vocabularyMismatches = 0;
+    for (uint32_t slot = 0; slot < model.trigramHash.keys.size(); slot++) {
+        if (lookupPerfectHash(model.trigramHash, model.trigramHash.keys[slot]) != slot)
+            vocabularyMismatches++;
+    }
+
+    size_t normMismatches = 0;
+    vector<textProfile_t> profiles(samples.size());
+    textProfile_t tableProfile;
+    for (size_t i = 0; i < samples.size(); i++) {
+        settings_t settings = options.globalSettings;
+        setTextProfileVocabulary(profiles[i], &model.trigramHash);
+        buildTextProfile(samples[i].text, profiles[i], model.trigramFilter, settings);
+        buildTextProfile(samples[i].text, tableProfile, model.trigramFilter, settings);
+        vocabularyMismatches += countVocabularyMismatches(model, profiles[i], tableProfile);
+
+        double sum = profiles[i].unknownCount;
+        double sumSquares = profiles[i].unknownCount;
+        forEachTextTrigram(profiles[i], [&](const string&, float count) {
+            sum += count;
+            sumSquares += (double)count * count;
+        });
+        if (fabs(profiles[i].sum - sum) > VERIFY_TOLERANCE * sum ||
+            fabs(profiles[i].sumSquares - sumSquares) > VERIFY_TOLERANCE * sumSquares)
+            normMismatches++;
+    }
+
+    printf("%zu samples x %zu languages, tolerance %g, %zu norm mismatches\n",
+           samples.size(),
+           languages.size(),
+           VERIFY_TOLERANCE,
+           normMismatches);
+    printf("%zu vocabulary slots, %zu vocabulary mismatches\n\n",
+           model.trigramHash.keys.size(),
+           vocabularyMismatches);
+    printf("%-14s %-12s %14s %10s %10s\n",
+           "algorithm",
+           "values",
+           "max rel. error",
+           "failures",
+           "self != 1");
+
+    size_t totalFailures = normMismatches + vocabularyMismatches;
+    for (int algorithm = 0; algorithm < ALGORITHM_NAIVE_BAYES; algorithm++) {
+        for (int values = 0; values < VALUE_PROCESSING_COUNT; values++) {
+            settings_t settings = options.globalSettings;
+            settings.algorithmSetting = (algorithmSetting_t)algorithm;
+            settings.valueProcessingSetting = (valueProcessingSetting_t)values;
+
+            double maxError = 0.0;
+            size_t failures = 0;
+            for (auto& profile : profiles) {
+                for (auto language : languages) {
+                    double reference = getReferenceSimilarity(profile,
+                                                              *language,
+                                                              settings.algorithmSetting,
+                                                              settings.valueProcessingSetting);
+                    double score = getSimilarityScore(profile, *language, settings);
+                    double error = fabs(score - reference) / max(fabs(reference), 1e-3);
+                    maxError = max(maxError, error);
+                    if (!(error <= VERIFY_TOLERANCE))
+                        failures++;
+                }
+            }
+
+            // A language profile read as a text is identical to itself
+            size_t selfFailures = 0;
+            for (auto language : languages) {
+                textProfile_t self;
+                for (auto& entry : language->trigramProfile) {
+                    self.trigrams[entry.first].real = entry.second.real;
+                    self.sum += entry.second.real;
+                    self.sumSquares += entry.second.real * entry.second.real;
+                }
+
+                float similarity = getSimilarityScore(self, *language, settings);
+                if (!(fabs(similarity - 1.0f) <= VERIFY_TOLERANCE))
+                    selfFailures++;
+            }
+
+            printf("%-14s %-12s %14.2e %10zu %10zu\n",
+                   ALGORITHM_NAMES[algorithm],
+                   VALUE_PROCESSING_NAMES[values],
+                   maxError,
+                   failures,
+                   selfFailures);
+            totalFailures += failures + selfFailures;
+        }
+    }
+
+    // A reload between two batches: the profiles identifyLanguagesBatch keeps per thread still
+    // point at the vocabulary of the freed model when the next batch starts, whose first text
+    // is in a script with a single language
+    vector<string> texts;
+    for (auto& sample : samples)
+        texts.push_back(sample.text);
+
+    vector<string> before;
+    vector<string> after;
+    unique_ptr<LanguageModel> reloaded(new LanguageModel());
+    if (!loadModel(*reloaded))
+        return 1;
+    identifyLanguagesBatch(texts, *reloaded, options.globalSettings, before);
+    reloaded.reset();
+
+    texts.insert(texts.begin(), HANGUL_SAMPLE);
+    identifyLanguagesBatch(texts, model, options.globalSettings, after);
+
+    size_t reloadMismatches = after[0] != HANGUL_CODE;
+    for (size_t i = 0; i < before.size(); i++)
+        reloadMismatches += before[i] != after[i + 1];
+    printf("\nreload between batches: %zu texts, %zu mismatches\n",
+           texts.size(),
+           reloadMismatches);
+
+    return totalFailures + reloadMismatches ? 1 : 0;
+}
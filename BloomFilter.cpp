@@ -0,0 +1,38 @@
+/**
+ * @brief Lequel? blocked Bloom filter
+ */
+
+#include "BloomFilter.h"
+
+/**
+ * @name initBloomFilter
+ * @brief Sizes an empty filter for a number of keys.
+ *
+ * @param filter The filter
+ * @param keyCount Number of keys that will be added (0 disables the filter)
+ */
+void initBloomFilter(bloomFilter_t& filter, size_t keyCount) {
+    size_t blockBits = BLOOM_BLOCK_WORDS * 64;
+
+    filter.blockCount = (keyCount * BLOOM_BITS_PER_KEY + blockBits - 1) / blockBits;
+    filter.words.assign(filter.blockCount * BLOOM_BLOCK_WORDS, 0);
+}
+
+/**
+ * @name addToBloomFilter
+ * @brief Adds a key to the filter.
+ *
+ * @param filter The filter (initialized)
+ * @param key The key
+ */
+void addToBloomFilter(bloomFilter_t& filter, const std::string& key) {
+    uint64_t hash = hashBloomKey(key);
+    uint64_t* block =
+        &filter.words[((hash >> 32) * filter.blockCount >> 32) * BLOOM_BLOCK_WORDS];
+
+    uint64_t bits = (hash ^ (hash >> 29)) * 0xBF58476D1CE4E5B9ULL;
+    for (int i = 0; i < BLOOM_HASH_COUNT; i++) {
+        unsigned int bit = (bits >> (i * 9)) & 511;
+        block[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
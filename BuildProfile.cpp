@@ -1,53 +1,67 @@
 #include "BuildProfile.h"
+#include "CodeFeatures.h"
+#include "CommandLine.h"
+#include "InputStream.h"
+#include "ProfileFile.h"
+#include "TrigramSketch.h"
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 /**
- * @name buildLanguageProfile
- * @brief Builds the trigram profile for a given language from a text corpus.
+ * @name writeLanguageProfile
+ * @brief Writes the most frequent entries of a profile, most frequent first.
  *
- * @param inputPath Path to the text corpus (UTF-8).
- * @param outputPath Path to save the trigram profile CSV.
- * @param languageCode Short language code (e.g., "grn", "cat", "cpp").
- * @return True if the profile was successfully created, false otherwise.
+ * @param trigramList Trigram-count pairs (reordered).
+ * @param outputPath Path to save the trigram profile (CSV, binary if it ends in .lqp).
+ * @param languageCode Short language code, for the report.
+ * @param maxEntries Keeps only the most frequent entries (0: keeps all).
+ * @return True if the profile was written, false otherwise.
  */
-bool buildLanguageProfile(const std::string &inputPath,
-                          const std::string &outputPath,
-                          const std::string &languageCode)
+static bool writeLanguageProfile(std::vector<std::pair<std::string, uint64_t>> &trigramList,
+                                 const std::string &outputPath,
+                                 const std::string &languageCode,
+                                 size_t maxEntries)
 {
-    std::ifstream file(inputPath);
-    if (!file.is_open()) {
-        std::cerr << "Error: could not open corpus " << inputPath << std::endl;
-        return false;
-    }
-
-    TrigramProfile profile;
-    std::string line;
-
-    // 1. Reads the corpus line by line and update trigram profile
-    while (std::getline(file, line)) {
-        addToTrigramProfile(line, profile);
-    }
-
-    // 2. Copies trigram-frequency pairs to a vector for sorting
-    std::vector<std::pair<std::string, int>> trigramList;
-    trigramList.reserve(profile.size());
-    for (const auto &entry : profile) {
-        trigramList.emplace_back(entry.first, entry.second.real);
-    }
-
     // 3. Sorts by frequency (descending).
     std::sort(trigramList.begin(), trigramList.end(),
-              [](const auto &a, const auto &b) {
+              [](const std::pair<std::string, uint64_t> &a,
+                 const std::pair<std::string, uint64_t> &b) {
                   if (a.second != b.second)
                       return a.second > b.second; // higher count first
                   return a.first < b.first;       
               });
 
+    if (maxEntries && trigramList.size() > maxEntries)
+        trigramList.resize(maxEntries);
+
+    // Binary profiles (see ProfileFile.h) skip the CSV conversion
+    size_t extension = outputPath.rfind('.');
+    if (extension != std::string::npos && outputPath.substr(extension) == PROFILE_FILE_EXTENSION) {
+        TrigramProfile kept;
+        for (const auto &entry : trigramList)
+            kept[entry.first].real = (float)entry.second;
+
+        if (!writeProfileFile(outputPath, kept)) {
+            std::cerr << "Error: could not write profile to " << outputPath << std::endl;
+            return false;
+        }
+
+        std::cout << "Profile created for " << languageCode
+                  << " -> " << outputPath << std::endl;
+        return true;
+    }
+
     // 4. Converts sorted list to CSVData
     CSVData data;
     data.reserve(trigramList.size());
@@ -70,50 +84,716 @@ bool buildLanguageProfile(const std::string &inputPath,
     return true;
 }
 
+/**
+ * @name addBlockToCounts
+ * @brief Adds the exact counts of a block of complete lines, profiled by one thread per core.
+ *
+ * @param block The lines.
+ * @param features FEATURES_CODE also counts source code tokens.
+ * @param counts The counts to add to.
+ */
+static void addBlockToCounts(const std::string &block,
+                             featureSetting_t features,
+                             std::unordered_map<std::string, uint64_t> &counts)
+{
+    settings_t blockSettings;
+    blockSettings.featureSetting = features;
+    blockSettings.valueProcessingSetting = VALUE_REAL;
 
-bool addLanguageToNamesCSV(const std::string &languageCode,
-                           const std::string &languageName,
-                           const std::string &csvPath)
+    textProfile_t blockProfile;
+    buildTextProfileParallel(block, blockProfile, bloomFilter_t(), blockSettings);
+    for (const auto &entry : blockProfile.trigrams)
+        counts[entry.first] += (uint64_t)entry.second.real;
+}
+
+/**
+ * @name buildLanguageProfile
+ * @brief Builds the trigram profile for a given language from a text corpus.
+ *
+ * @param inputPath Path to the text corpus (UTF-8).
+ * @param outputPath Path to save the trigram profile CSV.
+ * @param languageCode Short language code (e.g., "grn", "cat", "cpp").
+ * @param features FEATURES_CODE also counts source code tokens.
+ * @param maxEntries Keeps only the most frequent entries (0: keeps all).
+ * @param sketchBytes Counts in this much fixed memory instead of a hash map (0: exact).
+ * @return True if the profile was successfully created, false otherwise.
+ */
+bool buildLanguageProfile(const std::string &inputPath,
+                          const std::string &outputPath,
+                          const std::string &languageCode,
+                          featureSetting_t features,
+                          size_t maxEntries,
+                          size_t sketchBytes)
 {
-    // Verifica si ya existe
-    std::ifstream infile(csvPath);
-    if (infile.is_open()) {
-        std::string line;
-        while (std::getline(infile, line)) {
-            if (line.find("\"" + languageCode + "\"") != std::string::npos) {
-                return true; // ya existe, no agrega
+    std::ifstream file(inputPath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not open corpus " << inputPath << std::endl;
+        return false;
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> trigramList;
+    std::string line;
+
+    // 1. Reads the corpus line by line and update trigram profile
+    if (sketchBytes) {
+        if (!maxEntries)
+            maxEntries = SKETCH_PROFILE_ENTRIES;
+
+        trigramSketch_t sketch;
+        TrigramProfile lineFeatures;
+        initTrigramSketch(sketch, sketchBytes, maxEntries * SKETCH_MONITORED_FACTOR);
+
+        while (std::getline(file, line)) {
+            addToTrigramSketch(line, sketch);
+            if (features == FEATURES_CODE) {
+                lineFeatures.clear();
+                addToCodeProfile(line, lineFeatures);
+                addProfileToTrigramSketch(lineFeatures, sketch);
             }
         }
+
+        // 2. Copies trigram-frequency pairs to a vector for sorting
+        getSketchCounts(sketch, trigramList);
+    } else {
+        // Exact counts: the corpus is profiled a block of complete lines at a time
+        std::unordered_map<std::string, uint64_t> counts;
+        std::string block;
+        bool isEnd = false;
+        while (!isEnd) {
+            // A line longer than a block makes the block grow until the line ends
+            size_t kept = block.length();
+            size_t wanted = INCREMENTAL_BLOCK_BYTES - kept % INCREMENTAL_BLOCK_BYTES;
+            block.resize(kept + wanted);
+            file.read(&block[kept], wanted);
+            block.resize(kept + file.gcount());
+            if (file.bad()) {
+                std::cerr << "Error: could not read corpus " << inputPath << std::endl;
+                return false;
+            }
+            isEnd = file.eof();
+
+            // The last line of the corpus may have no line break
+            size_t linesEnd = isEnd ? block.length() : block.rfind('\n') + 1;
+            if (!linesEnd)
+                continue;
+
+            std::string rest = block.substr(linesEnd);
+            block.resize(linesEnd);
+            addBlockToCounts(block, features, counts);
+            block.swap(rest);
+        }
+
+        // 2. Copies trigram-frequency pairs to a vector for sorting
+        trigramList.assign(counts.begin(), counts.end());
+    }
+
+    return writeLanguageProfile(trigramList, outputPath, languageCode, maxEntries);
+}
+
+/**
+ * @name readCountedTail
+ * @brief Checks that a corpus file still starts with the bytes it had when it was counted:
+ * it is no shorter and its last counted bytes have the same CRC.
+ *
+ * @param corpus The record of the corpus file.
+ * @param tail The last counted bytes (up to COUNTS_TAIL_BYTES).
+ * @return True if the file only grew since it was counted, false otherwise.
+ */
+static bool readCountedTail(const corpusRecord_t &corpus, std::string &tail)
+{
+    std::ifstream file(corpus.path, std::ios::binary | std::ios::ate);
+    if (!file.is_open() || (uint64_t)file.tellg() < corpus.countedBytes)
+        return false;
+
+    size_t length = (size_t)std::min<uint64_t>(corpus.countedBytes, COUNTS_TAIL_BYTES);
+    tail.resize(length);
+    file.seekg(corpus.countedBytes - length);
+    if (!file.read(&tail[0], length))
+        return false;
+
+    return getCRC32((const unsigned char *)tail.data(), length) == corpus.tailCRC;
+}
+
+/**
+ * @name countCorpusFile
+ * @brief Counts the complete lines of a corpus file past its counted bytes, a block at a
+ * time, and moves its record past them.
+ *
+ * @param corpus The record of the corpus file.
+ * @param tail The last counted bytes, updated.
+ * @param features FEATURES_CODE also counts source code tokens.
+ * @param counts The counts to add to.
+ * @param lastLine The bytes after the last line break (a last line still being written).
+ * @return True if the file was read, false otherwise.
+ */
+static bool countCorpusFile(corpusRecord_t &corpus,
+                            std::string &tail,
+                            featureSetting_t features,
+                            std::unordered_map<std::string, uint64_t> &counts,
+                            std::string &lastLine)
+{
+    std::ifstream file(corpus.path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not open corpus " << corpus.path << std::endl;
+        return false;
+    }
+    file.seekg(corpus.countedBytes);
+
+    std::string block;
+    uint64_t addedBytes = 0;
+    bool isEnd = false;
+    while (!isEnd) {
+        // A line longer than a block makes the block grow until the line ends
+        size_t kept = block.length();
+        size_t wanted = INCREMENTAL_BLOCK_BYTES - kept % INCREMENTAL_BLOCK_BYTES;
+        block.resize(kept + wanted);
+        file.read(&block[kept], wanted);
+        block.resize(kept + file.gcount());
+        if (file.bad()) {
+            std::cerr << "Error: could not read corpus " << corpus.path << std::endl;
+            return false;
+        }
+        isEnd = file.eof();
+
+        size_t linesEnd = block.rfind('\n') + 1;
+        if (!linesEnd)
+            continue;
+
+        std::string rest = block.substr(linesEnd);
+        block.resize(linesEnd);
+        addBlockToCounts(block, features, counts);
+
+        size_t tailBytes = COUNTS_TAIL_BYTES;
+        tail += block.substr(block.length() - std::min(block.length(), tailBytes));
+        tail.erase(0, tail.length() - std::min(tail.length(), tailBytes));
+        addedBytes += linesEnd;
+        block.swap(rest);
     }
 
+    corpus.countedBytes += addedBytes;
+    corpus.tailCRC = getCRC32((const unsigned char *)tail.data(), tail.length());
+    lastLine = block;
+
+    std::cout << "Counted " << addedBytes << " new bytes of " << corpus.path << std::endl;
+    return true;
+}
+
+/**
+ * @name updateLanguageProfile
+ * @brief Builds the trigram profile for a given language from the corpus files, counting
+ * only what they gained since the last build.
+ *
+ * @param inputPaths Paths to the text corpus files (UTF-8).
+ * @param outputPath Path to save the trigram profile; the counts are kept next to it.
+ * @param languageCode Short language code (e.g., "grn", "cat", "cpp").
+ * @param features FEATURES_CODE also counts source code tokens.
+ * @param maxEntries Keeps only the most frequent entries (0: keeps all).
+ * @return True if the profile was successfully created, false otherwise.
+ */
+bool updateLanguageProfile(const std::vector<std::string> &inputPaths,
+                           const std::string &outputPath,
+                           const std::string &languageCode,
+                           featureSetting_t features,
+                           size_t maxEntries)
+{
+    size_t extension = outputPath.rfind('.');
+    if (extension == std::string::npos || outputPath.find('/', extension) != std::string::npos)
+        extension = outputPath.length();
+    std::string countsPath = outputPath.substr(0, extension) + COUNTS_FILE_EXTENSION;
+
+    // 1. Keeps the previous counts if every counted corpus file is listed and only grew
+    profileCounts_t counts;
+    std::vector<std::string> tails;
+    bool isValid = readCountsFile(countsPath, counts) && counts.features == features;
+    for (const auto &corpus : counts.corpora) {
+        if (!isValid)
+            break;
+
+        tails.emplace_back();
+        isValid = std::find(inputPaths.begin(), inputPaths.end(), corpus.path) !=
+                      inputPaths.end() &&
+                  readCountedTail(corpus, tails.back());
+        if (!isValid)
+            std::cout << corpus.path << " was removed or rewritten" << std::endl;
+    }
+    if (!isValid) {
+        std::cout << "Counting " << languageCode << " from the start" << std::endl;
+        counts = profileCounts_t();
+        counts.features = features;
+        tails.clear();
+    }
+
+    for (const auto &path : inputPaths) {
+        bool isCounted = false;
+        for (const auto &corpus : counts.corpora)
+            isCounted |= corpus.path == path;
+
+        if (!isCounted) {
+            counts.corpora.emplace_back();
+            counts.corpora.back().path = path;
+            tails.emplace_back();
+        }
+    }
+
+    // 2. Counts the new complete lines; the last line of a file is counted again once complete
+    std::unordered_map<std::string, uint64_t> lastLineCounts;
+    for (size_t i = 0; i < counts.corpora.size(); i++) {
+        std::string lastLine;
+        if (!countCorpusFile(counts.corpora[i], tails[i], features, counts.counts, lastLine))
+            return false;
+
+        addBlockToCounts(lastLine, features, lastLineCounts);
+    }
+
+    if (!writeCountsFile(countsPath, counts)) {
+        std::cerr << "Error: could not write counts to " << countsPath << std::endl;
+        return false;
+    }
+
+    // 3. Regenerates the profile from the counts
+    for (const auto &entry : lastLineCounts)
+        counts.counts[entry.first] += entry.second;
+
+    std::vector<std::pair<std::string, uint64_t>> trigramList(counts.counts.begin(),
+                                                              counts.counts.end());
+    return writeLanguageProfile(trigramList, outputPath, languageCode, maxEntries);
+}
+
+
+/**
+ * @name addLanguagesToNamesCSV
+ * @brief Adds the languages a language names CSV lacks, reading and appending to it once.
+ *
+ * @param languages Language code-name pairs.
+ * @param csvPath Path to the language names CSV.
+ * @return True if the CSV lists every language, false otherwise.
+ */
+bool addLanguagesToNamesCSV(const std::vector<std::pair<std::string, std::string>> &languages,
+                            const std::string &csvPath)
+{
+    // Codes already listed (none if the CSV doesn't exist yet)
+    CSVData names;
+    readCSV(csvPath, names);
+    std::unordered_set<std::string> listedCodes;
+    for (const auto &fields : names) {
+        if (!fields.empty())
+            listedCodes.insert(fields[0]);
+    }
+
+    std::string rows;
+    for (const auto &language : languages) {
+        if (listedCodes.insert(language.first).second)
+            rows += "\"" + language.first + "\",\"" + language.second + "\"\n";
+    }
+    if (rows.empty())
+        return true;
+
     std::ofstream file(csvPath, std::ios::app); // modo append
     if (!file.is_open()) {
         std::cerr << "Error: could not open " << csvPath << std::endl;
         return false;
     }
 
-    file << "\"" << languageCode << "\",\"" << languageName << "\"\n";
+    file << rows;
+    return file.good();
+}
+
+bool addLanguageToNamesCSV(const std::string &languageCode,
+                           const std::string &languageName,
+                           const std::string &csvPath)
+{
+    return addLanguagesToNamesCSV({{languageCode, languageName}}, csvPath);
+}
+
+// boundedQueue_t: hands items from one stage of a pipeline to the next. Pushing waits while
+// the queue is full, so a fast stage can't fill the memory; popping fails once the queue is
+// closed and empty
+template <typename Item>
+struct boundedQueue_t {
+    std::deque<Item> items;
+    size_t capacity = LABELED_QUEUE_BLOCKS;
+    bool isClosed = false;
+    std::mutex lock;
+    std::condition_variable changed;
+};
+
+template <typename Item>
+static void pushQueue(boundedQueue_t<Item> &queue, Item &&item)
+{
+    std::unique_lock<std::mutex> guard(queue.lock);
+    queue.changed.wait(guard, [&queue] { return queue.items.size() < queue.capacity; });
+    queue.items.push_back(std::move(item));
+    queue.changed.notify_all();
+}
+
+template <typename Item>
+static bool popQueue(boundedQueue_t<Item> &queue, Item &item)
+{
+    std::unique_lock<std::mutex> guard(queue.lock);
+    queue.changed.wait(guard, [&queue] { return queue.isClosed || !queue.items.empty(); });
+    if (queue.items.empty())
+        return false;
+
+    item = std::move(queue.items.front());
+    queue.items.pop_front();
+    queue.changed.notify_all();
+    return true;
+}
+
+template <typename Item>
+static void closeQueue(boundedQueue_t<Item> &queue)
+{
+    std::lock_guard<std::mutex> guard(queue.lock);
+    queue.isClosed = true;
+    queue.changed.notify_all();
+}
+
+// LabeledBatch: the lines of each language in a block of a labeled corpus
+typedef std::unordered_map<std::string, std::string> LabeledBatch;
+
+// LanguageCounts: exact counts of the trigrams of each language
+typedef std::unordered_map<std::string, std::unordered_map<std::string, uint64_t>>
+    LanguageCounts;
+
+/**
+ * @name readLabeledBlocks
+ * @brief Reader stage: reads a labeled corpus in blocks of complete lines.
+ *
+ * @param stream The labeled corpus.
+ * @param blocks Where the blocks go (closed at the end).
+ * @return True if the whole corpus was read, false otherwise.
+ */
+static bool readLabeledBlocks(inputStream_t &stream, boundedQueue_t<std::string> &blocks)
+{
+    std::string block;
+    bool isEnd = false;
+    while (!isEnd) {
+        // A line longer than a block makes the block grow until the line ends
+        size_t kept = block.length();
+        size_t wanted = LABELED_BLOCK_BYTES - kept % LABELED_BLOCK_BYTES;
+        if (!readInputStream(stream, block, wanted))
+            break;
+        isEnd = block.length() < kept + wanted;
+
+        size_t linesEnd = isEnd ? block.length() : block.rfind('\n') + 1;
+        if (!linesEnd)
+            continue;
+
+        std::string rest = block.substr(linesEnd);
+        block.resize(linesEnd);
+        pushQueue(blocks, std::move(block));
+        block.swap(rest);
+    }
+
+    closeQueue(blocks);
+    return !stream.hasFailed;
+}
+
+/**
+ * @name isValidLanguageCode
+ * @brief Checks that a language code can name a profile file.
+ *
+ * @param code The code.
+ * @return True if the code has 1 to 16 letters, digits, '-' or '_', false otherwise.
+ */
+static bool isValidLanguageCode(const std::string &code)
+{
+    if (code.empty() || code.length() > 16)
+        return false;
+
+    for (unsigned char character : code) {
+        if (!isalnum(character) && character != '-' && character != '_')
+            return false;
+    }
+
     return true;
 }
 
+/**
+ * @name parseLabeledBlocks
+ * @brief Parser stage: splits blocks into "code<TAB>text" records and groups the text of
+ * each language, a line per record.
+ *
+ * @param blocks Blocks of complete lines.
+ * @param batches Where the grouped text goes (closed at the end).
+ * @param records Records parsed.
+ * @param malformedRecords Lines without a tab or with an invalid code, skipped.
+ */
+static void parseLabeledBlocks(boundedQueue_t<std::string> &blocks,
+                               boundedQueue_t<LabeledBatch> &batches,
+                               size_t &records,
+                               size_t &malformedRecords)
+{
+    std::string block;
+    std::string code;
+    while (popQueue(blocks, block)) {
+        LabeledBatch batch;
+        size_t lineStart = 0;
+        while (lineStart < block.length()) {
+            size_t lineEnd = block.find('\n', lineStart);
+            if (lineEnd == std::string::npos)
+                lineEnd = block.length();
+
+            size_t tab = block.find('\t', lineStart);
+            if (tab < lineEnd) {
+                code.assign(block, lineStart, tab - lineStart);
+                if (isValidLanguageCode(code)) {
+                    std::string &text = batch[code];
+                    text.append(block, tab + 1, lineEnd - tab - 1);
+                    text += '\n';
+                    records++;
+                } else
+                    malformedRecords++;
+            } else if (lineEnd > lineStart && block[lineStart] != '\r')
+                malformedRecords++;
+
+            lineStart = lineEnd + 1;
+        }
+
+        pushQueue(batches, std::move(batch));
+    }
+
+    closeQueue(batches);
+}
+
+/**
+ * @name countLabeledBatches
+ * @brief Counter stage: counts the trigrams of each language of the batches it takes into
+ * its own tables.
+ *
+ * @param batches Grouped text.
+ * @param features FEATURES_CODE also counts source code tokens.
+ * @param counts The counter's tables.
+ */
+static void countLabeledBatches(boundedQueue_t<LabeledBatch> &batches,
+                                featureSetting_t features,
+                                LanguageCounts &counts)
+{
+    settings_t batchSettings;
+    batchSettings.featureSetting = features;
+    batchSettings.valueProcessingSetting = VALUE_REAL;
+    batchSettings.profileThreads = 1;
+
+    LabeledBatch batch;
+    textProfile_t batchProfile;
+    while (popQueue(batches, batch)) {
+        for (const auto &language : batch) {
+            buildTextProfileParallel(language.second, batchProfile, bloomFilter_t(),
+                                     batchSettings);
+
+            auto &languageCounts = counts[language.first];
+            for (const auto &entry : batchProfile.trigrams)
+                languageCounts[entry.first] += (uint64_t)entry.second.real;
+        }
+    }
+}
+
+/**
+ * @name buildLabeledProfiles
+ * @brief Builds the trigram profiles of every language of a labeled corpus in one pass.
+ * A reader, a parser and one counter per core run as a pipeline; the tables of the counters
+ * are merged at the end.
+ *
+ * @param inputPath Path to the labeled corpus ("code<TAB>text" lines, may be compressed).
+ * @param outputDirectory Where to save the profiles, as code + extension.
+ * @param extension ".csv", or PROFILE_FILE_EXTENSION for binary profiles.
+ * @param namesPath Path to the language names CSV to complete.
+ * @param features FEATURES_CODE also counts source code tokens.
+ * @param maxEntries Keeps only the most frequent entries of each profile (0: keeps all).
+ * @return True if every profile was successfully created, false otherwise.
+ */
+bool buildLabeledProfiles(const std::string &inputPath,
+                          const std::string &outputDirectory,
+                          const std::string &extension,
+                          const std::string &namesPath,
+                          featureSetting_t features,
+                          size_t maxEntries)
+{
+    inputStream_t stream;
+    if (!openInputStream(inputPath.c_str(), stream))
+        return false;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // 1. Reads, parses and counts the corpus
+    boundedQueue_t<std::string> blocks;
+    boundedQueue_t<LabeledBatch> batches;
+    size_t records = 0;
+    size_t malformedRecords = 0;
+
+    size_t counterCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<LanguageCounts> counterCounts(counterCount);
+    std::vector<std::thread> threads;
+    threads.emplace_back(parseLabeledBlocks,
+                         std::ref(blocks),
+                         std::ref(batches),
+                         std::ref(records),
+                         std::ref(malformedRecords));
+    for (auto &counts : counterCounts)
+        threads.emplace_back(countLabeledBatches, std::ref(batches), features, std::ref(counts));
+
+    bool isRead = readLabeledBlocks(stream, blocks);
+    for (auto &thread : threads)
+        thread.join();
+
+    if (!isRead) {
+        std::cerr << "Error: could not read " << inputPath << std::endl;
+        return false;
+    }
+
+    // 2. Merges the tables of the counters into the largest one of each language
+    LanguageCounts &counts = counterCounts[0];
+    for (size_t i = 1; i < counterCount; i++) {
+        for (auto &language : counterCounts[i]) {
+            auto &merged = counts[language.first];
+            if (merged.size() < language.second.size())
+                merged.swap(language.second);
+
+            for (const auto &entry : language.second)
+                merged[entry.first] += entry.second;
+        }
+        counterCounts[i].clear();
+    }
+
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Counted " << records << " records of " << counts.size() << " languages ("
+              << stream.decodedBytes / 1e6 << " MB) in " << seconds << " s";
+    if (malformedRecords)
+        std::cout << ", skipped " << malformedRecords << " malformed lines";
+    std::cout << std::endl;
+
+    // 3. Writes the profiles, then adds the new languages to the names CSV at once
+    std::vector<std::string> codes;
+    for (const auto &language : counts)
+        codes.push_back(language.first);
+    std::sort(codes.begin(), codes.end());
+
+    bool isWritten = true;
+    std::vector<std::pair<std::string, std::string>> languages;
+    for (const auto &code : codes) {
+        std::vector<std::pair<std::string, uint64_t>> trigramList(counts[code].begin(),
+                                                                  counts[code].end());
+        counts[code].clear();
+
+        if (writeLanguageProfile(trigramList, outputDirectory + code + extension, code,
+                                 maxEntries))
+            languages.emplace_back(code, code);  // Named after its code until renamed
+        else
+            isWritten = false;
+    }
+
+    return addLanguagesToNamesCSV(languages, namesPath) && isWritten;
+}
+
+/**
+ * @name buildProfile
+ * @brief Builds a profile from scratch, or incrementally (exact counts only).
+ *
+ * @param inputPath Path to the text corpus (UTF-8).
+ * @param outputPath Path to save the trigram profile.
+ * @param languageCode Short language code (e.g., "grn", "cat", "cpp").
+ * @param features FEATURES_CODE also counts source code tokens.
+ * @param maxEntries Keeps only the most frequent entries (0: keeps all).
+ * @param sketchBytes Counts in this much fixed memory instead of a hash map (0: exact).
+ * @param incremental Only counts what the corpus gained since the last build.
+ * @return True if the profile was successfully created, false otherwise.
+ */
+static bool buildProfile(const std::string &inputPath,
+                         const std::string &outputPath,
+                         const std::string &languageCode,
+                         featureSetting_t features,
+                         size_t maxEntries,
+                         size_t sketchBytes,
+                         bool incremental)
+{
+    if (incremental)
+        return updateLanguageProfile({inputPath}, outputPath, languageCode, features, maxEntries);
 
-int main()
+    return buildLanguageProfile(inputPath, outputPath, languageCode, features, maxEntries,
+                                sketchBytes);
+}
+
+int main(int argc, char *argv[])
 {
+    // "build_profiles [code] [--sketch KB | --incremental | --labeled CORPUS] [--binary]"
+    bool code = false;
+    bool incremental = false;
+    std::string labeledPath;
+    size_t sketchBytes = 0;
+    unsigned int kilobytes = 0;
+    std::string extension = ".csv";
+    bool isUsageValid = true;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "code")
+            code = true;
+        else if (argument == "--binary")
+            extension = PROFILE_FILE_EXTENSION;
+        else if (argument == "--incremental")
+            incremental = true;
+        else if (argument == "--labeled" && i + 1 < argc)
+            labeledPath = argv[++i];
+        else if (argument == "--sketch" && i + 1 < argc && parseUnsigned(argv[i + 1], kilobytes))
+        {
+            sketchBytes = (size_t)kilobytes * 1024;
+            i++;
+        }
+        else
+            isUsageValid = false;
+    }
+    if (!isUsageValid || (bool)sketchBytes + incremental + !labeledPath.empty() > 1) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [code] [--sketch KB | --incremental | --labeled CORPUS] [--binary]"
+                  << std::endl;
+        return 1;
+    }
+
+    // "--labeled": creates the profile of every language of a "code<TAB>text" corpus
+    if (!labeledPath.empty()) {
+        bool isBuilt = code ? buildLabeledProfiles(labeledPath, "resources/code/", extension,
+                                                   "resources/code/languagecode_names_es.csv",
+                                                   FEATURES_CODE, 2000)
+                            : buildLabeledProfiles(labeledPath, "resources/trigrams/", extension,
+                                                   "resources/languagecode_names_es.csv");
+        return isBuilt ? 0 : 1;
+    }
+
+    // "code": creates the profiles for programming languages only
+    if (code) {
+        buildProfile("resources/corpus/corpus_c.txt",
+                     "resources/code/c" + extension,
+                     "c", FEATURES_CODE, 2000, sketchBytes, incremental);
+        addLanguageToNamesCSV("c", "C", "resources/code/languagecode_names_es.csv");
+
+        buildProfile("resources/corpus/corpus_cpp.txt",
+                     "resources/code/cpp" + extension,
+                     "cpp", FEATURES_CODE, 2000, sketchBytes, incremental);
+        addLanguageToNamesCSV("cpp", "C++", "resources/code/languagecode_names_es.csv");
+
+        buildProfile("resources/corpus/corpus_python.txt",
+                     "resources/code/py" + extension,
+                     "py", FEATURES_CODE, 2000, sketchBytes, incremental);
+        addLanguageToNamesCSV("py", "Python", "resources/code/languagecode_names_es.csv");
+
+        return 0;
+    }
+
     // Creates profiles for natural languages
-    buildLanguageProfile("resources/corpus/corpus_guarani.txt",
-                         "resources/trigrams/grn.csv",
-                         "grn");
+    buildProfile("resources/corpus/corpus_guarani.txt",
+                 "resources/trigrams/grn" + extension,
+                 "grn", FEATURES_TRIGRAMS, 0, sketchBytes, incremental);
     addLanguageToNamesCSV("grn", "Guaraní", "resources/languagecode_names_es.csv");
 
-    buildLanguageProfile("resources/corpus/corpus_catalan.txt",
-                         "resources/trigrams/cat.csv",
-                         "cat");
+    buildProfile("resources/corpus/corpus_catalan.txt",
+                 "resources/trigrams/cat" + extension,
+                 "cat", FEATURES_TRIGRAMS, 0, sketchBytes, incremental);
     addLanguageToNamesCSV("cat", "Catalán", "resources/languagecode_names_es.csv");
 
-    buildLanguageProfile("resources/corpus/corpus_asturian.txt",
-                         "resources/trigrams/ast.csv",
-                         "ast");
+    buildProfile("resources/corpus/corpus_asturian.txt",
+                 "resources/trigrams/ast" + extension,
+                 "ast", FEATURES_TRIGRAMS, 0, sketchBytes, incremental);
     addLanguageToNamesCSV("ast", "Asturiano", "resources/languagecode_names_es.csv");
 
     return 0;
-}
\ No newline at end of file
+}
@@ -2,17 +2,74 @@
 #define BUILDPROFILE_H
 
 #include <string>
+#include <vector>
 
 #include "Lequel.h"
 #include "CSVData.h"
 #include "Text.h"
 
+// Entries of a profile counted with a sketch when no limit is given, as in resources/trigrams
+#define SKETCH_PROFILE_ENTRIES 2000
+// Keys monitored by the sketch per profile entry, so entries near the cut are ranked well
+#define SKETCH_MONITORED_FACTOR 2
+// Corpus bytes counted at a time by an incremental build: the counts of a block stay below
+// 2^24, exact in the float counts of a text profile
+#define INCREMENTAL_BLOCK_BYTES (1 << 24)
+// Bytes of a labeled corpus read at a time: the text of a language in a block stays below
+// 2^24 bytes, so its counts are exact in the float counts of a text profile
+#define LABELED_BLOCK_BYTES (1 << 22)
+// Blocks waiting between two stages of the labeled corpus pipeline
+#define LABELED_QUEUE_BLOCKS 4
+
 // Build a trigram profile for a given language from a text corpus.
 // inputPath:   path to a large text corpus (UTF-8).
-// outputPath:  where to save the trigram profile (CSV).
+// outputPath:  where to save the trigram profile (CSV, binary if it ends in .lqp).
 // languageCode: short language code (e.g., "grn", "cat", "cpp").
+// features:    FEATURES_CODE also counts source code tokens (see CodeFeatures.h).
+// maxEntries:  keeps only the most frequent entries (0: keeps all).
+// sketchBytes: counts in fixed memory with a count-min sketch of this size (see
+//              TrigramSketch.h) instead of an exact hash map (0: exact). The profile then
+//              keeps maxEntries entries, SKETCH_PROFILE_ENTRIES if maxEntries is 0.
 bool buildLanguageProfile(const std::string &inputPath,
                           const std::string &outputPath,
-                          const std::string &languageCode);
+                          const std::string &languageCode,
+                          featureSetting_t features = FEATURES_TRIGRAMS,
+                          size_t maxEntries = 0,
+                          size_t sketchBytes = 0);
+
+// Build a trigram profile as buildLanguageProfile does (exact counts), counting only what
+// the corpus gained since the last build. The exact counts of every trigram, and how many
+// bytes of each corpus file they include, are kept next to the profile (see ProfileFile.h,
+// .lqc). Corpus files may only grow: when one shrank, changed in its last counted bytes
+// (COUNTS_TAIL_BYTES, all that is checked), was removed from inputPaths or was counted with
+// other features, everything is counted again. New files are counted whole.
+// A last line without '\n' is added to the profile but not to the kept counts, so text
+// appended to it is counted with it.
+bool updateLanguageProfile(const std::vector<std::string> &inputPaths,
+                           const std::string &outputPath,
+                           const std::string &languageCode,
+                           featureSetting_t features = FEATURES_TRIGRAMS,
+                           size_t maxEntries = 0);
+
+// Build the trigram profiles of every language of a labeled corpus in one pass over it.
+// inputPath:       lines of "code<TAB>text", one record each (may be compressed, see
+//                  InputStream.h). Lines without a tab or with a code that can't name a file
+//                  are skipped.
+// outputDirectory: where to save each profile, as code + extension (".csv" or ".lqp").
+// namesPath:       language names CSV; the codes it lacks are added at once, named after
+//                  their code.
+// features, maxEntries: as in buildLanguageProfile (exact counts).
+// The profile of a language is the one buildLanguageProfile builds from a corpus file with
+// its records as lines.
+bool buildLabeledProfiles(const std::string &inputPath,
+                          const std::string &outputDirectory,
+                          const std::string &extension,
+                          const std::string &namesPath,
+                          featureSetting_t features = FEATURES_TRIGRAMS,
+                          size_t maxEntries = 0);
+
+// Add the languages a language names CSV lacks ("code","name" rows), opening it once.
+bool addLanguagesToNamesCSV(const std::vector<std::pair<std::string, std::string>> &languages,
+                            const std::string &csvPath);
 
 #endif 
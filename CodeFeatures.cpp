@@ -0,0 +1,142 @@
+/**
+ * @brief Token-level features for source code identification
+ */
+
+#include "CodeFeatures.h"
+
+#include <string.h>
+
+#include <unordered_set>
+
+using namespace std;
+
+// Keywords, directives and common library names of C, C++ and Python
+static const char* CODE_KEYWORDS[] = {
+    // C
+    "include", "define", "ifdef", "ifndef", "endif", "typedef", "struct", "union", "enum",
+    "sizeof", "malloc", "free", "printf", "scanf", "void", "static", "extern", "unsigned", "char",
+    "int", "float", "double", "long", "short", "const", "return", "for", "while", "do", "switch",
+    "case", "break", "continue", "NULL",
+    // C++
+    "class", "namespace", "template", "typename", "std", "cout", "cin", "endl", "public",
+    "private", "protected", "virtual", "override", "new", "delete", "nullptr", "auto", "using",
+    "operator", "this", "bool", "true", "false", "try", "catch", "throw", "vector", "string",
+    "static_cast", "friend", "inline", "map",
+    // Python
+    "def", "import", "from", "as", "elif", "else", "if", "self", "None", "True", "False",
+    "lambda", "yield", "with", "pass", "in", "is", "not", "and", "or", "print", "range", "len",
+    "except", "raise", "finally", "global", "async", "await", "__init__", "__name__", "list",
+    "dict",
+};
+
+/**
+ * @name isKeyword
+ * @brief Checks whether an identifier is in CODE_KEYWORDS.
+ *
+ * @param identifier The identifier
+ * @return true if it is a keyword
+ */
+static bool isKeyword(const string& identifier) {
+    static const unordered_set<string> keywords(
+        CODE_KEYWORDS, CODE_KEYWORDS + sizeof(CODE_KEYWORDS) / sizeof(CODE_KEYWORDS[0]));
+
+    return keywords.count(identifier) != 0;
+}
+
+static inline bool isIdentifierCharacter(unsigned char character) {
+    return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') ||
+           (character >= '0' && character <= '9') || character == '_' || character >= 0x80;
+}
+
+static inline bool isSpace(unsigned char character) {
+    return character == ' ' || character == '\t' || character == '\r';
+}
+
+/**
+ * @name addToCodeProfile
+ * @brief Adds the token features of a line of source code to a profile:
+ * "kw:<keyword>" per keyword, "op:<pair>" per pair of adjacent punctuation characters,
+ * "ind:<style>" for indented lines and "end:<character>" for lines ending in punctuation.
+ *
+ * @param line A line of source code, without the line break
+ * @param profile The trigram profile
+ */
+void addToCodeProfile(const string& line, TrigramProfile& profile) {
+    thread_local string feature;
+    size_t length = line.length();
+    size_t position = 0;
+
+    // Indentation style
+    while (position < length && isSpace(line[position]))
+        position++;
+    if (position == length)
+        return;  // Blank line
+
+    if (position > 0) {
+        if (line[0] == '\t')
+            feature = "ind:tab";
+        else if (position % 4 == 0)
+            feature = "ind:4";
+        else if (position % 2 == 0)
+            feature = "ind:2";
+        else
+            feature = "ind:odd";
+        profile[feature].real += CODE_FEATURE_WEIGHT;
+    }
+
+    // Keywords and punctuation pairs
+    while (position < length) {
+        unsigned char character = line[position];
+
+        if (isIdentifierCharacter(character)) {
+            size_t start = position;
+            while (position < length && isIdentifierCharacter(line[position]))
+                position++;
+
+            feature.assign(line, start, position - start);
+            if (isKeyword(feature)) {
+                feature.insert(0, "kw:");
+                profile[feature].real += CODE_FEATURE_WEIGHT;
+            }
+        } else if (isSpace(character)) {
+            position++;
+        } else {
+            if (position + 1 < length && !isSpace(line[position + 1]) &&
+                !isIdentifierCharacter(line[position + 1])) {
+                feature = "op:";
+                feature.append(line, position, 2);
+                profile[feature].real += CODE_FEATURE_WEIGHT;
+            }
+            position++;
+        }
+    }
+
+    // Line ending
+    while (length > 0 && isSpace(line[length - 1]))
+        length--;
+    if (!isIdentifierCharacter(line[length - 1])) {
+        feature = "end:";
+        feature += line[length - 1];
+        profile[feature].real += CODE_FEATURE_WEIGHT;
+    }
+}
+
+/**
+ * @name isCodeFeature
+ * @brief Tells the features added by addToCodeProfile from trigrams: a feature is one of their
+ * prefixes followed by at least one character, so it is never a trigram such as "op:".
+ *
+ * @param key A profile key
+ * @return true The key is a code feature
+ */
+bool isCodeFeature(const string& key) {
+    static const char* FEATURE_PREFIXES[] = {"kw:", "op:", "ind:", "end:"};
+
+    for (const char* prefix : FEATURE_PREFIXES) {
+        size_t prefixLength = strlen(prefix);
+        if (key.length() > prefixLength && key.compare(0, prefixLength, prefix) == 0)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,23 @@
+/**
+ * @brief Token-level features for source code identification
+ *
+ * Trigrams alone cannot tell C, C++ and Python apart, so code profiles also count keywords,
+ * punctuation pairs (such as "::" or "->"), indentation styles and line endings. Features are
+ * stored in the same TrigramProfile as the trigrams and scored the same way; their keys are
+ * always longer than 3 characters so they never collide with a trigram.
+ */
+
+#ifndef CODEFEATURES_H
+#define CODEFEATURES_H
+
+#include <string>
+
+#include "Lequel.h"
+
+// Value added to a profile per feature occurrence (a trigram adds 1)
+#define CODE_FEATURE_WEIGHT 2.0f
+
+void addToCodeProfile(const std::string& line, TrigramProfile& profile);
+bool isCodeFeature(const std::string& key);
+
+#endif
@@ -0,0 +1,25 @@
+/**
+ * @brief Lequel? command line helpers
+ */
+
+#include "CommandLine.h"
+
+#include <stdlib.h>
+
+/**
+ * @name parseUnsigned
+ * @brief Parses a positive integer command line value.
+ *
+ * @param text The command line value
+ * @param value The destination value
+ * @return true if text was a valid positive integer
+ */
+bool parseUnsigned(const char* text, unsigned int& value) {
+    char* end;
+    unsigned long parsed = strtoul(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || parsed == 0 || parsed > 0xffffffffUL)
+        return false;
+
+    value = (unsigned int)parsed;
+    return true;
+}
@@ -0,0 +1,13 @@
+/**
+ * @brief Lequel? command line helpers
+ *
+ * Option parsing shared by the command line programs (lequel_bench, lequel_server,
+ * build_profiles).
+ */
+
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+bool parseUnsigned(const char* text, unsigned int& value);
+
+#endif
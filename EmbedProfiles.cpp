@@ -0,0 +1,192 @@
+/**
+ * @brief Lequel? model embedder
+ *
+ * Writes a C++ source holding the language model as constant arrays (see EmbeddedModel.h),
+ * for programs built with LEQUEL_EMBEDDED_MODEL:
+ *
+ *   embed_profiles resources/languagecode_names_es.csv resources/trigrams/ EmbeddedModelData.cpp
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CSVData.h"
+#include "EmbeddedModel.h"
+
+using namespace std;
+
+// Values written per line of an array
+#define VALUES_PER_LINE 12
+// Bytes written per string literal of a string table
+#define BYTES_PER_LITERAL 64
+
+/**
+ * @name writeStringTable
+ * @brief Writes strings as one byte array, in literals escaped byte by byte, and an array of
+ * the offsets where each one starts.
+ *
+ * @param output The source being written
+ * @param name Name of the byte array; the offsets array adds "_OFFSETS"
+ * @param strings The strings
+ */
+static void writeStringTable(ostream& output, const string& name, const vector<string>& strings) {
+    string bytes;
+    vector<uint32_t> offsets(1, 0);
+    for (auto& value : strings) {
+        bytes += value;
+        offsets.push_back((uint32_t)bytes.length());
+    }
+
+    output << "static const char " << name << "[] =";
+    if (bytes.empty())
+        output << " \"\"";
+    for (size_t begin = 0; begin < bytes.length(); begin += BYTES_PER_LITERAL) {
+        output << "\n    \"";
+        size_t end = min(bytes.length(), begin + BYTES_PER_LITERAL);
+        for (size_t i = begin; i < end; i++) {
+            unsigned char byte = bytes[i];
+            if (byte >= ' ' && byte < 0x7F && byte != '"' && byte != '\\' && byte != '?') {
+                output << (char)byte;
+            } else {
+                // Octal escapes stop after three digits, whatever follows them
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\%03o", byte);
+                output << escape;
+            }
+        }
+        output << "\"";
+    }
+    output << ";\n\n";
+
+    output << "static const uint32_t " << name << "_OFFSETS[] = {";
+    for (size_t i = 0; i < offsets.size(); i++)
+        output << (i % VALUES_PER_LINE ? " " : "\n    ") << offsets[i] << ",";
+    output << "\n};\n\n";
+}
+
+/**
+ * @name writeArray
+ * @brief Writes an array of unsigned integers.
+ *
+ * @param output The source being written
+ * @param name Name of the array
+ * @param values The values
+ */
+static void writeArray(ostream& output, const string& name, const vector<uint32_t>& values) {
+    output << "static const uint32_t " << name << "[] = {";
+    for (size_t i = 0; i < values.size(); i++)
+        output << (i % VALUES_PER_LINE ? " " : "\n    ") << values[i] << ",";
+    if (values.empty())
+        output << "0";  // Arrays can't be empty
+    output << "\n};\n\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        cerr << "Usage: " << argv[0] << " NAMES_CSV TRIGRAMS_FOLDER OUTPUT\n"
+             << "Writes the language model as a C++ source of constant arrays." << endl;
+        return 1;
+    }
+
+    string namesPath = argv[1];
+    string trigramsPath = argv[2];
+    string outputPath = argv[3];
+
+    // Reads every language, as loadLanguagesData does
+    CSVData names;
+    if (!readCSV(namesPath, names)) {
+        cerr << "Error: could not read " << namesPath << endl;
+        return 1;
+    }
+
+    vector<string> codes;
+    vector<string> languageNames;
+    vector<TrigramProfile> profiles;
+    for (auto& fields : names) {
+        if (fields.size() != 2)
+            continue;
+
+        profiles.push_back(TrigramProfile());
+        if (!readLanguageProfile(trigramsPath, fields[0], profiles.back())) {
+            cerr << "Error: could not read the profile of " << fields[0] << endl;
+            return 1;
+        }
+        codes.push_back(fields[0]);
+        languageNames.push_back(fields[1]);
+    }
+
+    // Dictionary: every trigram once, sorted
+    vector<string> trigrams;
+    for (auto& profile : profiles) {
+        for (auto& entry : profile)
+            trigrams.push_back(entry.first);
+    }
+    sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    unordered_map<string, uint32_t> trigramIndexes;
+    trigramIndexes.reserve(trigrams.size());
+    for (size_t i = 0; i < trigrams.size(); i++)
+        trigramIndexes[trigrams[i]] = (uint32_t)i;
+
+    // Entries of each language, in dictionary order
+    vector<uint32_t> entryTrigrams;
+    vector<uint32_t> entryCounts;
+    vector<uint32_t> languageEntries(1, 0);
+    for (auto& profile : profiles) {
+        vector<pair<uint32_t, uint32_t>> entries;
+        entries.reserve(profile.size());
+        for (auto& entry : profile)
+            entries.push_back(make_pair(trigramIndexes[entry.first], (uint32_t)entry.second.real));
+        sort(entries.begin(), entries.end());
+
+        for (auto& entry : entries) {
+            entryTrigrams.push_back(entry.first);
+            entryCounts.push_back(entry.second);
+        }
+        languageEntries.push_back((uint32_t)entryTrigrams.size());
+    }
+
+    ofstream output(outputPath);
+    if (!output.is_open()) {
+        cerr << "Error: could not write " << outputPath << endl;
+        return 1;
+    }
+
+    output << "// Generated by embed_profiles from " << namesPath << " and " << trigramsPath
+           << ": do not edit\n\n"
+           << "#include \"EmbeddedModel.h\"\n\n";
+
+    writeStringTable(output, "TRIGRAMS", trigrams);
+    writeArray(output, "ENTRY_TRIGRAMS", entryTrigrams);
+    writeArray(output, "ENTRY_COUNTS", entryCounts);
+    writeArray(output, "LANGUAGE_ENTRIES", languageEntries);
+    writeStringTable(output, "CODES", codes);
+    writeStringTable(output, "NAMES", languageNames);
+
+    output << "const embeddedModel_t EMBEDDED_MODEL = {\n"
+           << "    " << codes.size() << ",\n"
+           << "    " << trigrams.size() << ",\n"
+           << "    TRIGRAMS,\n    TRIGRAMS_OFFSETS,\n"
+           << "    ENTRY_TRIGRAMS,\n    ENTRY_COUNTS,\n    LANGUAGE_ENTRIES,\n"
+           << "    CODES,\n    CODES_OFFSETS,\n"
+           << "    NAMES,\n    NAMES_OFFSETS,\n"
+           << "};\n";
+
+    output.close();
+    if (!output.good()) {
+        cerr << "Error: could not write " << outputPath << endl;
+        return 1;
+    }
+
+    cout << codes.size() << " languages, " << trigrams.size() << " trigrams, "
+         << entryTrigrams.size() << " entries -> " << outputPath << endl;
+    return 0;
+}
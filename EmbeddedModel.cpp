@@ -0,0 +1,68 @@
+/**
+ * @brief Lequel? language model compiled into the program
+ */
+
+#include "EmbeddedModel.h"
+
+#include <string>
+
+using namespace std;
+
+/**
+ * @name getEmbeddedString
+ * @brief Returns a string of a compiled-in string table.
+ *
+ * @param bytes The concatenated strings
+ * @param offsets Where each string starts, and one past the last
+ * @param index The string index
+ * @return The string
+ */
+static string getEmbeddedString(const char* bytes, const uint32_t* offsets, uint32_t index) {
+    return string(bytes + offsets[index], offsets[index + 1] - offsets[index]);
+}
+
+/**
+ * @name loadEmbeddedModel
+ * @brief Fills a language model from the tables of a compiled-in model, as loadLanguagesData
+ * does from the files they were generated from.
+ *
+ * @param embedded The compiled-in model
+ * @param model The language model to fill: names, trigram profiles and script sub-models
+ * @return false if the tables are inconsistent
+ */
+bool loadEmbeddedModel(const embeddedModel_t& embedded, LanguageModel& model) {
+    const uint32_t entryCount = embedded.languageEntries[embedded.languageCount];
+
+    for (uint32_t languageIndex = 0; languageIndex < embedded.languageCount; languageIndex++) {
+        uint32_t begin = embedded.languageEntries[languageIndex];
+        uint32_t end = embedded.languageEntries[languageIndex + 1];
+        if (begin > end || end > entryCount)
+            return false;
+
+        string languageCode =
+            getEmbeddedString(embedded.codeBytes, embedded.codeOffsets, languageIndex);
+        model.languageCodeNames[languageCode] =
+            getEmbeddedString(embedded.nameBytes, embedded.nameOffsets, languageIndex);
+
+        model.languages.push_back(LanguageProfile());
+        LanguageProfile& language = model.languages.back();
+        language.languageCode = languageCode;
+
+        language.trigramProfile.reserve(end - begin);
+        for (uint32_t entry = begin; entry < end; entry++) {
+            uint32_t index = embedded.entryTrigrams[entry];
+            if (index >= embedded.trigramCount)
+                return false;
+
+            string trigram =
+                getEmbeddedString(embedded.trigramBytes, embedded.trigramOffsets, index);
+            language.trigramProfile[trigram].real = (float)embedded.entryCounts[entry];
+        }
+
+        normalizeTrigramProfile(language.trigramProfile);
+    }
+
+    indexLanguageModel(model);
+
+    return true;
+}
@@ -0,0 +1,44 @@
+/**
+ * @brief Lequel? language model compiled into the program
+ *
+ * embed_profiles turns the language names CSV and the trigram profiles into a C++ source of
+ * constant arrays, so a program built with it (LEQUEL_EMBEDDED_MODEL) finds its model in
+ * read-only memory when it starts: no resources folder to ship, no file to read or parse.
+ * Strings are stored as one array of bytes plus one of offsets, string i being
+ * [offsets[i], offsets[i + 1]), so the tables hold no pointers to relocate.
+ *
+ *   dictionary the sorted, normalized trigrams of every profile
+ *   entries    per language, the dictionary index and count of each of its trigrams, in
+ *              dictionary order; language i has entries [languageEntries[i],
+ *              languageEntries[i + 1])
+ *   names      the code and name of each language, in the order of the names CSV
+ */
+
+#ifndef EMBEDDEDMODEL_H
+#define EMBEDDEDMODEL_H
+
+#include <stdint.h>
+
+#include "Lequel.h"
+
+// embeddedModel_t: the tables of a compiled-in model
+struct embeddedModel_t {
+    uint32_t languageCount;
+    uint32_t trigramCount;
+    const char* trigramBytes;
+    const uint32_t* trigramOffsets;   // trigramCount + 1 offsets
+    const uint32_t* entryTrigrams;    // Dictionary index of each entry
+    const uint32_t* entryCounts;
+    const uint32_t* languageEntries;  // languageCount + 1 offsets into the entries
+    const char* codeBytes;
+    const uint32_t* codeOffsets;      // languageCount + 1 offsets
+    const char* nameBytes;
+    const uint32_t* nameOffsets;      // languageCount + 1 offsets
+};
+
+// Defined by the source embed_profiles generates
+extern const embeddedModel_t EMBEDDED_MODEL;
+
+bool loadEmbeddedModel(const embeddedModel_t& embedded, LanguageModel& model);
+
+#endif
@@ -0,0 +1,625 @@
+/**
+ * @brief Lequel? file input with transparent decompression
+ *
+ * @cite https://www.zlib.net/manual.html
+ * inflate with automatic gzip header detection, reset between concatenated members
+ * @cite https://facebook.github.io/zstd/zstd_manual.html
+ * streaming decompression (ZSTD_decompressStream)
+ * @cite https://tukaani.org/xz/
+ * lzma_stream_decoder with LZMA_CONCATENATED
+ */
+
+#include "InputStream.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifdef LEQUEL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef LEQUEL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef LEQUEL_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+using namespace std;
+
+static const unsigned char GZIP_MAGIC[] = {0x1F, 0x8B};
+static const unsigned char ZSTD_MAGIC[] = {0x28, 0xB5, 0x2F, 0xFD};
+static const unsigned char XZ_MAGIC[] = {0xFD, 0x37, 0x7A, 0x58, 0x5A, 0x00};
+
+inputStream_t::~inputStream_t() {
+    closeInputStream(*this);
+}
+
+/**
+ * @name hasMagic
+ * @brief Checks whether some data starts with a magic number.
+ *
+ * @param data The data
+ * @param length Number of bytes of data
+ * @param magic The magic number
+ * @param magicLength Number of bytes of magic
+ * @return true if data starts with magic
+ */
+static bool hasMagic(const char* data,
+                     size_t length,
+                     const unsigned char* magic,
+                     size_t magicLength) {
+    return length >= magicLength && !memcmp(data, magic, magicLength);
+}
+
+/**
+ * @name detectCompression
+ * @brief Recognizes a compressed file by its first bytes.
+ *
+ * @param data The first bytes of the file
+ * @param length Number of bytes of data
+ * @return The compression format, COMPRESSION_NONE if none matches
+ */
+compression_t detectCompression(const char* data, size_t length) {
+    if (hasMagic(data, length, GZIP_MAGIC, sizeof(GZIP_MAGIC)))
+        return COMPRESSION_GZIP;
+    if (hasMagic(data, length, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)))
+        return COMPRESSION_ZSTD;
+    if (hasMagic(data, length, XZ_MAGIC, sizeof(XZ_MAGIC)))
+        return COMPRESSION_XZ;
+
+    return COMPRESSION_NONE;
+}
+
+/**
+ * @name getCompressionName
+ * @brief Returns the name of a compression format.
+ *
+ * @param compression The compression format
+ * @return Its name
+ */
+const char* getCompressionName(compression_t compression) {
+    switch (compression) {
+        case COMPRESSION_GZIP:
+            return "gzip";
+        case COMPRESSION_ZSTD:
+            return "zstd";
+        case COMPRESSION_XZ:
+            return "xz";
+        default:
+            return "none";
+    }
+}
+
+/**
+ * @name isCompressionSupported
+ * @brief Checks whether this build can decode a compression format.
+ *
+ * @param compression The compression format
+ * @return true if its library was found at build time
+ */
+bool isCompressionSupported(compression_t compression) {
+    switch (compression) {
+#ifdef LEQUEL_HAVE_ZLIB
+        case COMPRESSION_GZIP:
+#endif
+#ifdef LEQUEL_HAVE_ZSTD
+        case COMPRESSION_ZSTD:
+#endif
+#ifdef LEQUEL_HAVE_LZMA
+        case COMPRESSION_XZ:
+#endif
+        case COMPRESSION_NONE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @name stopInputStream
+ * @brief Stops a stream after an error; the bytes decoded so far can still be consumed.
+ *
+ * @param stream The input stream
+ * @param message What went wrong
+ */
+static void stopInputStream(inputStream_t& stream, const char* message) {
+    fprintf(stderr,
+            "Error while decompressing %s file: %s\n",
+            getCompressionName(stream.compression),
+            message);
+    stream.isDecoderDone = true;
+    stream.hasFailed = true;
+}
+
+/**
+ * @name readInput
+ * @brief Reads the next chunk of compressed bytes, once the previous one is decoded.
+ *
+ * @param stream The input stream
+ * @return true if compressed bytes are pending
+ */
+static bool readInput(inputStream_t& stream) {
+    if (stream.inputBegin < stream.inputEnd)
+        return true;
+    if (stream.isInputDone)
+        return false;
+
+    ssize_t count = read(stream.fd, stream.input.data(), stream.input.size());
+    if (count < 0) {
+        perror("Error while reading file");
+        stream.hasFailed = true;
+    }
+
+    stream.inputBegin = 0;
+    stream.inputEnd = count > 0 ? (size_t)count : 0;
+    stream.inputBytes += stream.inputEnd;
+    if (count <= 0 || (stream.fileSize && stream.inputBytes >= stream.fileSize))
+        stream.isInputDone = true;
+
+    return stream.inputEnd > 0;
+}
+
+/**
+ * @name initDecoder
+ * @brief Creates the decoder of a compressed stream.
+ *
+ * @param stream The input stream (compression set)
+ * @return false if the decoder could not be created
+ */
+static bool initDecoder(inputStream_t& stream) {
+    switch (stream.compression) {
+#ifdef LEQUEL_HAVE_ZLIB
+        case COMPRESSION_GZIP: {
+            z_stream* decoder = new z_stream();
+            // 32: detects the gzip header
+            if (inflateInit2(decoder, 15 + 32) != Z_OK) {
+                delete decoder;
+                return false;
+            }
+            stream.decoder = decoder;
+            return true;
+        }
+#endif
+#ifdef LEQUEL_HAVE_ZSTD
+        case COMPRESSION_ZSTD: {
+            ZSTD_DStream* decoder = ZSTD_createDStream();
+            if (!decoder || ZSTD_isError(ZSTD_initDStream(decoder))) {
+                ZSTD_freeDStream(decoder);
+                return false;
+            }
+            stream.decoder = decoder;
+            return true;
+        }
+#endif
+#ifdef LEQUEL_HAVE_LZMA
+        case COMPRESSION_XZ: {
+            lzma_stream* decoder = new lzma_stream();
+            *decoder = LZMA_STREAM_INIT;
+            if (lzma_stream_decoder(decoder, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+                delete decoder;
+                return false;
+            }
+            stream.decoder = decoder;
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * @name freeDecoder
+ * @brief Frees the decoder of a compressed stream.
+ *
+ * @param stream The input stream
+ */
+static void freeDecoder(inputStream_t& stream) {
+    if (!stream.decoder)
+        return;
+
+    switch (stream.compression) {
+#ifdef LEQUEL_HAVE_ZLIB
+        case COMPRESSION_GZIP:
+            inflateEnd((z_stream*)stream.decoder);
+            delete (z_stream*)stream.decoder;
+            break;
+#endif
+#ifdef LEQUEL_HAVE_ZSTD
+        case COMPRESSION_ZSTD:
+            ZSTD_freeDStream((ZSTD_DStream*)stream.decoder);
+            break;
+#endif
+#ifdef LEQUEL_HAVE_LZMA
+        case COMPRESSION_XZ:
+            lzma_end((lzma_stream*)stream.decoder);
+            delete (lzma_stream*)stream.decoder;
+            break;
+#endif
+        default:
+            break;
+    }
+    stream.decoder = nullptr;
+}
+
+/**
+ * @name decodeChunk
+ * @brief Decodes the pending compressed bytes into at most INPUT_STREAM_CHUNK_BYTES bytes.
+ * Sets isDecoderDone after the last byte, or on corrupt input.
+ *
+ * @param stream The input stream
+ * @param output The destination (at least INPUT_STREAM_CHUNK_BYTES bytes)
+ * @return Number of bytes decoded
+ */
+static size_t decodeChunk(inputStream_t& stream, char* output) {
+    char* input = stream.input.data() + stream.inputBegin;
+    size_t available = stream.inputEnd - stream.inputBegin;
+    size_t produced = 0;
+
+    switch (stream.compression) {
+#ifdef LEQUEL_HAVE_ZLIB
+        case COMPRESSION_GZIP: {
+            z_stream* decoder = (z_stream*)stream.decoder;
+            decoder->next_in = (Bytef*)input;
+            decoder->avail_in = (uInt)available;
+            decoder->next_out = (Bytef*)output;
+            decoder->avail_out = INPUT_STREAM_CHUNK_BYTES;
+
+            int result = inflate(decoder, Z_NO_FLUSH);
+            stream.inputBegin = stream.inputEnd - decoder->avail_in;
+            produced = INPUT_STREAM_CHUNK_BYTES - decoder->avail_out;
+
+            if (result == Z_STREAM_END) {
+                // Another member may follow (concatenated gzip files)
+                if (readInput(stream))
+                    inflateReset(decoder);
+                else
+                    stream.isDecoderDone = true;
+            } else if (result != Z_OK && result != Z_BUF_ERROR)
+                stopInputStream(stream, decoder->msg ? decoder->msg : "corrupt data");
+            break;
+        }
+#endif
+#ifdef LEQUEL_HAVE_ZSTD
+        case COMPRESSION_ZSTD: {
+            ZSTD_inBuffer in = {input, available, 0};
+            ZSTD_outBuffer out = {output, INPUT_STREAM_CHUNK_BYTES, 0};
+
+            size_t result = ZSTD_decompressStream((ZSTD_DStream*)stream.decoder, &out, &in);
+            stream.inputBegin += in.pos;
+            produced = out.pos;
+
+            if (ZSTD_isError(result))
+                stopInputStream(stream, ZSTD_getErrorName(result));
+            else if (!result && !readInput(stream))
+                stream.isDecoderDone = true;  // Last frame complete and flushed
+            break;
+        }
+#endif
+#ifdef LEQUEL_HAVE_LZMA
+        case COMPRESSION_XZ: {
+            lzma_stream* decoder = (lzma_stream*)stream.decoder;
+            decoder->next_in = (const uint8_t*)input;
+            decoder->avail_in = available;
+            decoder->next_out = (uint8_t*)output;
+            decoder->avail_out = INPUT_STREAM_CHUNK_BYTES;
+
+            lzma_ret result = lzma_code(decoder, stream.isInputDone ? LZMA_FINISH : LZMA_RUN);
+            stream.inputBegin = stream.inputEnd - decoder->avail_in;
+            produced = INPUT_STREAM_CHUNK_BYTES - decoder->avail_out;
+
+            if (result == LZMA_STREAM_END)
+                stream.isDecoderDone = true;
+            else if (result != LZMA_OK && result != LZMA_BUF_ERROR)
+                stopInputStream(stream, "corrupt data");
+            break;
+        }
+#endif
+        default:
+            (void)output, (void)input, (void)available;  // No decoder in this build
+            stream.isDecoderDone = true;
+            break;
+    }
+
+    return produced;
+}
+
+/**
+ * @name readChunk
+ * @brief Reads the next chunk of the file, decoded if compressed.
+ *
+ * @param stream The input stream
+ * @param output The destination (at least INPUT_STREAM_CHUNK_BYTES bytes)
+ * @return Number of bytes read, 0 at the end of the stream
+ */
+static size_t readChunk(inputStream_t& stream, char* output) {
+    if (stream.compression == COMPRESSION_NONE) {
+        ssize_t count = read(stream.fd, output, INPUT_STREAM_CHUNK_BYTES);
+        if (count < 0) {
+            perror("Error while reading file");
+            stream.hasFailed = true;
+        }
+        if (count <= 0) {
+            stream.isInputDone = stream.isDecoderDone = true;
+            return 0;
+        }
+
+        stream.inputBytes += count;
+        return (size_t)count;
+    }
+
+    size_t produced = 0;
+    while (!produced && !stream.isDecoderDone) {
+        readInput(stream);
+        size_t inputBegin = stream.inputBegin;
+
+        produced = decodeChunk(stream, output);
+        if (!produced && !stream.isDecoderDone && stream.inputBegin == inputBegin)
+            stopInputStream(stream, "unexpected end of data");
+    }
+
+    return produced;
+}
+
+/**
+ * @name fillInputStream
+ * @brief Drops the consumed bytes from the buffer and appends the next chunk of the file,
+ * decoded if compressed and converted to UTF-8 if needed.
+ *
+ * @param stream The input stream
+ * @return false at the end of the stream
+ */
+static bool fillInputStream(inputStream_t& stream) {
+    if (stream.isDecoderDone)
+        return false;
+
+    if (stream.begin > 0) {
+        memmove(stream.buffer.data(),
+                stream.buffer.data() + stream.begin,
+                stream.end - stream.begin);
+        stream.end -= stream.begin;
+        stream.begin = 0;
+    }
+
+    bool isTranscoded = stream.transcoder.encoding != ENCODING_UTF8;
+    size_t capacity = isTranscoded ? TRANSCODED_MAX_BYTES(INPUT_STREAM_CHUNK_BYTES)
+                                   : INPUT_STREAM_CHUNK_BYTES;
+    if (stream.buffer.size() < stream.end + capacity)
+        stream.buffer.resize(stream.end + capacity);  // A very long line
+
+    // A chunk may convert to nothing (a lone byte order mark, half a UTF-16 character)
+    size_t produced = 0;
+    while (!produced && !stream.isDecoderDone) {
+        char* output = isTranscoded ? stream.chunk.data() : stream.buffer.data() + stream.end;
+        size_t count = readChunk(stream, output);
+        stream.decodedBytes += count;
+
+        produced = isTranscoded ? transcodeToUTF8(stream.transcoder,
+                                                  output,
+                                                  count,
+                                                  stream.buffer.data() + stream.end)
+                                : count;
+    }
+
+    stream.end += produced;
+
+    return produced > 0;
+}
+
+/**
+ * @name openInputStream
+ * @brief Opens a file and recognizes its compression format.
+ *
+ * @param path The file path
+ * @param stream The destination stream (closed first; keeps its buffers)
+ * @return false if the file could not be read or its format is not supported by this build
+ */
+bool openInputStream(const char* path, inputStream_t& stream) {
+    closeInputStream(stream);
+
+    stream.fd = open(path, O_RDONLY);
+    struct stat fileStatus;
+    if (stream.fd < 0 || fstat(stream.fd, &fileStatus) < 0) {
+        perror(("Error while opening file " + string(path)).c_str());
+        closeInputStream(stream);
+        return false;
+    }
+
+    stream.fileSize = (size_t)fileStatus.st_size;
+    stream.input.resize(INPUT_STREAM_CHUNK_BYTES);
+    stream.buffer.resize(INPUT_STREAM_CHUNK_BYTES);
+    stream.isInputDone = false;
+    stream.isDecoderDone = false;
+    readInput(stream);
+
+    stream.compression = detectCompression(stream.input.data(), stream.inputEnd);
+    if (!isCompressionSupported(stream.compression)) {
+        fprintf(stderr,
+                "Error while opening file %s: %s files are not supported by this build\n",
+                path,
+                getCompressionName(stream.compression));
+        closeInputStream(stream);
+        return false;
+    }
+
+    if (stream.compression == COMPRESSION_NONE) {
+        // The bytes read are the first decoded bytes
+        memcpy(stream.buffer.data(), stream.input.data(), stream.inputEnd);
+        stream.end = stream.inputEnd;
+        stream.decodedBytes = stream.inputEnd;
+        stream.inputBegin = stream.inputEnd = 0;
+        stream.isDecoderDone = stream.isInputDone;
+        return true;
+    }
+
+    if (!initDecoder(stream)) {
+        fprintf(stderr, "Error while opening file %s: could not create the decoder\n", path);
+        closeInputStream(stream);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @name closeInputStream
+ * @brief Closes the file of a stream and frees its decoder. The buffers are kept for the next
+ * file opened with the stream.
+ *
+ * @param stream The input stream
+ */
+void closeInputStream(inputStream_t& stream) {
+    freeDecoder(stream);
+    if (stream.fd >= 0)
+        close(stream.fd);
+
+    stream.fd = -1;
+    stream.compression = COMPRESSION_NONE;
+    stream.inputBegin = stream.inputEnd = 0;
+    stream.begin = stream.end = stream.scanned = 0;
+    stream.fileSize = stream.inputBytes = stream.decodedBytes = 0;
+    stream.isInputDone = stream.isDecoderDone = true;
+    stream.hasFailed = false;
+    stream.transcoder = transcoder_t();
+}
+
+/**
+ * @name setInputStreamEncoding
+ * @brief Sets the encoding of the text of a stream: the bytes not yet consumed and the rest of
+ * the stream are converted to UTF-8. Call it before consuming anything (peeks are fine).
+ *
+ * @param stream The input stream
+ * @param encoding The encoding (see detectEncoding)
+ */
+void setInputStreamEncoding(inputStream_t& stream, encoding_t encoding) {
+    stream.transcoder = transcoder_t();
+    stream.transcoder.encoding = encoding;
+    stream.scanned = 0;
+
+    if (encoding == ENCODING_UTF8) {
+        if (stream.end - stream.begin >= 3 &&
+            !memcmp(stream.buffer.data() + stream.begin, "\xEF\xBB\xBF", 3))
+            stream.begin += 3;  // Byte order mark
+        return;
+    }
+
+    // Converts the bytes already in the buffer
+    vector<char> pending(stream.buffer.data() + stream.begin, stream.buffer.data() + stream.end);
+    if (stream.buffer.size() < TRANSCODED_MAX_BYTES(pending.size()))
+        stream.buffer.resize(TRANSCODED_MAX_BYTES(pending.size()));
+
+    stream.begin = 0;
+    stream.end =
+        transcodeToUTF8(stream.transcoder, pending.data(), pending.size(), stream.buffer.data());
+    stream.chunk.resize(INPUT_STREAM_CHUNK_BYTES);
+}
+
+/**
+ * @name peekInputStream
+ * @brief Copies the first bytes not yet consumed, without consuming them.
+ *
+ * @param stream The input stream
+ * @param count Number of bytes wanted
+ * @param text The destination bytes (fewer than count at the end of the stream)
+ * @return false if no bytes are left
+ */
+bool peekInputStream(inputStream_t& stream, size_t count, std::string& text) {
+    while (stream.end - stream.begin < count && fillInputStream(stream))
+        ;
+
+    text.assign(stream.buffer.data() + stream.begin, min(count, stream.end - stream.begin));
+    return !text.empty();
+}
+
+/**
+ * @name readInputLine
+ * @brief Reads the next line, like std::getline: the '\n' is dropped, a '\r' before it is
+ * kept, and the last line may have no '\n'.
+ *
+ * @param stream The input stream
+ * @param line The destination line
+ * @return false if no bytes are left
+ */
+bool readInputLine(inputStream_t& stream, std::string& line) {
+    while (true) {
+        const char* data = stream.buffer.data();
+        size_t searchBegin = stream.begin + stream.scanned;
+        const void* newline = searchBegin < stream.end
+                                  ? memchr(data + searchBegin, '\n', stream.end - searchBegin)
+                                  : nullptr;
+
+        if (newline) {
+            size_t lineEnd = (const char*)newline - data;
+            line.assign(data + stream.begin, lineEnd - stream.begin);
+            stream.begin = lineEnd + 1;
+            stream.scanned = 0;
+            return true;
+        }
+
+        stream.scanned = stream.end - stream.begin;
+        if (!fillInputStream(stream))
+            break;
+    }
+
+    stream.scanned = 0;
+    if (stream.begin == stream.end)
+        return false;
+
+    line.assign(stream.buffer.data() + stream.begin, stream.end - stream.begin);
+    stream.begin = stream.end;
+    return true;
+}
+
+/**
+ * @name readInputStream
+ * @brief Appends the rest of a stream to a string.
+ *
+ * @param stream The input stream
+ * @param text The destination string
+ * @param maxBytes Most bytes appended
+ * @return false if a read or decoding error cut the stream short
+ */
+bool readInputStream(inputStream_t& stream, std::string& text, size_t maxBytes) {
+    size_t start = text.length();
+
+    do {
+        size_t buffered = min(stream.end - stream.begin, maxBytes - (text.length() - start));
+        text.append(stream.buffer.data() + stream.begin, buffered);
+        stream.begin += buffered;
+        stream.scanned = 0;
+
+        if (text.length() - start == maxBytes)
+            break;
+
+        // Uncompressed files are read straight into the string
+        if (stream.compression == COMPRESSION_NONE && !stream.isDecoderDone &&
+            stream.transcoder.encoding == ENCODING_UTF8 && stream.fileSize > stream.inputBytes) {
+            size_t length = text.length();
+            text.resize(length + min(stream.fileSize - stream.inputBytes,
+                                     maxBytes - (length - start)));
+
+            while (length < text.length()) {
+                ssize_t count = read(stream.fd, &text[length], text.length() - length);
+                if (count < 0) {
+                    perror("Error while reading file");
+                    stream.hasFailed = true;
+                }
+                if (count <= 0) {
+                    stream.isInputDone = stream.isDecoderDone = true;
+                    break;
+                }
+                length += count;
+                stream.inputBytes += count;
+                stream.decodedBytes += count;
+            }
+            text.resize(length);
+        }
+    } while (fillInputStream(stream));
+
+    return !stream.hasFailed;
+}
@@ -0,0 +1,91 @@
+/**
+ * @brief Lequel? file input with transparent decompression
+ *
+ * Files compressed with gzip, zstd or xz are recognized by their magic bytes and decoded as
+ * they are read, a chunk at a time, into a buffer the caller consumes in place: only the
+ * decoded bytes the caller asks for are ever produced, so reading the first lines of a large
+ * compressed file decodes just its first few KB. Consumed bytes are dropped from the buffer
+ * before it is refilled, so it only grows for lines longer than itself.
+ * Each format is available when its library was found at build time (LEQUEL_HAVE_ZLIB,
+ * LEQUEL_HAVE_ZSTD, LEQUEL_HAVE_LZMA); other files are read as they are.
+ * Text that is not UTF-8 is converted as it is decoded, once its encoding is set (see
+ * TextEncoding.h).
+ */
+
+#ifndef INPUTSTREAM_H
+#define INPUTSTREAM_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "TextEncoding.h"
+
+// Bytes read from the file, and decoded, at a time
+#define INPUT_STREAM_CHUNK_BYTES (1 << 14)
+
+// compression_t: format of a file, from its magic bytes
+typedef enum {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_GZIP,  // 1F 8B (zlib)
+    COMPRESSION_ZSTD,  // 28 B5 2F FD (libzstd)
+    COMPRESSION_XZ     // FD 37 7A 58 5A 00 (liblzma)
+} compression_t;
+
+// inputStream_t: a file being read, decoded if compressed
+struct inputStream_t {
+    int fd = -1;
+    compression_t compression = COMPRESSION_NONE;
+    void* decoder = nullptr;       // z_stream, ZSTD_DStream or lzma_stream
+    std::vector<char> input;       // Compressed bytes read from the file
+    size_t inputBegin = 0;         // Compressed bytes not yet decoded: [inputBegin, inputEnd)
+    size_t inputEnd = 0;
+    transcoder_t transcoder;       // Converts the decoded bytes when not UTF-8
+    std::vector<char> chunk;       // Decoded bytes before conversion
+    std::vector<char> buffer;      // Decoded bytes (converted to UTF-8)
+    size_t begin = 0;              // Decoded bytes not yet consumed: [begin, end)
+    size_t end = 0;
+    size_t scanned = 0;            // Bytes after begin already searched for a line break
+    size_t fileSize = 0;
+    size_t inputBytes = 0;         // Bytes read from the file
+    size_t decodedBytes = 0;       // Bytes decoded (the bytes read, for uncompressed files)
+    bool isInputDone = true;       // The end of the file was reached (or no file is open)
+    bool isDecoderDone = true;     // The last byte was decoded, or decoding stopped
+    bool hasFailed = false;        // A read or decoding error stopped the stream
+
+    inputStream_t() {}
+    // decoder is owned by the stream
+    inputStream_t(const inputStream_t&) = delete;
+    inputStream_t& operator=(const inputStream_t&) = delete;
+    ~inputStream_t();
+};
+
+/**
+ * @name getInputStreamPosition
+ * @brief Returns how far into the file the consumed bytes reach, for progress reports.
+ *
+ * @param stream The input stream
+ * @return File bytes behind the consumed bytes (compressed bytes, for compressed files)
+ */
+inline size_t getInputStreamPosition(const inputStream_t& stream) {
+    if (stream.compression == COMPRESSION_NONE && stream.transcoder.encoding == ENCODING_UTF8)
+        return stream.decodedBytes - (stream.end - stream.begin);
+    if (stream.compression == COMPRESSION_NONE)
+        return stream.decodedBytes;  // Converted bytes: a chunk at a time
+
+    return stream.inputBytes - (stream.inputEnd - stream.inputBegin);
+}
+
+compression_t detectCompression(const char* data, size_t length);
+const char* getCompressionName(compression_t compression);
+bool isCompressionSupported(compression_t compression);
+
+bool openInputStream(const char* path, inputStream_t& stream);
+void closeInputStream(inputStream_t& stream);
+void setInputStreamEncoding(inputStream_t& stream, encoding_t encoding);
+bool peekInputStream(inputStream_t& stream, size_t count, std::string& text);
+bool readInputLine(inputStream_t& stream, std::string& line);
+bool readInputStream(inputStream_t& stream, std::string& text, size_t maxBytes = (size_t)-1);
+
+#endif
@@ -0,0 +1,187 @@
+/**
+ * @brief Lequel? language clusters
+ */
+
+#include "LanguageClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * @name getLanguageSimilarities
+ * @brief Computes the cosine similarity of every pair of language profiles through the
+ * inverted index, so only trigrams two languages share are visited.
+ *
+ * @param model The language model (indexed)
+ * @param similarities The destination n x n matrix, n being the number of languages
+ */
+static void getLanguageSimilarities(const LanguageModel& model, vector<float>& similarities) {
+    size_t languageCount = model.scriptLanguages[SCRIPT_UNKNOWN].size();
+
+    similarities.assign(languageCount * languageCount, 0.0f);
+    for (auto& entry : model.trigramIndex) {
+        const vector<trigramPosting_t>& postings = entry.second;
+
+        for (size_t a = 0; a < postings.size(); a++) {
+            float* row = &similarities[postings[a].language * languageCount];
+            for (size_t b = a + 1; b < postings.size(); b++)
+                row[postings[b].language] += postings[a].weight * postings[b].weight;
+        }
+    }
+
+    // Postings are sorted by language, so only the upper triangle was filled
+    for (size_t a = 0; a < languageCount; a++) {
+        for (size_t b = a + 1; b < languageCount; b++)
+            similarities[b * languageCount + a] = similarities[a * languageCount + b];
+    }
+}
+
+/**
+ * @name buildCentroid
+ * @brief Builds the profile of a cluster: the mean of the real values of its languages, and
+ * the normalized mean of their normalized values, keeping the CLUSTER_CENTROID_TRIGRAMS
+ * strongest entries.
+ *
+ * @param model The language model
+ * @param cluster The cluster (members set)
+ */
+static void buildCentroid(const LanguageModel& model, languageCluster_t& cluster) {
+    const LanguageCandidates& allLanguages = model.scriptLanguages[SCRIPT_UNKNOWN];
+    TrigramProfile sums;
+
+    for (unsigned int member : cluster.members) {
+        for (auto& entry : allLanguages[member]->trigramProfile) {
+            value_t& sum = sums[entry.first];
+            sum.real += entry.second.real;
+            sum.normalized += entry.second.normalized;
+        }
+    }
+
+    vector<pair<float, const string*>> entries;
+    entries.reserve(sums.size());
+    for (auto& entry : sums)
+        entries.push_back(make_pair(-entry.second.normalized, &entry.first));
+    if (entries.size() > CLUSTER_CENTROID_TRIGRAMS) {
+        nth_element(entries.begin(), entries.begin() + CLUSTER_CENTROID_TRIGRAMS, entries.end());
+        entries.resize(CLUSTER_CENTROID_TRIGRAMS);
+    }
+
+    float sumSquares = 0.0f;
+    for (auto& entry : entries)
+        sumSquares += entry.first * entry.first;
+    float invNorm = sumSquares > 0.0f ? 1.0f / sqrtf(sumSquares) : 0.0f;
+
+    cluster.centroid.clear();
+    cluster.centroid.reserve(entries.size());
+    for (auto& entry : entries) {
+        value_t& value = cluster.centroid[*entry.second];
+        value.real = sums[*entry.second].real / cluster.members.size();
+        value.normalized = -entry.first * invNorm;
+    }
+    aggregateTrigramProfile(cluster.centroid, cluster.centroidAggregates);
+}
+
+/**
+ * @name clusterCandidates
+ * @brief Clusters the candidates of one script: every language starts alone and the two
+ * clusters with the highest mean pairwise similarity are merged until no pair reaches
+ * CLUSTER_SIMILARITY without exceeding CLUSTER_MAX_LANGUAGES.
+ *
+ * @param model The language model
+ * @param candidates Indexes of the candidates into scriptLanguages[SCRIPT_UNKNOWN]
+ * @param similarities Similarities of every pair of languages
+ * @param clusters The destination clusters
+ */
+static void clusterCandidates(const LanguageModel& model,
+                              const vector<unsigned int>& candidates,
+                              const vector<float>& similarities,
+                              LanguageClusters& clusters) {
+    size_t languageCount = model.scriptLanguages[SCRIPT_UNKNOWN].size();
+    size_t count = candidates.size();
+
+    // Mean similarity between clusters, updated as they merge (Lance-Williams)
+    vector<float> linkage(count * count);
+    for (size_t a = 0; a < count; a++) {
+        for (size_t b = 0; b < count; b++)
+            linkage[a * count + b] = similarities[candidates[a] * languageCount + candidates[b]];
+    }
+
+    vector<vector<unsigned int>> members(count);
+    for (size_t a = 0; a < count; a++)
+        members[a].push_back(candidates[a]);
+
+    while (true) {
+        float best = CLUSTER_SIMILARITY;
+        size_t bestA = count;
+        size_t bestB = count;
+
+        for (size_t a = 0; a < count; a++) {
+            if (members[a].empty())
+                continue;
+
+            for (size_t b = a + 1; b < count; b++) {
+                if (members[b].empty() ||
+                    members[a].size() + members[b].size() > CLUSTER_MAX_LANGUAGES)
+                    continue;
+
+                if (linkage[a * count + b] >= best) {
+                    best = linkage[a * count + b];
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+
+        if (bestA == count)
+            break;
+
+        float sizeA = (float)members[bestA].size();
+        float sizeB = (float)members[bestB].size();
+        for (size_t c = 0; c < count; c++) {
+            float merged =
+                (sizeA * linkage[bestA * count + c] + sizeB * linkage[bestB * count + c]) /
+                (sizeA + sizeB);
+            linkage[bestA * count + c] = merged;
+            linkage[c * count + bestA] = merged;
+        }
+
+        members[bestA].insert(members[bestA].end(), members[bestB].begin(), members[bestB].end());
+        members[bestB].clear();
+    }
+
+    clusters.clear();
+    for (auto& clusterMembers : members) {
+        if (clusterMembers.empty())
+            continue;
+
+        clusters.push_back(languageCluster_t());
+        clusters.back().members = clusterMembers;
+        buildCentroid(model, clusters.back());
+    }
+}
+
+/**
+ * @name clusterLanguageModel
+ * @brief Builds the clusters of every script sub-model. Called by indexLanguageModel.
+ *
+ * @param model The language model (indexed)
+ */
+void clusterLanguageModel(LanguageModel& model) {
+    const LanguageCandidates& allLanguages = model.scriptLanguages[SCRIPT_UNKNOWN];
+    vector<float> similarities;
+    getLanguageSimilarities(model, similarities);
+
+    unordered_map<const LanguageProfile*, unsigned int> indexes;
+    for (unsigned int i = 0; i < allLanguages.size(); i++)
+        indexes[allLanguages[i]] = i;
+
+    for (int script = 0; script < SCRIPT_COUNT; script++) {
+        vector<unsigned int> candidates;
+        for (auto language : model.scriptLanguages[script])
+            candidates.push_back(indexes[language]);
+
+        clusterCandidates(model, candidates, similarities, model.scriptClusters[script]);
+    }
+}
@@ -0,0 +1,31 @@
+/**
+ * @brief Lequel? language clusters
+ *
+ * Related languages (Spanish, Asturian, Galician, Portuguese; the Scandinavian languages;
+ * the South Slavic languages) have similar profiles. Grouping them lets an identification
+ * score one centroid per cluster first and then only the languages of the best clusters
+ * (settings_t::clusterBeam), instead of every language.
+ *
+ * Clusters are built per script sub-model by average-linkage agglomerative clustering on the
+ * cosine similarity of the language profiles.
+ *
+ * @cite
+ * https://nlp.stanford.edu/IR-book/html/htmledition/group-average-agglomerative-clustering-1.html
+ * group-average agglomerative clustering
+ */
+
+#ifndef LANGUAGECLUSTERS_H
+#define LANGUAGECLUSTERS_H
+
+#include "Lequel.h"
+
+// Minimum mean similarity between the languages of two clusters to merge them
+#define CLUSTER_SIMILARITY 0.2f
+// Maximum languages per cluster
+#define CLUSTER_MAX_LANGUAGES 12
+// Entries kept per centroid, as in a language profile
+#define CLUSTER_CENTROID_TRIGRAMS 2000
+
+void clusterLanguageModel(LanguageModel& model);
+
+#endif
@@ -0,0 +1,306 @@
+/**
+ * @brief Lequel? compressed inverted index for large language sets
+ */
+
+#include "LanguageIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "BloomFilter.h"
+
+using namespace std;
+
+// indexPosting_t: a posting before compression
+struct indexPosting_t {
+    unsigned int impact;
+    unsigned int language;
+};
+
+typedef unordered_map<string, vector<indexPosting_t>> PostingLists;
+
+// indexSegment_t: a segment of a posting list being scored
+struct indexSegment_t {
+    float contribution;  // Added to the score of every language of the segment
+    uint32_t count;
+    const uint8_t* languages;
+};
+
+/**
+ * @name appendVarint
+ * @brief Appends an unsigned integer, 7 bits per byte, lowest bits first.
+ *
+ * @param buffer The destination
+ * @param value The value
+ */
+static void appendVarint(vector<uint8_t>& buffer, uint32_t value) {
+    while (value >= 0x80) {
+        buffer.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((uint8_t)value);
+}
+
+/**
+ * @name readVarint
+ * @brief Reads an unsigned integer written by appendVarint (the index is trusted).
+ *
+ * @param data Position to read from, moved past the value
+ * @return The value
+ */
+static inline uint32_t readVarint(const uint8_t*& data) {
+    uint32_t value = *data & 0x7F;
+
+    for (int shift = 7; *data++ & 0x80; shift += 7)
+        value |= (uint32_t)(*data & 0x7F) << shift;
+
+    return value;
+}
+
+/**
+ * @name getShard
+ * @brief Picks the shard of a trigram.
+ *
+ * @param trigram The trigram
+ * @return The shard number
+ */
+static inline size_t getShard(const string& trigram) {
+    return hashBloomKey(trigram) % LANGUAGE_INDEX_SHARDS;
+}
+
+/**
+ * @name encodePostingLists
+ * @brief Compresses the posting lists into the shards, skipping impacts below
+ * index.minImpact.
+ *
+ * @param postings Posting lists sorted by decreasing impact, then by language
+ * @param index The destination index
+ */
+static void encodePostingLists(const PostingLists& postings, languageIndex_t& index) {
+    vector<uint8_t> languages;
+
+    for (auto& shard : index.shards) {
+        shard.lists.clear();
+        shard.data.clear();
+    }
+    index.postingCount = 0;
+
+    for (auto& entry : postings) {
+        const vector<indexPosting_t>& list = entry.second;
+        size_t end = 0;
+        while (end < list.size() && list[end].impact >= index.minImpact)
+            end++;
+        if (!end)
+            continue;
+
+        languageIndexShard_t& shard = index.shards[getShard(entry.first)];
+        shard.lists[entry.first] = (uint32_t)shard.data.size();
+
+        unsigned int segmentCount = 1;
+        for (size_t i = 1; i < end; i++)
+            segmentCount += list[i].impact != list[i - 1].impact;
+        appendVarint(shard.data, segmentCount);
+
+        for (size_t first = 0; first < end;) {
+            size_t last = first;
+            languages.clear();
+            unsigned int previous = 0;
+            while (last < end && list[last].impact == list[first].impact) {
+                appendVarint(languages, list[last].language - previous);
+                previous = list[last].language;
+                last++;
+            }
+
+            shard.data.push_back((uint8_t)list[first].impact);
+            appendVarint(shard.data, (uint32_t)(last - first));
+            appendVarint(shard.data, (uint32_t)languages.size());
+            shard.data.insert(shard.data.end(), languages.begin(), languages.end());
+
+            first = last;
+        }
+
+        index.postingCount += end;
+    }
+
+    for (auto& shard : index.shards)
+        shard.data.shrink_to_fit();
+}
+
+/**
+ * @name buildLanguageIndex
+ * @brief Builds the index of a set of language profiles (normalized).
+ * Weights are quantized on a square-root scale, which keeps more levels for the many small
+ * weights. If the index exceeds budgetBytes, the lowest impacts are pruned until it fits.
+ *
+ * @param languages The languages; their positions are the language ids of the index
+ * @param budgetBytes Memory budget (0: no budget)
+ * @param index The destination index
+ */
+void buildLanguageIndex(const LanguageCandidates& languages,
+                        size_t budgetBytes,
+                        languageIndex_t& index) {
+    float maxWeight = 0.0f;
+    for (auto language : languages) {
+        for (auto& entry : language->trigramProfile)
+            maxWeight = max(maxWeight, entry.second.normalized);
+    }
+    if (maxWeight == 0.0f)
+        maxWeight = 1.0f;
+
+    unsigned int topImpact = LANGUAGE_INDEX_IMPACTS - 1;
+    for (unsigned int impact = 0; impact <= topImpact; impact++) {
+        float level = (float)impact / topImpact;
+        index.impactWeights[impact] = level * level * maxWeight;
+    }
+
+    PostingLists postings;
+    size_t histogram[LANGUAGE_INDEX_IMPACTS] = {};
+    for (unsigned int i = 0; i < languages.size(); i++) {
+        for (auto& entry : languages[i]->trigramProfile) {
+            float level = sqrtf(entry.second.normalized / maxWeight);
+            unsigned int impact = (unsigned int)ceilf(topImpact * level);
+            impact = max(1u, min(topImpact, impact));
+
+            indexPosting_t posting = {impact, i};
+            postings[entry.first].push_back(posting);
+            histogram[impact]++;
+        }
+    }
+
+    for (auto& entry : postings) {
+        sort(entry.second.begin(),
+             entry.second.end(),
+             [](const indexPosting_t& a, const indexPosting_t& b) {
+                 return a.impact != b.impact ? a.impact > b.impact : a.language < b.language;
+             });
+    }
+
+    index.languageCount = (unsigned int)languages.size();
+    index.minImpact = 1;
+    encodePostingLists(postings, index);
+
+    // Prunes the lowest impacts, assuming every posting costs the current mean
+    while (budgetBytes && index.postingCount && index.minImpact < topImpact &&
+           getLanguageIndexBytes(index) > budgetBytes) {
+        double postingBytes = (double)getLanguageIndexBytes(index) / index.postingCount;
+        size_t keep = (size_t)(budgetBytes / postingBytes);
+
+        unsigned int impact = topImpact;
+        size_t kept = histogram[impact];
+        while (impact > 1 && kept + histogram[impact - 1] <= keep)
+            kept += histogram[--impact];
+
+        index.minImpact = max(impact, index.minImpact + 1);
+        encodePostingLists(postings, index);
+    }
+}
+
+/**
+ * @name getLanguageIndexBytes
+ * @brief Estimates the memory used by an index.
+ *
+ * @param index The index
+ * @return Bytes
+ */
+size_t getLanguageIndexBytes(const languageIndex_t& index) {
+    // Hash table node: next pointer, key and offset, cached hash
+    size_t nodeBytes = sizeof(void*) + sizeof(pair<const string, uint32_t>) + sizeof(size_t);
+    size_t bytes = sizeof(index);
+
+    for (auto& shard : index.shards) {
+        bytes += shard.data.capacity();
+        bytes += shard.lists.bucket_count() * sizeof(void*) + shard.lists.size() * nodeBytes;
+    }
+
+    return bytes;
+}
+
+/**
+ * @name rankLanguages
+ * @brief Scores a text against the languages of an index and keeps the best ones.
+ * Segments are visited by decreasing contribution; with a posting budget the scores are
+ * approximate, but the postings left out are those that contribute the least.
+ *
+ * @param index The index
+ * @param profile The text profile
+ * @param maxPostings Posting budget (0: every posting)
+ * @param topK Number of languages ranked
+ * @param ranking The destination ranking, best first
+ */
+void rankLanguages(const languageIndex_t& index,
+                   const textProfile_t& profile,
+                   size_t maxPostings,
+                   size_t topK,
+                   std::vector<languageScore_t>& ranking) {
+    thread_local vector<float> scores;
+    thread_local vector<unsigned int> touched;
+    thread_local vector<indexSegment_t> segments;
+
+    if (scores.size() < index.languageCount)
+        scores.assign(index.languageCount, 0.0f);
+    segments.clear();
+
+    float textInvNorm = getTextInvNorm(profile);
+    forEachTextTrigram(profile, [&](const string& trigram, float count) {
+        const languageIndexShard_t& shard = index.shards[getShard(trigram)];
+        auto list = shard.lists.find(trigram);
+        if (list == shard.lists.end())
+            return;
+
+        const uint8_t* data = &shard.data[list->second];
+        uint32_t segmentCount = readVarint(data);
+        for (uint32_t i = 0; i < segmentCount; i++) {
+            indexSegment_t segment;
+            segment.contribution = count * textInvNorm * index.impactWeights[*data++];
+            segment.count = readVarint(data);
+            uint32_t length = readVarint(data);
+            segment.languages = data;
+            segments.push_back(segment);
+
+            data += length;
+        }
+    });
+
+    sort(segments.begin(), segments.end(), [](const indexSegment_t& a, const indexSegment_t& b) {
+        return a.contribution > b.contribution;
+    });
+
+    size_t processed = 0;
+    for (auto& segment : segments) {
+        if (maxPostings && processed >= maxPostings)
+            break;
+
+        const uint8_t* data = segment.languages;
+        unsigned int language = 0;
+        for (uint32_t i = 0; i < segment.count; i++) {
+            language += readVarint(data);
+            if (scores[language] == 0.0f)
+                touched.push_back(language);
+            scores[language] += segment.contribution;
+        }
+        processed += segment.count;
+    }
+
+    // Top-K with a min-heap of the best scores so far
+    auto isBetter = [](const languageScore_t& a, const languageScore_t& b) {
+        return a.score > b.score;
+    };
+
+    ranking.clear();
+    for (unsigned int language : touched) {
+        languageScore_t score = {language, scores[language]};
+        scores[language] = 0.0f;
+
+        if (ranking.size() < topK) {
+            ranking.push_back(score);
+            push_heap(ranking.begin(), ranking.end(), isBetter);
+        } else if (topK && score.score > ranking.front().score) {
+            pop_heap(ranking.begin(), ranking.end(), isBetter);
+            ranking.back() = score;
+            push_heap(ranking.begin(), ranking.end(), isBetter);
+        }
+    }
+    touched.clear();
+
+    sort_heap(ranking.begin(), ranking.end(), isBetter);
+}
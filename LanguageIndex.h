@@ -0,0 +1,41 @@
+/**
+ * @brief Lequel? compressed inverted index for large language sets
+ *
+ * Scoring every profile is linear in the number of languages and keeps one hash table per
+ * language. For thousands of languages (dialects, domain or customer variants) the profiles
+ * are instead stored as one inverted index, split into shards by trigram hash:
+ *
+ *   trigram -> segments, by decreasing impact
+ *   segment  = impact (8-bit quantized weight), posting count, byte length,
+ *              then the language ids of the segment, delta coded as varints
+ *
+ * A text is scored "score at a time": the segments of all its trigrams are visited by
+ * decreasing contribution (text weight x impact) into one accumulator per language, and
+ * scoring can stop after a posting budget, so most of the score is computed from a bounded
+ * amount of postings whatever the number of languages. The index can be pruned of its
+ * lowest impacts to fit a memory budget.
+ *
+ * @cite https://dl.acm.org/doi/10.1145/2766462.2767728
+ * Anytime ranking for impact-ordered indexes (Lin, Trotman)
+ */
+
+#ifndef LANGUAGEINDEX_H
+#define LANGUAGEINDEX_H
+
+#include <vector>
+
+#include "Lequel.h"
+
+void buildLanguageIndex(const LanguageCandidates& languages,
+                        size_t budgetBytes,
+                        languageIndex_t& index);
+
+size_t getLanguageIndexBytes(const languageIndex_t& index);
+
+void rankLanguages(const languageIndex_t& index,
+                   const textProfile_t& profile,
+                   size_t maxPostings,
+                   size_t topK,
+                   std::vector<languageScore_t>& ranking);
+
+#endif
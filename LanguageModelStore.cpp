@@ -0,0 +1,66 @@
+/**
+ * @brief Lequel? hot-reloadable language model
+ *
+ * @cite https://en.cppreference.com/w/cpp/memory/shared_ptr/atomic
+ * @cite https://www.kernel.org/doc/html/latest/RCU/whatisRCU.html
+ */
+
+#include "LanguageModelStore.h"
+
+using namespace std;
+
+/**
+ * @name initLanguageModelStore
+ * @brief Sets where the model is loaded from and loads it for the first time.
+ *
+ * @param store The model store
+ * @param languageCodeNamesPath CSV file with the language code vs. language name pairs
+ * @param trigramsPath Folder containing one <language code>.lqp or .csv trigram profile per
+ * language
+ * @return true Succeeded
+ * @return false The model could not be loaded
+ */
+bool initLanguageModelStore(languageModelStore_t& store,
+                            const std::string& languageCodeNamesPath,
+                            const std::string& trigramsPath) {
+    store.languageCodeNamesPath = languageCodeNamesPath;
+    store.trigramsPath = trigramsPath;
+
+    return reloadLanguageModel(store);
+}
+
+/**
+ * @name acquireLanguageModel
+ * @brief Returns the current model. The caller keeps it alive for as long as it holds the
+ * pointer, even if a newer model is published.
+ *
+ * @param store The model store
+ * @return The current model
+ */
+std::shared_ptr<LanguageModel> acquireLanguageModel(languageModelStore_t& store) {
+    return atomic_load(&store.current);
+}
+
+/**
+ * @name reloadLanguageModel
+ * @brief Loads and indexes the model from disk again and publishes it.
+ * Readers keep using the previous model while this runs; if loading fails the previous model
+ * stays current.
+ *
+ * @param store The model store
+ * @return true The new model is current
+ * @return false The model could not be loaded
+ */
+bool reloadLanguageModel(languageModelStore_t& store) {
+    lock_guard<mutex> guard(store.reloadLock);
+
+    shared_ptr<LanguageModel> model = make_shared<LanguageModel>();
+    if (!loadLanguagesData(store.languageCodeNamesPath, store.trigramsPath, *model))
+        return false;
+
+    model->generation = store.generation + 1;
+    atomic_store(&store.current, model);
+    store.generation++;
+
+    return true;
+}
@@ -0,0 +1,38 @@
+/**
+ * @brief Lequel? hot-reloadable language model
+ *
+ * The current model is held by a shared pointer that is replaced as a whole (RCU style):
+ * readers take a reference to the model once per request or batch and keep using it even if
+ * a reload publishes a new one meanwhile; the old model is freed when its last reader is done.
+ * Reloads load and index the new model off to the side, so identifications never wait for
+ * them.
+ */
+
+#ifndef LANGUAGEMODELSTORE_H
+#define LANGUAGEMODELSTORE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Lequel.h"
+
+// languageModelStore_t: where the model is loaded from and its current version
+struct languageModelStore_t {
+    std::string languageCodeNamesPath;
+    std::string trigramsPath;
+    std::shared_ptr<LanguageModel> current;  // Only accessed through std::atomic_load/store
+    std::mutex reloadLock;                   // Serializes reloads, never taken by readers
+    std::atomic<unsigned int> generation{0};  // Incremented by every successful load
+};
+
+bool initLanguageModelStore(languageModelStore_t& store,
+                            const std::string& languageCodeNamesPath,
+                            const std::string& trigramsPath);
+
+std::shared_ptr<LanguageModel> acquireLanguageModel(languageModelStore_t& store);
+
+bool reloadLanguageModel(languageModelStore_t& store);
+
+#endif
@@ -1,490 +1,1844 @@
-/**
- * @brief Lequel? language identification based on trigrams
- * @author Marc S. Ressl
- *
- * @copyright Copyright (c) 2022-2023
- *
- * @cite
- * https://towardsdatascience.com/understanding-cosine-similarity-and-its-application-fd42f585296a
- *
- * @cite
- * https://www.geeksforgeeks.org/python/jaccard-similarity/
- * https://rpubs.com/lgadar/weighted-jaccard
- * info about Jaccard similarity
- *
- * @cite
- * https://dsacl3-2019.github.io/materials/CavnarTrenkle.pdf
- * https://www.let.rug.nl/vannoord/TextCat/textcat.pdf
- * info about Cavnar Trenkle similarity
- */
-
-#include "Lequel.h"
-
-#include <cmath>
-#include <codecvt>
-#include <iostream>
-#include <locale>
-
-using namespace std;
-
-/**
- * @name addToTrigramProfile
- * @brief Adds data to a previously created trigram profile from a given text.
- *
- * @param text String of UTF-8 Characters
- */
-static void addToTrigramProfile(const std::string& text,
-                                TrigramProfile& profile,
-                                settings_t& globalSettings) {
-    if (text.length() < 3)
-        return;
-
-    // One-time string creation
-    // It's reused for every function call
-    static std::string trigram;
-    trigram.clear();
-    trigram.reserve(12);
-
-    // Native UTF-8 iteration
-    unsigned short int char_count = 0;
-    unsigned short int trigram_start = 0;
-    unsigned short int trigram_next = 0;
-    unsigned short int text_position = 0;
-
-    unsigned char character;
-
-    while (text_position < text.length()) {
-        // Saves first position of the trigram
-        if (char_count == 0) {
-            trigram_start = text_position;
-        }
-        // Saves first position of the next trigram
-        else if (char_count == 1) {
-            trigram_next = text_position;
-        }
-
-        // Identifies UTF-8 character length
-        // KNOWN ISSUE: It never expects a middle byte
-        // SOLUTION: Never send a middle byte :)
-        character = text[text_position];
-        if (!(character & 0b10000000)) {
-            text_position += 1;  // 1 Byte
-        } else if ((character & 0b11100000) == 0b11000000) {
-            text_position += 2;  // 2 Bytes
-        } else if ((character & 0b11110000) == 0b11100000) {
-            text_position += 3;  // 3 Bytes
-        } else {
-            text_position += 4;  // 4 Bytes
-        }
-
-        char_count++;
-
-        // Extracts trigram
-        if (char_count == 3) {
-            trigram.assign(text, trigram_start, text_position - trigram_start);
-
-#ifdef NORMAL_TOGGLE_ENABLE
-            profile[trigram].real++;
-#else
-            if (profile.find(trigram) == profile.end() &&
-                globalSettings.trigramCurrentCount < globalSettings.trigramLimit)
-                profile[trigram]++;
-
-            globalSettings.trigramCurrentCount++;
-#endif
-
-            // Resets starting from the second position
-            text_position = trigram_next;
-            char_count = 0;
-        }
-    }
-}
-
-/**
- * @brief Normalizes a trigram profile.
- *
- * @param trigramProfile The trigram profile.
- */
-void normalizeTrigramProfile(TrigramProfile& trigramProfile) {
-    // Sums the squares of the trigram frequencies
-    float sumSquares = 0.0f;
-
-    auto trigramIterator = trigramProfile.begin();
-
-    while (trigramIterator != trigramProfile.end()) {
-#ifdef NORMAL_TOGGLE_ENABLE
-        trigramIterator->second.normalized = trigramIterator->second.real;
-        sumSquares += trigramIterator->second.normalized * trigramIterator->second.normalized;
-#else
-        trigramIterator->second = trigramIterator->second;
-        sumSquares += trigramIterator->second * trigramIterator->second;
-#endif
-        trigramIterator++;
-    }
-
-    // Calculates the L2 norm
-    float norm = sqrtf(sumSquares);
-    if (norm == 0.0f)
-        return;
-
-    const float invNorm = 1.0f / norm;
-
-    // Normalizes each trigram frequency by dividing by the norm
-    trigramIterator = trigramProfile.begin();
-    while (trigramIterator != trigramProfile.end()) {
-#ifdef NORMAL_TOGGLE_ENABLE
-        trigramIterator->second.normalized *= invNorm;
-#else
-        trigramIterator->second *= invNorm;
-#endif
-        trigramIterator++;
-    }
-}
-
-/**
- * @name getCosineSimilarity
- * @brief Calculates the cosine similarity between two trigram profiles
- *
- * @param textProfile The text trigram profile
- * @param languageProfile The language trigram profile
- * @param globalSettings The struct containing all the settings data
- * @return The cosine similarity score
- */
-float getCosineSimilarity(TrigramProfile& textProfile,
-                          TrigramProfile& languageProfile,
-                          settings_t& globalSettings) {
-    const size_t text_size = textProfile.size();
-    const size_t lang_size = languageProfile.size();
-
-    // Early exit for empty profiles
-    if (text_size == 0 || lang_size == 0) {
-        return 0.0f;
-    }
-
-    float dotProduct = 0.0f;
-
-    // Computes dot product by iterating over the smaller profile
-    auto textIterator = textProfile.begin();
-    auto languageIterator = languageProfile.begin();
-    if (text_size <= lang_size) {
-        while (textIterator != textProfile.end()) {
-            languageIterator = languageProfile.find(textIterator->first);
-            if (languageIterator != languageProfile.end())
-#ifdef NORMAL_TOGGLE_ENABLE
-                dotProduct += textIterator->second.normalized * textIterator->second.normalized;
-#else
-                dotProduct += textIterator->second * textIterator->second;
-#endif
-            textIterator++;
-        }
-    } else {
-        while (languageIterator != languageProfile.end()) {
-            textIterator = textProfile.find(languageIterator->first);
-            if (textIterator != textProfile.end())
-#ifdef NORMAL_TOGGLE_ENABLE
-                dotProduct +=
-                    languageIterator->second.normalized * languageIterator->second.normalized;
-#else
-                languageIterator->second * languageIterator->second;
-#endif
-            languageIterator++;
-        }
-    }
-
-    return dotProduct;
-}
-
-/**
- * @name getJaccardSimilarity
- * @brief Calculates the Jaccard similarity between two trigram profiles.
- * More info about Jaccard similarity:
- * https://www.geeksforgeeks.org/python/jaccard-similarity/
- * https://rpubs.com/lgadar/weighted-jaccard
- *
- * @param textProfile The text trigram profile
- * @param languageProfile The language trigram profile
- * @param globalSettings The struct containing all the settings data
- * @return The Jaccard similarity score
- */
-static float getJaccardSimilarity(TrigramProfile& profile,
-                                  TrigramProfile& language,
-                                  settings_t& globalSettings) {
-    float in_common = 0;
-    float total = 0;
-
-    auto profile_iterator = profile.begin();
-    auto language_iterator = language.begin();
-
-    // Calculates the amount of elements in common, then the elements in total
-#ifdef NORMAL_TOGGLE_ENABLE
-    if (globalSettings.valueProcessingSetting == VALUE_NORMALIZE) {
-        while (profile_iterator != profile.end()) {
-            language_iterator = language.find(profile_iterator->first);
-            if (language_iterator != language.end()) {
-                in_common += std::min(profile_iterator->second.normalized,
-                                      language_iterator->second.normalized);
-            }
-            total += profile_iterator->second.normalized;
-            profile_iterator++;
-        }
-
-        for (language_iterator = language.begin(); language_iterator != language.end();
-             language_iterator++) {
-            total += language_iterator->second.normalized;
-        }
-    } else {
-        while (profile_iterator != profile.end()) {
-            language_iterator = language.find(profile_iterator->first);
-            if (language_iterator != language.end()) {
-                in_common +=
-                    std::min(profile_iterator->second.real, language_iterator->second.real);
-            }
-            total += profile_iterator->second.real;
-            profile_iterator++;
-        }
-
-        for (language_iterator = language.begin(); language_iterator != language.end();
-             language_iterator++) {
-            total += language_iterator->second.real;
-        }
-    }
-#else
-    while (profile_iterator != profile.end()) {
-        language_iterator = language.find(profile_iterator->first);
-        if (language_iterator != language.end()) {
-            in_common += std::min(profile_iterator->second, language_iterator->second);
-        }
-        total += profile_iterator->second;
-        profile_iterator++;
-    }
-
-    for (language_iterator = language.begin(); language_iterator != language.end();
-         language_iterator++) {
-        total += language_iterator->second;
-    }
-#endif
-
-    // Intersection divided by the union
-    return in_common / (total - in_common);
-}
-
-/**
- * @name getCavnarTrenkleSimilarity
- * @brief Calculates the Cavnar Trenkle similarity between two trigram profiles.
- * More info about Cavnar Trenkle similarity:
- * https://dsacl3-2019.github.io/materials/CavnarTrenkle.pdf
- * https://www.let.rug.nl/vannoord/TextCat/textcat.pdf
- *
- * @param textProfile The text trigram profile
- * @param languageProfile The language trigram profile
- * @param globalSettings The struct containing all the settings data
- * @return The Cavnar Trenkle similarity score
- */
-static float getCavnarTrenkleSimilarity(TrigramProfile& profile,
-                                        TrigramProfile& language,
-                                        settings_t& globalSettings) {
-    float totalDistance = 0.0f;
-
-    auto profileIterator = profile.begin();
-    auto languageIterator = language.begin();
-
-    // Calculates |profileNormalValue - languageNormalValue|
-#ifdef NORMAL_TOGGLE_ENABLE
-    if (globalSettings.valueProcessingSetting == VALUE_NORMALIZE) {
-        while (profileIterator != profile.end()) {
-            languageIterator = language.find(profileIterator->first);
-            if (languageIterator != language.end()) {
-                totalDistance += std::abs(profileIterator->second.normalized -
-                                          languageIterator->second.normalized);
-            } else
-                totalDistance += 1.0f;
-            profileIterator++;
-        }
-    } else {
-        while (profileIterator != profile.end()) {
-            languageIterator = language.find(profileIterator->first);
-            if (languageIterator != language.end()) {
-                totalDistance +=
-                    std::abs(profileIterator->second.real - languageIterator->second.real);
-            } else
-                totalDistance += 1.0f;
-            profileIterator++;
-        }
-    }
-#else
-    while (profileIterator != profile.end()) {
-        languageIterator = language.find(profileIterator->first);
-        if (languageIterator != language.end()) {
-            totalDistance += std::abs(profileIterator->second - languageIterator->second);
-        } else
-            totalDistance += 1.0f;
-        profileIterator++;
-    }
-#endif
-
-    // Convert distance to similarity
-    return 1.0f / (1.0f + totalDistance);
-}
-
-/**
- * @name compareLanguages
- * @brief Identifies the language of a text.
- *
- * @param profile The profile created from the extracted text
- * @param languages A list of Language objects
- * @param globalSettings The struct containing all the settings data
- * @return The language code of the most likely language
- */
-static std::string compareLanguages(TrigramProfile& profile,
-                                    LanguageProfiles& languages,
-                                    settings_t& globalSettings) {
-    float max_value = 0;
-    float temp_value = 0;
-    std::string* max_value_name;
-
-    auto languageIterator = languages.begin();
-
-    switch (globalSettings.algorithmSetting) {
-        case ALGORITHM_JACCARD:
-            while (languageIterator != languages.end()) {
-                temp_value =
-                    getJaccardSimilarity(profile, languageIterator->trigramProfile, globalSettings);
-                if (temp_value > max_value) {
-                    max_value = temp_value;
-                    max_value_name = &languageIterator->languageCode;
-                }
-                languageIterator++;
-            }
-            break;
-        case ALGORITHM_CAVNARTRENKLE:
-            while (languageIterator != languages.end()) {
-                temp_value = getCavnarTrenkleSimilarity(
-                    profile, languageIterator->trigramProfile, globalSettings);
-                if (temp_value > max_value) {
-                    max_value = temp_value;
-                    max_value_name = &languageIterator->languageCode;
-                }
-                languageIterator++;
-            }
-            break;
-        case ALGORITHM_COSINE:
-            while (languageIterator != languages.end()) {
-                temp_value =
-                    getCosineSimilarity(profile, languageIterator->trigramProfile, globalSettings);
-                if (temp_value > max_value) {
-                    max_value = temp_value;
-                    max_value_name = &languageIterator->languageCode;
-                }
-                languageIterator++;
-            }
-            break;
-        default:
-            return "";
-    }
-
-    return *max_value_name;
-}
-
-/**
- * @name identifyLanguageFromPath
- * @brief Identifies the language of a text given the file path;
- *
- * @param path string of characters for the file path
- * @param languages A list of Language objects
- * @param globalSettings The struct containing all the settings data
- * @return The language code of the most likely language
- */
-std::string identifyLanguageFromPath(char* path,
-                                     LanguageProfiles& languages,
-                                     settings_t& globalSettings) {
-    std::ifstream file(path);
-    std::string extractedText;
-    TrigramProfile profile;
-
-#ifndef NORMAL_TOGGLE_ENABLE
-    globalSettings.trigramCurrentCount = 0;
-#endif
-
-    if (!file.is_open()) {
-        perror(("Error while opening file " + std::string(path)).c_str());
-        return "";
-    }
-
-    for (int counter = 0; (counter < globalSettings.lineLimit) && (std::getline(file, extractedText));
-         counter++) {
-        addToTrigramProfile(extractedText, profile, globalSettings);
-    }
-
-    if (globalSettings.valueProcessingSetting == VALUE_NORMALIZE) {
-        normalizeTrigramProfile(profile);
-    }
-
-    return compareLanguages(profile, languages, globalSettings);
-}
-
-/**
- * @name identifyLanguageFromClipboard
- * @brief Identifies the language of a text given the clipboard contents
- *
- * @param path string of characters from the clipboard
- * @param languages A list of Language objects
- * @param globalSettings The struct containing all the settings data
- * @return The language code of the most likely language
- */
-std::string identifyLanguageFromClipboard(std::string& clipboard,
-                                          LanguageProfiles& languages,
-                                          settings_t& globalSettings) {
-    static std::string extractedText;
-    static TrigramProfile profile;
-
-#ifndef NORMAL_TOGGLE_ENABLE
-    globalSettings.trigramCurrentCount = 0;
-#endif
-
-    // Should avoid constant reallocations
-    profile.reserve(50000);
-    extractedText.reserve(500);
-    profile.clear();
-    extractedText.clear();
-
-    // Special case: empty clipboard
-    if (clipboard.empty()) {
-        perror(("Error while opening Clipboard"));
-        return "";
-    }
-
-    // Line by line iteration
-    unsigned int line_count = 0;
-    size_t start = 0;
-    size_t line_end = 0;
-    size_t end = 0;
-
-    while (line_count < globalSettings.lineLimit && start < clipboard.length()) {
-        // Find next line
-        if ((end = clipboard.find('\n', start)) == std::string::npos) {
-            end = clipboard.length();  // Special case: One long line
-        }
-
-        if (end > 0 && clipboard[end - 1] == '\r') {
-            line_end = end - 1;  // Windows style end symbol '\r'
-        } else {
-            line_end = end;
-        }
-
-        std::string line = clipboard.substr(start, line_end - start);
-        addToTrigramProfile(line, profile, globalSettings);
-
-        line_count++;
-        start = end + 1;  // Move past the newline
-    }
-
-#ifdef NORMAL_TOGGLE_ENABLE
-    if (globalSettings.valueProcessingSetting == VALUE_NORMALIZE) {
-        normalizeTrigramProfile(profile);
-    }
-#else
-    normalizeTrigramProfile(profile);
-#endif
-
-    return compareLanguages(profile, languages, globalSettings);
-}
+/**
+ * @brief Lequel? language identification based on trigrams
+ * @author Marc S. Ressl
+ *
+ * @copyright Copyright (c) 2022-2023
+ *
+ * @cite
+ * https://towardsdatascience.com/understanding-cosine-similarity-and-its-application-fd42f585296a
+ *
+ * @cite
+ * https://www.geeksforgeeks.org/python/jaccard-similarity/
+ * https://rpubs.com/lgadar/weighted-jaccard
+ * info about Jaccard similarity
+ *
+ * @cite
+ * https://dsacl3-2019.github.io/materials/CavnarTrenkle.pdf
+ * https://www.let.rug.nl/vannoord/TextCat/textcat.pdf
+ * info about Cavnar Trenkle similarity
+ */
+
+#include "Lequel.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <codecvt>
+#include <iostream>
+#include <locale>
+#include <random>
+#include <thread>
+
+#include "CodeFeatures.h"
+#include "InputStream.h"
+#include "LanguageClusters.h"
+#include "LanguageIndex.h"
+#include "ProfileFile.h"
+#include "TextEncoding.h"
+#include "TextNormalization.h"
+
+using namespace std;
+
+/**
+ * @name addTrigramToTextProfile
+ * @brief Counts a trigram of a text being identified and updates both norms of the profile.
+ *
+ * @param trigram The trigram
+ * @param profile The text profile
+ * @param filter Filter of the trigrams present in some language (used without a vocabulary)
+ */
+static inline void addTrigramToTextProfile(const std::string& trigram,
+                                           textProfile_t& profile,
+                                           const bloomFilter_t& filter) {
+    if (profile.vocabulary) {
+        uint32_t slot = lookupPerfectHash(*profile.vocabulary, trigram);
+        if (slot != PERFECT_HASH_MISSING) {
+            float& count = profile.slotCounts[slot];
+            if (count == 0.0f)
+                profile.touchedSlots.push_back(slot);
+            profile.sumSquares += 2.0f * count + 1.0f;
+            count++;
+        } else {
+            profile.unknownCount++;
+            profile.sumSquares++;
+        }
+    } else if (mayContain(filter, trigram)) {
+        float& count = profile.trigrams[trigram].real;
+        profile.sumSquares += 2.0f * count + 1.0f;  // (count + 1)^2 - count^2
+        count++;
+    } else {
+        profile.unknownCount++;
+        profile.sumSquares++;
+    }
+    profile.sum++;
+}
+
+/**
+ * @name addToTextProfile
+ * @brief Adds data to the profile of a text being identified.
+ * The text is normalized while it is split (see TextNormalization.h). Trigrams rejected by
+ * the filter are only counted. Stops once globalSettings.trigramLimit trigrams were added.
+ *
+ * @param text String of UTF-8 Characters
+ * @param profile The text profile
+ * @param filter Filter of the trigrams present in some language
+ * @param globalSettings The struct containing all the settings data
+ */
+static void addToTextProfile(const std::string& text,
+                             textProfile_t& profile,
+                             const bloomFilter_t& filter,
+                             settings_t& globalSettings) {
+    if (text.length() < 3 || globalSettings.trigramCurrentCount >= globalSettings.trigramLimit)
+        return;
+
+    forEachTrigram(text, 0, text.length(), [&](const std::string& trigram, size_t) {
+        addTrigramToTextProfile(trigram, profile, filter);
+        return ++globalSettings.trigramCurrentCount < globalSettings.trigramLimit;
+    });
+}
+
+/**
+ * @name addToTrigramProfile
+ * @brief Adds data to a previously created trigram profile from a given text, without a
+ * trigram limit.
+ * The text is normalized while it is split (see TextNormalization.h).
+ *
+ * @param text String of UTF-8 Characters
+ * @param profile The trigram profile
+ */
+void addToTrigramProfile(const std::string& text, TrigramProfile& profile) {
+    if (text.length() < 3)
+        return;
+
+    forEachTrigram(text, 0, text.length(), [&](const std::string& trigram, size_t) {
+        profile[trigram].real++;
+        return true;
+    });
+}
+
+/**
+ * @brief Normalizes a trigram profile.
+ * Fills every normalized value from its real value; real values are kept.
+ *
+ * @param trigramProfile The trigram profile.
+ */
+void normalizeTrigramProfile(TrigramProfile& trigramProfile) {
+    // Sums the squares of the trigram frequencies
+    float sumSquares = 0.0f;
+
+    auto trigramIterator = trigramProfile.begin();
+
+    while (trigramIterator != trigramProfile.end()) {
+        sumSquares += trigramIterator->second.real * trigramIterator->second.real;
+        trigramIterator++;
+    }
+
+    // Calculates the L2 norm
+    float norm = sqrtf(sumSquares);
+    if (norm == 0.0f)
+        return;
+
+    const float invNorm = 1.0f / norm;
+
+    // Normalizes each trigram frequency by dividing by the norm
+    trigramIterator = trigramProfile.begin();
+    while (trigramIterator != trigramProfile.end()) {
+        trigramIterator->second.normalized = trigramIterator->second.real * invNorm;
+        trigramIterator++;
+    }
+}
+
+/**
+ * @name aggregateTrigramProfile
+ * @brief Computes the constants of a (normalized) language profile that the similarity
+ * metrics need.
+ *
+ * @param trigramProfile The trigram profile
+ * @param aggregates The destination aggregates
+ */
+void aggregateTrigramProfile(const TrigramProfile& trigramProfile,
+                             profileAggregates_t& aggregates) {
+    aggregates = profileAggregates_t();
+
+    for (auto& entry : trigramProfile) {
+        aggregates.realTotal += entry.second.real;
+        aggregates.realSquares += entry.second.real * entry.second.real;
+        aggregates.normalizedTotal += entry.second.normalized;
+    }
+}
+
+/**
+ * @name clearTextProfile
+ * @brief Empties a text profile for the next text, keeping its vocabulary. Only the touched
+ * slots are reset, so clearing costs nothing once the slot array is allocated. The vocabulary
+ * is not read: it may belong to a model freed since the profile was filled.
+ *
+ * @param profile The text profile
+ */
+void clearTextProfile(textProfile_t& profile) {
+    for (uint32_t slot : profile.touchedSlots)
+        profile.slotCounts[slot] = 0.0f;
+    profile.touchedSlots.clear();
+
+    profile.trigrams.clear();
+    profile.unknownCount = 0.0f;
+    profile.sum = 0.0f;
+    profile.sumSquares = 0.0f;
+}
+
+/**
+ * @name getModelVocabulary
+ * @brief Returns the vocabulary text profiles count the trigrams of a model in.
+ *
+ * @param model The language model
+ * @return The vocabulary, nullptr if the model has none (trigrams are then kept in a table)
+ */
+static const perfectHash_t* getModelVocabulary(const LanguageModel& model) {
+    return model.trigramHash.keys.empty() ? nullptr : &model.trigramHash;
+}
+
+/**
+ * @name setTextProfileVocabulary
+ * @brief Empties a text profile and sizes its slot array for a vocabulary. Profiles reused
+ * across texts (thread_local) must be given the vocabulary of the current model this way
+ * before anything else, as the previous one may have been freed by a reload.
+ *
+ * @param profile The text profile
+ * @param vocabulary The vocabulary (nullptr: trigrams are kept in a table)
+ */
+void setTextProfileVocabulary(textProfile_t& profile, const perfectHash_t* vocabulary) {
+    clearTextProfile(profile);
+
+    profile.vocabulary = vocabulary;
+    if (vocabulary)
+        profile.slotCounts.resize(vocabulary->keys.size(), 0.0f);
+}
+
+/**
+ * @name useModelVocabulary
+ * @brief Prepares a text profile to count the trigrams of a model in slots.
+ *
+ * @param profile The text profile, cleared
+ * @param model The language model
+ */
+static void useModelVocabulary(textProfile_t& profile, const LanguageModel& model) {
+    setTextProfileVocabulary(profile, getModelVocabulary(model));
+}
+
+/**
+ * @name updateTextProfileNorms
+ * @brief Recomputes both norms of a text profile whose counts were not all added through
+ * addTrigramToTextProfile (code features, merged parallel chunks).
+ *
+ * @param profile The text profile
+ */
+static void updateTextProfileNorms(textProfile_t& profile) {
+    profile.sum = profile.unknownCount;
+    profile.sumSquares = profile.unknownCount;  // Each one was seen once
+    forEachTextTrigram(profile, [&](const std::string&, float count) {
+        profile.sum += count;
+        profile.sumSquares += count * count;
+    });
+}
+
+// Value policies: which field of value_t the similarity loops read on the language side, and
+// the factor applied to the text counts (normalized text values are count * 1 / L2 norm)
+struct RealValues {
+    static const bool isNormalized = false;
+    static inline float get(const value_t& value) { return value.real; }
+    static inline float getTotal(const profileAggregates_t& language) {
+        return language.realTotal;
+    }
+    static inline float getTextScale(const textProfile_t&) { return 1.0f; }
+};
+
+struct NormalizedValues {
+    static const bool isNormalized = true;
+    static inline float get(const value_t& value) { return value.normalized; }
+    static inline float getTotal(const profileAggregates_t& language) {
+        return language.normalizedTotal;
+    }
+    static inline float getTextScale(const textProfile_t& text) { return getTextInvNorm(text); }
+};
+
+/**
+ * @name CosineMetric
+ * @brief Cosine similarity accumulator: the dot product of the text counts with the language
+ * values, divided at the end by both norms. Normalized language profiles have unit norm and
+ * the text norm was accumulated during extraction, so no pass computes a norm.
+ */
+template <typename Values>
+struct CosineMetric {
+    float dotProduct = 0.0f;
+    float textSquares;
+
+    explicit CosineMetric(const textProfile_t& text) : textSquares(text.sumSquares) {}
+
+    inline void match(float count, const value_t& language) {
+        dotProduct += count * Values::get(language);
+    }
+
+    inline void miss(float) {}
+
+    inline float result(const profileAggregates_t& language) const {
+        float languageNorm = Values::isNormalized ? 1.0f : sqrtf(language.realSquares);
+        float norms = sqrtf(textSquares) * languageNorm;
+        return norms == 0.0f ? 0.0f : dotProduct / norms;
+    }
+};
+
+/**
+ * @name JaccardMetric
+ * @brief Weighted Jaccard similarity accumulator. Only the intersection depends on both
+ * profiles; the text and language totals are known beforehand.
+ * More info about Jaccard similarity:
+ * https://www.geeksforgeeks.org/python/jaccard-similarity/
+ * https://rpubs.com/lgadar/weighted-jaccard
+ */
+template <typename Values>
+struct JaccardMetric {
+    float inCommon = 0.0f;
+    float textScale;
+    float textTotal;
+
+    explicit JaccardMetric(const textProfile_t& text)
+        : textScale(Values::getTextScale(text)), textTotal(text.sum * textScale) {}
+
+    inline void match(float count, const value_t& language) {
+        inCommon += std::min(count * textScale, Values::get(language));
+    }
+
+    inline void miss(float) {}
+
+    inline float result(const profileAggregates_t& language) const {
+        // Intersection divided by the union
+        return inCommon / (textTotal + Values::getTotal(language) - inCommon);
+    }
+};
+
+/**
+ * @name CavnarTrenkleMetric
+ * @brief Cavnar Trenkle similarity accumulator: |profile value - language value| per trigram,
+ * 1 for trigrams missing from the language.
+ * More info about Cavnar Trenkle similarity:
+ * https://dsacl3-2019.github.io/materials/CavnarTrenkle.pdf
+ * https://www.let.rug.nl/vannoord/TextCat/textcat.pdf
+ */
+template <typename Values>
+struct CavnarTrenkleMetric {
+    float totalDistance;
+    float textScale;
+
+    explicit CavnarTrenkleMetric(const textProfile_t& text)
+        : totalDistance(text.unknownCount), textScale(Values::getTextScale(text)) {}
+
+    inline void match(float count, const value_t& language) {
+        totalDistance += std::abs(count * textScale - Values::get(language));
+    }
+
+    inline void miss(float) { totalDistance += 1.0f; }
+
+    inline float result(const profileAggregates_t&) const {
+        // Convert distance to similarity
+        return 1.0f / (1.0f + totalDistance);
+    }
+};
+
+/**
+ * @name getSimilarity
+ * @brief Calculates the similarity between a text profile and a language profile in a single
+ * pass over the text trigrams.
+ * One instance is compiled per metric and value policy, so the loop has no setting checks.
+ *
+ * @param textProfile The text profile
+ * @param languageProfile The language trigram profile
+ * @param languageAggregates The constants of the language profile
+ * @return The similarity score
+ */
+template <typename Metric>
+static float getSimilarity(const textProfile_t& textProfile,
+                           const TrigramProfile& languageProfile,
+                           const profileAggregates_t& languageAggregates) {
+    Metric metric(textProfile);
+
+    forEachTextTrigram(textProfile, [&](const std::string& trigram, float count) {
+        auto languageIterator = languageProfile.find(trigram);
+        if (languageIterator != languageProfile.end())
+            metric.match(count, languageIterator->second);
+        else
+            metric.miss(count);
+    });
+
+    return metric.result(languageAggregates);
+}
+
+// similarityFunction_t: a fully specialized similarity loop
+typedef float (*similarityFunction_t)(const textProfile_t&,
+                                      const TrigramProfile&,
+                                      const profileAggregates_t&);
+
+// Indexed by algorithmSetting_t, then valueProcessingSetting_t. Naive Bayes has no per-language
+// loop: it is scored through the inverted index (see getNaiveBayesLeader)
+static const similarityFunction_t
+    SIMILARITY_FUNCTIONS[ALGORITHM_NAIVE_BAYES][VALUE_PROCESSING_COUNT] = {
+    {getSimilarity<CosineMetric<NormalizedValues>>, getSimilarity<CosineMetric<RealValues>>},
+    {getSimilarity<JaccardMetric<NormalizedValues>>, getSimilarity<JaccardMetric<RealValues>>},
+    {getSimilarity<CavnarTrenkleMetric<NormalizedValues>>,
+     getSimilarity<CavnarTrenkleMetric<RealValues>>},
+};
+
+/**
+ * @name getSimilarityFunction
+ * @brief Selects the similarity loop for the current settings, once per request.
+ *
+ * @param globalSettings The struct containing all the settings data
+ * @return The similarity function (nullptr for Naive Bayes)
+ */
+static similarityFunction_t getSimilarityFunction(const settings_t& globalSettings) {
+    if (globalSettings.algorithmSetting == ALGORITHM_NAIVE_BAYES)
+        return nullptr;
+
+    return SIMILARITY_FUNCTIONS[globalSettings.algorithmSetting]
+                               [globalSettings.valueProcessingSetting];
+}
+
+/**
+ * @name getSimilarityScore
+ * @brief Calculates the similarity between a text profile and a language with the current
+ * settings.
+ *
+ * @param profile The text profile
+ * @param language The language profile (indexed, see indexLanguageModel)
+ * @param globalSettings The struct containing all the settings data
+ * @return The similarity score (0 for Naive Bayes, which is only scored through the index)
+ */
+float getSimilarityScore(const textProfile_t& profile,
+                         const LanguageProfile& language,
+                         const settings_t& globalSettings) {
+    similarityFunction_t getLanguageSimilarity = getSimilarityFunction(globalSettings);
+    if (!getLanguageSimilarity)
+        return 0.0f;
+
+    return getLanguageSimilarity(profile, language.trigramProfile, language.aggregates);
+}
+
+/**
+ * @name reportBytes
+ * @brief Publishes the amount of input consumed and checks for cancellation.
+ *
+ * @param progress Optional progress report
+ * @param bytes Bytes consumed since the last report
+ * @return false if the identification was cancelled
+ */
+static bool reportBytes(identificationProgress_t* progress, size_t bytes) {
+    if (!progress)
+        return true;
+
+    progress->bytesProcessed.fetch_add(bytes, std::memory_order_relaxed);
+    return !progress->cancelRequested.load(std::memory_order_relaxed);
+}
+
+/**
+ * @name reportLeader
+ * @brief Publishes the best language so far and checks for cancellation.
+ *
+ * @param progress Optional progress report
+ * @param leader Language code of the best language so far (nullptr if none)
+ * @return false if the identification was cancelled
+ */
+static bool reportLeader(identificationProgress_t* progress, const std::string* leader) {
+    if (!progress)
+        return true;
+
+    progress->leader.store(leader, std::memory_order_relaxed);
+    return !progress->cancelRequested.load(std::memory_order_relaxed);
+}
+
+/**
+ * @name setIdentificationBudget
+ * @brief Sets the deadline of an identification that is about to start.
+ *
+ * @param progress The progress report the identification will be given
+ * @param microseconds Time the identification may take from now
+ */
+void setIdentificationBudget(identificationProgress_t& progress, unsigned int microseconds) {
+    progress.deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(microseconds);
+    progress.partial.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @name hasDeadline
+ * @brief Checks whether an identification must finish by a deadline.
+ *
+ * @param progress Optional progress report
+ * @return true if a deadline is set
+ */
+static inline bool hasDeadline(const identificationProgress_t* progress) {
+    return progress && progress->deadline != std::chrono::steady_clock::time_point::max();
+}
+
+/**
+ * @name checkDeadline
+ * @brief Reads the clock and marks the identification as partial once its deadline has
+ * passed.
+ *
+ * @param progress Optional progress report holding the deadline
+ * @return true if the deadline has passed
+ */
+static bool checkDeadline(identificationProgress_t* progress) {
+    if (!hasDeadline(progress))
+        return false;
+    if (progress->partial.load(std::memory_order_relaxed))
+        return true;
+    if (std::chrono::steady_clock::now() < progress->deadline)
+        return false;
+
+    progress->partial.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @name isPastDeadline
+ * @brief Counts the work done and only checks the deadline once every
+ * DEADLINE_CHECK_OPERATIONS operations, so reading the clock costs nothing noticeable.
+ *
+ * @param progress Optional progress report holding the deadline
+ * @param operations Operations since the last check (updated)
+ * @param count Operations just done
+ * @return true if the deadline has passed
+ */
+static inline bool isPastDeadline(identificationProgress_t* progress,
+                                  size_t& operations,
+                                  size_t count) {
+    operations += count;
+    if (operations < DEADLINE_CHECK_OPERATIONS)
+        return false;
+    operations = 0;
+
+    return checkDeadline(progress);
+}
+
+/**
+ * @name selectClusterMembers
+ * @brief Scores the cluster centroids of a script sub-model and lists the languages of the
+ * globalSettings.clusterBeam best clusters.
+ *
+ * @param profile The profile created from the extracted text
+ * @param model The language model
+ * @param script The script sub-model
+ * @param globalSettings The struct containing all the settings data
+ * @param members The destination languages, as indexes into scriptLanguages[SCRIPT_UNKNOWN]
+ * @param progress Optional progress report
+ * @return false if every language of the sub-model must be scored instead (clustering off,
+ * not more clusters than the beam, or Naive Bayes, which scores every language in one pass)
+ */
+static bool selectClusterMembers(const textProfile_t& profile,
+                                 const LanguageModel& model,
+                                 script_t script,
+                                 const settings_t& globalSettings,
+                                 std::vector<unsigned int>& members,
+                                 identificationProgress_t* progress) {
+    const LanguageClusters& clusters = model.scriptClusters[script];
+    if (!globalSettings.clusterBeam || clusters.size() <= globalSettings.clusterBeam ||
+        globalSettings.algorithmSetting == ALGORITHM_NAIVE_BAYES)
+        return false;
+
+    similarityFunction_t getLanguageSimilarity = getSimilarityFunction(globalSettings);
+    std::vector<std::pair<float, unsigned int>> scores(clusters.size());
+    for (unsigned int i = 0; i < clusters.size(); i++)
+        scores[i] = std::make_pair(
+            -getLanguageSimilarity(profile, clusters[i].centroid, clusters[i].centroidAggregates),
+            i);
+
+    std::partial_sort(scores.begin(), scores.begin() + globalSettings.clusterBeam, scores.end());
+
+    members.clear();
+    for (unsigned int i = 0; i < globalSettings.clusterBeam; i++) {
+        const languageCluster_t& cluster = clusters[scores[i].second];
+        members.insert(members.end(), cluster.members.begin(), cluster.members.end());
+    }
+
+    if (progress)
+        progress->profilesScored.fetch_add(clusters.size(), std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @name selectIndexCandidates
+ * @brief Ranks every language through the compressed index of the model and lists the
+ * globalSettings.indexCandidates best ones of a script sub-model, to be scored exactly.
+ *
+ * @param profile The profile created from the extracted text
+ * @param model The language model
+ * @param script The script sub-model
+ * @param globalSettings The struct containing all the settings data
+ * @param members The destination languages, as indexes into scriptLanguages[SCRIPT_UNKNOWN]
+ * @return false if every language of the sub-model must be scored instead (index off, not more
+ * languages than the candidates, no candidate of the script, or Naive Bayes)
+ */
+static bool selectIndexCandidates(const textProfile_t& profile,
+                                  const LanguageModel& model,
+                                  script_t script,
+                                  const settings_t& globalSettings,
+                                  std::vector<unsigned int>& members) {
+    thread_local std::vector<languageScore_t> ranking;
+    const LanguageCandidates& allLanguages = model.scriptLanguages[SCRIPT_UNKNOWN];
+    if (!globalSettings.indexCandidates ||
+        model.scriptLanguages[script].size() <= globalSettings.indexCandidates ||
+        globalSettings.algorithmSetting == ALGORITHM_NAIVE_BAYES)
+        return false;
+
+    rankLanguages(model.languageIndex, profile, 0, globalSettings.indexCandidates, ranking);
+
+    members.clear();
+    for (auto& entry : ranking) {
+        if (script == SCRIPT_UNKNOWN || (allLanguages[entry.language]->scriptMask & (1u << script)))
+            members.push_back(entry.language);
+    }
+
+    return !members.empty();
+}
+
+// TextPostings: (count, index entry) of the text trigrams some language contains
+typedef std::vector<std::pair<float, const std::vector<trigramPosting_t>*>> TextPostings;
+
+/**
+ * @name forEachTextPostings
+ * @brief Visits the index entry of every text trigram some language contains: straight from
+ * its slot for the trigrams counted in the model vocabulary, through the index otherwise.
+ *
+ * @param profile The text profile
+ * @param model The language model
+ * @param handler Called as handler(const std::vector<trigramPosting_t>& postings, float count)
+ */
+template <typename PostingsHandler>
+static void forEachTextPostings(const textProfile_t& profile,
+                                const LanguageModel& model,
+                                PostingsHandler handler) {
+    auto findPostings = [&](const std::string& trigram, float count) {
+        auto postings = model.trigramIndex.find(trigram);
+        if (postings != model.trigramIndex.end())
+            handler(postings->second, count);
+    };
+
+    if (profile.vocabulary != &model.trigramHash) {
+        forEachTextTrigram(profile, findPostings);
+        return;
+    }
+
+    for (uint32_t slot : profile.touchedSlots)
+        handler(*model.slotPostings[slot], profile.slotCounts[slot]);
+    for (auto& entry : profile.trigrams)
+        findPostings(entry.first, entry.second.real);
+}
+
+/**
+ * @name sortPostingsByCount
+ * @brief Lists the index entries of the text trigrams, most frequent first: the order in
+ * which a deadline-bound identification reads them, so that running out of time drops the
+ * trigrams that weigh least.
+ *
+ * @param profile The text profile
+ * @param model The language model
+ * @param postings The destination (count, index entry) pairs
+ * @param count Number of leading entries that must be sorted (the rest are in any order)
+ */
+static void sortPostingsByCount(const textProfile_t& profile,
+                                const LanguageModel& model,
+                                TextPostings& postings,
+                                size_t count) {
+    postings.clear();
+    forEachTextPostings(
+        profile, model, [&](const std::vector<trigramPosting_t>& entry, float trigramCount) {
+            postings.push_back(std::make_pair(trigramCount, &entry));
+        });
+
+    count = std::min(count, postings.size());
+    std::partial_sort(postings.begin(),
+                      postings.begin() + count,
+                      postings.end(),
+                      [](const TextPostings::value_type& a, const TextPostings::value_type& b) {
+                          return a.first > b.first;
+                      });
+}
+
+/**
+ * @name getNaiveBayesLeader
+ * @brief Scores every language of a script sub-model with Naive Bayes in one pass over the
+ * posting lists of the text trigrams.
+ * The log-likelihood of the text is sum(count_t * log P(t | language)). Every trigram missing
+ * from a language has the same probability in all of them (see NAIVE_BAYES_SMOOTHING), so
+ * subtracting that floor leaves only the trigrams the language contains, each adding
+ * count_t * logRatio, which is never negative. Trigrams no language contains are skipped.
+ * With a deadline, trigrams are read most frequent first and the scores stop growing when
+ * time runs out.
+ *
+ * @param profile The profile created from the extracted text (counts only)
+ * @param model The language model
+ * @param script The script sub-model
+ * @param progress Optional progress report holding the deadline
+ * @return The language code of the most likely language (nullptr if nothing matched)
+ */
+static const std::string* getNaiveBayesLeader(const textProfile_t& profile,
+                                              const LanguageModel& model,
+                                              script_t script,
+                                              identificationProgress_t* progress) {
+    thread_local std::vector<float> scores;
+    thread_local TextPostings textPostings;
+    const LanguageCandidates& allLanguages = model.scriptLanguages[SCRIPT_UNKNOWN];
+
+    auto addPostings = [&](const std::vector<trigramPosting_t>& postings, float count) {
+        for (auto& posting : postings)
+            scores[posting.language] += count * posting.logRatio;
+    };
+
+    scores.assign(allLanguages.size(), 0.0f);
+    if (hasDeadline(progress)) {
+        size_t operations = 0;
+        sortPostingsByCount(profile, model, textPostings, getTextTrigramCount(profile));
+        for (auto& entry : textPostings) {
+            addPostings(*entry.second, entry.first);
+            if (isPastDeadline(progress, operations, entry.second->size()))
+                break;
+        }
+    } else
+        forEachTextPostings(profile, model, addPostings);
+
+    float max_value = 0.0f;
+    const std::string* max_value_name = nullptr;
+    for (size_t i = 0; i < allLanguages.size(); i++) {
+        if (script != SCRIPT_UNKNOWN && !(allLanguages[i]->scriptMask & (1u << script)))
+            continue;
+
+        if (scores[i] > max_value) {
+            max_value = scores[i];
+            max_value_name = &allLanguages[i]->languageCode;
+        }
+    }
+
+    return max_value_name;
+}
+
+/**
+ * @name compareLanguagesAnytime
+ * @brief Identifies the language of a text by a deadline. Languages are scored most likely
+ * first, as estimated through the trigram index from the ANYTIME_ESTIMATE_TRIGRAMS most
+ * frequent text trigrams (the cosine of those trigrams alone), so the best language so far is
+ * usually the final one when time runs out. If no language could be fully scored, the best
+ * estimate is returned.
+ *
+ * @param profile The profile created from the extracted text
+ * @param model The language model
+ * @param script The script sub-model
+ * @param members The languages of the best clusters or index candidates (nullptr: every language
+ * of the script)
+ * @param globalSettings The struct containing all the settings data
+ * @param progress Progress report holding the deadline
+ * @return The language code of the most likely language ("" if cancelled)
+ */
+static std::string compareLanguagesAnytime(const textProfile_t& profile,
+                                           const LanguageModel& model,
+                                           script_t script,
+                                           const std::vector<unsigned int>* members,
+                                           const settings_t& globalSettings,
+                                           identificationProgress_t* progress) {
+    thread_local TextPostings textPostings;
+    thread_local std::vector<float> estimates;
+    thread_local std::vector<std::pair<float, unsigned int>> order;
+    const LanguageCandidates& allLanguages = model.scriptLanguages[SCRIPT_UNKNOWN];
+
+    sortPostingsByCount(profile, model, textPostings, ANYTIME_ESTIMATE_TRIGRAMS);
+    size_t estimateCount = std::min(textPostings.size(), (size_t)ANYTIME_ESTIMATE_TRIGRAMS);
+
+    estimates.assign(allLanguages.size(), 0.0f);
+    for (size_t i = 0; i < estimateCount; i++) {
+        for (auto& posting : *textPostings[i].second)
+            estimates[posting.language] += textPostings[i].first * posting.weight;
+    }
+
+    order.clear();
+    if (members) {
+        for (unsigned int member : *members)
+            order.push_back(std::make_pair(-estimates[member], member));
+    } else {
+        for (unsigned int i = 0; i < allLanguages.size(); i++) {
+            if (script == SCRIPT_UNKNOWN || (allLanguages[i]->scriptMask & (1u << script)))
+                order.push_back(std::make_pair(-estimates[i], i));
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    const std::string* max_value_name = nullptr;
+    if (!order.empty() && order.front().first < 0.0f)
+        max_value_name = &allLanguages[order.front().second]->languageCode;
+    if (!reportLeader(progress, max_value_name))
+        return "";
+
+    similarityFunction_t getLanguageSimilarity = getSimilarityFunction(globalSettings);
+    float max_value = 0.0f;
+    size_t scored = 0;
+
+    // A language costs a hash lookup per text trigram: enough to read the clock every time
+    for (auto& candidate : order) {
+        if (checkDeadline(progress))
+            break;
+
+        const LanguageProfile& language = *allLanguages[candidate.second];
+        float value = getLanguageSimilarity(profile, language.trigramProfile, language.aggregates);
+        scored++;
+        if (value > max_value) {
+            max_value = value;
+            max_value_name = &language.languageCode;
+        }
+        if (!reportLeader(progress, max_value_name))
+            return "";
+    }
+
+    progress->profilesScored.fetch_add(scored, std::memory_order_relaxed);
+    return max_value_name ? *max_value_name : "";
+}
+
+/**
+ * @name compareLanguages
+ * @brief Identifies the language of a text. Scores every language of the script sub-model,
+ * or only those of the best clusters if globalSettings.clusterBeam is set. With a deadline
+ * (see identificationProgress_t), languages are scored most likely first and scoring stops
+ * when time runs out.
+ *
+ * @param profile The profile created from the extracted text
+ * @param model The language model
+ * @param script The script sub-model
+ * @param globalSettings The struct containing all the settings data
+ * @param progress Optional progress report and cancellation flag
+ * @return The language code of the most likely language ("" if cancelled)
+ */
+static std::string compareLanguages(textProfile_t& profile,
+                                    LanguageModel& model,
+                                    script_t script,
+                                    settings_t& globalSettings,
+                                    identificationProgress_t* progress) {
+    thread_local std::vector<unsigned int> members;
+    thread_local LanguageCandidates memberLanguages;
+    LanguageCandidates* languages = &model.scriptLanguages[script];
+
+    if (globalSettings.algorithmSetting == ALGORITHM_NAIVE_BAYES) {
+        const std::string* leader = getNaiveBayesLeader(profile, model, script, progress);
+        if (!reportLeader(progress, leader))
+            return "";
+
+        if (progress)
+            progress->profilesScored.fetch_add(languages->size(), std::memory_order_relaxed);
+        return leader ? *leader : "";
+    }
+
+    bool hasMembers =
+        selectClusterMembers(profile, model, script, globalSettings, members, progress) ||
+        selectIndexCandidates(profile, model, script, globalSettings, members);
+    if (hasDeadline(progress))
+        return compareLanguagesAnytime(
+            profile, model, script, hasMembers ? &members : nullptr, globalSettings, progress);
+
+    if (hasMembers) {
+        memberLanguages.clear();
+        for (unsigned int member : members)
+            memberLanguages.push_back(model.scriptLanguages[SCRIPT_UNKNOWN][member]);
+        languages = &memberLanguages;
+    }
+
+    similarityFunction_t getLanguageSimilarity = getSimilarityFunction(globalSettings);
+    float max_value = 0;
+    float temp_value = 0;
+    std::string* max_value_name = nullptr;
+
+    auto languageIterator = languages->begin();
+
+    while (languageIterator != languages->end()) {
+        temp_value = getLanguageSimilarity(
+            profile, (*languageIterator)->trigramProfile, (*languageIterator)->aggregates);
+        if (temp_value > max_value) {
+            max_value = temp_value;
+            max_value_name = &(*languageIterator)->languageCode;
+        }
+        if (!reportLeader(progress, max_value_name))
+            return "";
+        languageIterator++;
+    }
+
+    if (progress)
+        progress->profilesScored.fetch_add(languages->size(), std::memory_order_relaxed);
+    return max_value_name ? *max_value_name : "";
+}
+
+/**
+ * @name getUTF8Text
+ * @brief Converts a text to UTF-8 when its first bytes show another encoding.
+ *
+ * @param text The text
+ * @param model The language model (its vocabulary helps pick a code page)
+ * @param converted Storage for the converted text
+ * @return text itself, or converted
+ */
+static const std::string& getUTF8Text(const std::string& text,
+                                      const LanguageModel& model,
+                                      std::string& converted) {
+    size_t sampleLength = std::min(text.length(), (size_t)SCRIPT_DETECTION_BYTES);
+    encoding_t encoding = detectEncoding(text.data(), sampleLength, &model.trigramFilter);
+    if (encoding == ENCODING_UTF8)
+        return text;
+
+    transcodeText(text, encoding, converted);
+    return converted;
+}
+
+/**
+ * @name detectInputScript
+ * @brief Detects the script of the first bytes of a text, to pick its sub-model.
+ *
+ * @param model The language model
+ * @param text String of UTF-8 characters
+ * @param maxBytes Maximum number of bytes to inspect
+ * @return The script, SCRIPT_UNKNOWN when no script dominates or no language uses it
+ */
+static script_t detectInputScript(LanguageModel& model,
+                                  const std::string& text,
+                                  size_t maxBytes = SCRIPT_DETECTION_BYTES) {
+    scriptCounts_t counts;
+    countScripts(text, maxBytes, counts);
+
+    script_t script = getDominantScript(counts, SCRIPT_INPUT_SHARE);
+    if (model.scriptLanguages[script].empty())
+        return SCRIPT_UNKNOWN;
+
+    return script;
+}
+
+/**
+ * @name alignSampleWindow
+ * @brief Trims a window read from the middle of a file to whole lines, or to whole UTF-8
+ * characters if it holds no line break.
+ *
+ * @param window The bytes read
+ * @param atFileStart Whether the window starts at offset 0
+ * @param atFileEnd Whether the window ends at the end of the file
+ */
+static void alignSampleWindow(std::string& window, bool atFileStart, bool atFileEnd) {
+    size_t begin = 0;
+    size_t end = window.length();
+
+    size_t firstNewline = window.find('\n');
+    size_t lastNewline = window.rfind('\n');
+
+    if (!atFileStart) {
+        if (firstNewline != std::string::npos && firstNewline != lastNewline)
+            begin = firstNewline + 1;
+        else {
+            while (begin < end && ((unsigned char)window[begin] & 0b11000000) == 0b10000000)
+                begin++;  // Middle bytes of a character
+        }
+    }
+
+    if (!atFileEnd) {
+        if (lastNewline != std::string::npos && lastNewline >= begin)
+            end = lastNewline;
+        else {
+            // Drops the last character only if the window cut it short
+            size_t lead = end;
+            while (lead > begin && ((unsigned char)window[lead - 1] & 0b11000000) == 0b10000000)
+                lead--;
+            if (lead > begin) {
+                unsigned char character = window[--lead];
+                size_t characterLength = 1;
+                if ((character & 0b11100000) == 0b11000000)
+                    characterLength = 2;
+                else if ((character & 0b11110000) == 0b11100000)
+                    characterLength = 3;
+                else if ((character & 0b11111000) == 0b11110000)
+                    characterLength = 4;
+
+                if (lead + characterLength > end)
+                    end = lead;
+            }
+        }
+    }
+
+    window = window.substr(begin, end - begin);
+}
+
+/**
+ * @name readSampleWindows
+ * @brief Reads globalSettings.sampleWindows windows of sampleWindowBytes bytes spread over a
+ * file with pread, converted to UTF-8 and aligned to line starts and UTF-8 boundaries. Small
+ * files are read whole.
+ *
+ * @param path The file path
+ * @param globalSettings The struct containing all the settings data
+ * @param encoding The encoding of the file
+ * @param windows The destination windows, in file order
+ * @param progress Optional progress report
+ * @return false if the file could not be read
+ */
+static bool readSampleWindows(const char* path,
+                              settings_t& globalSettings,
+                              encoding_t encoding,
+                              std::vector<std::string>& windows,
+                              identificationProgress_t* progress) {
+    int fd = open(path, O_RDONLY);
+    struct stat fileStatus;
+    if (fd < 0 || fstat(fd, &fileStatus) < 0) {
+        perror(("Error while opening file " + std::string(path)).c_str());
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    size_t fileSize = (size_t)fileStatus.st_size;
+    size_t windowCount = std::max(1u, globalSettings.sampleWindows);
+    size_t windowBytes = std::max(1u, globalSettings.sampleWindowBytes);
+    std::vector<size_t> offsets;
+
+    if (fileSize <= windowCount * windowBytes) {
+        windowBytes = fileSize;
+        offsets.push_back(0);
+    } else if (globalSettings.samplingSetting == SAMPLING_RANDOM) {
+        std::mt19937_64 generator(globalSettings.sampleSeed);
+        std::uniform_int_distribution<size_t> distribution(0, fileSize - windowBytes);
+
+        for (size_t i = 0; i < windowCount; i++)
+            offsets.push_back(distribution(generator));
+        std::sort(offsets.begin(), offsets.end());
+    } else {
+        for (size_t i = 0; i < windowCount; i++)
+            offsets.push_back(windowCount == 1 ? 0
+                                               : i * (fileSize - windowBytes) / (windowCount - 1));
+    }
+
+    if (progress)
+        progress->bytesTotal.store(offsets.size() * windowBytes, std::memory_order_relaxed);
+
+    windows.clear();
+    std::string converted;
+    for (size_t offset : offsets) {
+        if (encoding == ENCODING_UTF16LE || encoding == ENCODING_UTF16BE)
+            offset &= ~(size_t)1;  // Whole code units
+
+        std::string window(windowBytes, '\0');
+        ssize_t count = pread(fd, &window[0], windowBytes, (off_t)offset);
+        if (count < 0) {
+            perror(("Error while reading file " + std::string(path)).c_str());
+            close(fd);
+            return false;
+        }
+        window.resize(count);
+        if (encoding != ENCODING_UTF8) {
+            transcodeText(window, encoding, converted);
+            window.swap(converted);
+        }
+
+        alignSampleWindow(window, offset == 0, offset + count >= fileSize);
+        windows.push_back(window);
+        reportBytes(progress, count);
+    }
+
+    close(fd);
+    return true;
+}
+
+/**
+ * @name identifyLanguageFromSamples
+ * @brief Identifies the language of a file from windows spread over it. The trigram limit is
+ * shared evenly among the windows, each getting at least SAMPLE_WINDOW_MIN_TRIGRAMS; the line
+ * limit doesn't apply.
+ *
+ * @param path string of characters for the file path
+ * @param model The language model
+ * @param globalSettings The struct containing all the settings data
+ * @param encoding The encoding of the file
+ * @param progress Optional progress report and cancellation flag
+ * @return The language code of the most likely language ("" if cancelled)
+ */
+static std::string identifyLanguageFromSamples(const char* path,
+                                               LanguageModel& model,
+                                               settings_t& globalSettings,
+                                               encoding_t encoding,
+                                               identificationProgress_t* progress) {
+    std::vector<std::string> windows;
+    if (!readSampleWindows(path, globalSettings, encoding, windows, progress))
+        return "";
+
+    // Every window takes part in script detection
+    std::string sampledText;
+    for (auto& window : windows) {
+        sampledText += window.substr(0, SCRIPT_DETECTION_BYTES / windows.size());
+        sampledText += '\n';
+    }
+
+    script_t script = detectInputScript(model, sampledText, sampledText.length());
+    LanguageCandidates& languages = model.scriptLanguages[script];
+    if (languages.size() == 1)
+        return languages.front()->languageCode;  // Only language written in this script
+
+    textProfile_t profile;
+    useModelVocabulary(profile, model);
+    settings_t windowSettings = globalSettings;
+    size_t operations = 0;
+    bool isExpired = false;
+    windowSettings.trigramLimit = std::max(
+        SAMPLE_WINDOW_MIN_TRIGRAMS, globalSettings.trigramLimit / (unsigned int)windows.size());
+
+    for (auto& window : windows) {
+        windowSettings.trigramCurrentCount = 0;
+        size_t start = 0;
+
+        while (!isExpired && start < window.length() &&
+               windowSettings.trigramCurrentCount < windowSettings.trigramLimit) {
+            size_t end = window.find('\n', start);
+            if (end == std::string::npos)
+                end = window.length();
+
+            std::string line = window.substr(start, end - start);
+            addToTextProfile(line, profile, model.trigramFilter, windowSettings);
+            if (globalSettings.featureSetting == FEATURES_CODE)
+                addToCodeProfile(line, profile.trigrams);
+
+            isExpired = isPastDeadline(progress, operations, end + 1 - start);
+            start = end + 1;
+        }
+
+        if (!reportBytes(progress, 0))
+            return "";
+    }
+
+    if (globalSettings.featureSetting == FEATURES_CODE)
+        updateTextProfileNorms(profile);  // Code features are added outside extraction
+
+    return compareLanguages(profile, model, script, globalSettings, progress);
+}
+
+/**
+ * @name identifyLanguageFromWholeFile
+ * @brief Identifies the language of a file from all of its lines, profiled in parallel (see
+ * buildTextProfileParallel). The line and trigram limits don't apply.
+ *
+ * @param path string of characters for the file path
+ * @param model The language model
+ * @param globalSettings The struct containing all the settings data
+ * @param progress Optional progress report and cancellation flag
+ * @return The language code of the most likely language ("" if cancelled)
+ */
+static std::string identifyLanguageFromWholeFile(const char* path,
+                                                 LanguageModel& model,
+                                                 settings_t& globalSettings,
+                                                 identificationProgress_t* progress) {
+    inputStream_t stream;
+    std::string text;
+    if (!openInputStream(path, stream))
+        return "";
+
+    peekInputStream(stream, SCRIPT_DETECTION_BYTES, text);
+    setInputStreamEncoding(
+        stream, detectEncoding(text.data(), text.length(), &model.trigramFilter));
+
+    text.clear();
+    if (!readInputStream(stream, text))
+        return "";
+    closeInputStream(stream);
+    size_t length = text.length();
+
+    if (progress)
+        progress->bytesTotal.store(length, std::memory_order_relaxed);
+
+    script_t script = detectInputScript(model, text);
+    LanguageCandidates& languages = model.scriptLanguages[script];
+    if (languages.size() == 1)
+        return languages.front()->languageCode;  // Only language written in this script
+
+    textProfile_t profile;
+    useModelVocabulary(profile, model);
+    if (!buildTextProfileParallel(text, profile, model.trigramFilter, globalSettings, progress))
+        return "";
+
+    return compareLanguages(profile, model, script, globalSettings, progress);
+}
+
+/**
+ * @name identifyLanguageFromPath
+ * @brief Identifies the language of a text given the file path; reads the first lines,
+ * windows spread over the file or the whole file, as set by globalSettings.samplingSetting.
+ * Compressed files (see InputStream.h) are decoded only as far as the lines read, and text in
+ * another encoding is converted to UTF-8 (see TextEncoding.h).
+ *
+ * @param path string of characters for the file path
+ * @param model The language model
+ * @param globalSettings The struct containing all the settings data
+ * @param progress Optional progress report and cancellation flag
+ * @return The language code of the most likely language ("" if cancelled)
+ */
+std::string identifyLanguageFromPath(char* path,
+                                     LanguageModel& model,
+                                     settings_t& globalSettings,
+                                     identificationProgress_t* progress) {
+    if (globalSettings.samplingSetting == SAMPLING_FULL)
+        return identifyLanguageFromWholeFile(path, model, globalSettings, progress);
+
+    inputStream_t stream;
+    std::string extractedText;
+    textProfile_t profile;
+
+    globalSettings.trigramCurrentCount = 0;
+
+    if (!openInputStream(path, stream))
+        return "";
+
+    // Peeks at the beginning of the file to detect its encoding
+    peekInputStream(stream, SCRIPT_DETECTION_BYTES, extractedText);
+    encoding_t encoding =
+        detectEncoding(extractedText.data(), extractedText.length(), &model.trigramFilter);
+
+    // Compressed files can't be read at arbitrary offsets: their first lines are read instead
+    if (globalSettings.samplingSetting != SAMPLING_NONE &&
+        stream.compression == COMPRESSION_NONE) {
+        closeInputStream(stream);
+        return identifyLanguageFromSamples(path, model, globalSettings, encoding, progress);
+    }
+
+    if (progress)
+        progress->bytesTotal.store(stream.fileSize, std::memory_order_relaxed);
+
+    // Peeks again, in UTF-8, to pick the sub-model
+    setInputStreamEncoding(stream, encoding);
+    if (encoding != ENCODING_UTF8)
+        peekInputStream(stream, SCRIPT_DETECTION_BYTES, extractedText);
+
+    script_t script = detectInputScript(model, extractedText);
+    LanguageCandidates& languages = model.scriptLanguages[script];
+    if (languages.size() == 1)
+        return languages.front()->languageCode;  // Only language written in this script
+
+    // Stops reading once the trigram limit is reached or the deadline has passed
+    useModelVocabulary(profile, model);
+    size_t operations = 0;
+    size_t position = 0;
+    for (unsigned int counter = 0;
+         (counter < globalSettings.lineLimit) &&
+         (globalSettings.trigramCurrentCount < globalSettings.trigramLimit) &&
+         (readInputLine(stream, extractedText));
+         counter++) {
+        addToTextProfile(extractedText, profile, model.trigramFilter, globalSettings);
+        if (globalSettings.featureSetting == FEATURES_CODE)
+            addToCodeProfile(extractedText, profile.trigrams);
+
+        size_t nextPosition = getInputStreamPosition(stream);
+        if (!reportBytes(progress, nextPosition - position))
+            return "";
+        position = nextPosition;
+        if (isPastDeadline(progress, operations, extractedText.size() + 1))
+            break;
+    }
+
+    if (globalSettings.featureSetting == FEATURES_CODE)
+        updateTextProfileNorms(profile);  // Code features are added outside extraction
+
+    return compareLanguages(profile, model, script, globalSettings, progress);
+}
+
+/**
+ * @name buildTextProfile
+ * @brief Builds the trigram profile of a '\n'-separated text, with its norms, reading at most
+ * globalSettings.lineLimit lines, and none past the deadline of progress.
+ *
+ * @param text String of UTF-8 characters
+ * @param profile The destination text profile (cleared before use, keeps its vocabulary)
+ * @param filter Filter of the trigrams present in some language (used without a vocabulary)
+ * @param globalSettings The struct containing all the settings data
+ * @param progress Optional progress report and cancellation flag
+ * @return false if cancelled
+ */
+bool buildTextProfile(const std::string& text,
+                      textProfile_t& profile,
+                      const bloomFilter_t& filter,
+                      settings_t& globalSettings,
+                      identificationProgress_t* progress) {
+    thread_local std::string line;
+
+    globalSettings.trigramCurrentCount = 0;
+    clearTextProfile(profile);
+
+    // Line by line iteration
+    unsigned int line_count = 0;
+    size_t operations = 0;
+    size_t start = 0;
+    size_t line_end = 0;
+    size_t end = 0;
+
+    while (line_count < globalSettings.lineLimit && start < text.length() &&
+           globalSettings.trigramCurrentCount < globalSettings.trigramLimit) {
+        // Find next line
+        if ((end = text.find('\n', start)) == std::string::npos) {
+            end = text.length();  // Special case: One long line
+        }
+
+        if (end > 0 && text[end - 1] == '\r') {
+            line_end = end - 1;  // Windows style end symbol '\r'
+        } else {
+            line_end = end;
+        }
+
+        line.assign(text, start, line_end - start);
+        addToTextProfile(line, profile, filter, globalSettings);
+        if (globalSettings.featureSetting == FEATURES_CODE)
+            addToCodeProfile(line, profile.trigrams);
+        if (!reportBytes(progress, std::min(end + 1, text.length()) - start))
+            return false;
+        if (isPastDeadline(progress, operations, end + 1 - start))
+            break;
+
+        line_count++;
+        start = end + 1;  // Move past the newline
+    }
+
+    if (globalSettings.featureSetting == FEATURES_CODE)
+        updateTextProfileNorms(profile);  // Code features are added outside extraction
+
+    return true;
+}
+
+/**
+ * @name isSynchronizedAt
+ * @brief Checks that decoding a line from its start reaches a character boundary at a
+ * position, i.e. that no earlier lead byte claims it as a middle byte (forEachTrigram doesn't
+ * validate middle bytes, so in malformed text a lead byte may swallow the next ASCII bytes).
+ *
+ * @param data The text bytes
+ * @param position The position
+ * @return true if decoding always restarts at position
+ */
+static bool isSynchronizedAt(const unsigned char* data, size_t position) {
+    for (size_t back = 1; back <= 3 && back <= position; back++) {
+        unsigned char character = data[position - back];
+        if (character == '\n')
+            break;  // Start of the line
+        size_t characterLength = 1;
+        if ((character & 0b11100000) == 0b11000000)
+            characterLength = 2;
+        else if ((character & 0b11110000) == 0b11100000)
+            characterLength = 3;
+        else if ((character & 0b11111000) == 0b11110000)
+            characterLength = 4;
+
+        if (characterLength > back)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @name alignChunkBoundary
+ * @brief Moves a parallel chunk boundary to a point where forEachTrigram restarts in the same
+ * state it would have reached from the start of the line: the start of a line within
+ * PARALLEL_LINE_SEARCH_BYTES, else (very long lines) the next synchronized character that is
+ * not a separator, which is never collapsed and always enters the trigram window.
+ *
+ * @param text The text
+ * @param position The target boundary
+ * @return The boundary (text.length() if there is none)
+ */
+static size_t alignChunkBoundary(const std::string& text, size_t position) {
+    const unsigned char* data = (const unsigned char*)text.data();
+    size_t searchEnd = std::min(text.length(), position + PARALLEL_LINE_SEARCH_BYTES);
+
+    const void* newline = memchr(data + position, '\n', searchEnd - position);
+    if (newline)
+        return (const unsigned char*)newline - data + 1;
+
+    while (position < text.length() && data[position] != '\n') {
+        unsigned char character = data[position];
+        uint32_t codepoint;
+        size_t characterLength;
+
+        if (!(character & 0b10000000)) {
+            codepoint = character;
+            characterLength = 1;
+        } else if ((character & 0b11100000) == 0b11000000) {
+            codepoint = character & 0b00011111;
+            characterLength = 2;
+        } else if ((character & 0b11110000) == 0b11100000) {
+            codepoint = character & 0b00001111;
+            characterLength = 3;
+        } else if ((character & 0b11111000) == 0b11110000) {
+            codepoint = character & 0b00000111;
+            characterLength = 4;
+        } else {
+            position++;  // Middle byte
+            continue;
+        }
+
+        if (position + characterLength > text.length())
+            return text.length();
+
+        for (size_t i = 1; i < characterLength; i++)
+            codepoint = (codepoint << 6) | (data[position + i] & 0b00111111);
+
+        if (foldCodepoint(codepoint) != ' ' && isSynchronizedAt(data, position))
+            return position;
+
+        position++;
+    }
+
+    return position < text.length() ? position + 1 : text.length();  // Past the line break
+}
+
+/**
+ * @name addChunkToTextProfile
+ * @brief Profiles the trigrams starting in [begin, end) of a text, line by line as
+ * buildTextProfile does, without limits. The last line is decoded past end so its trigrams
+ * starting before end are complete; a line cut at begin belongs to the previous chunk for its
+ * code features.
+ *
+ * @param text String of UTF-8 characters
+ * @param begin First byte of the chunk (see alignChunkBoundary)
+ * @param end One past the last byte of the chunk
+ * @param filter Filter of the trigrams present in some language
+ * @param globalSettings The struct containing all the settings data
+ * @param profile The destination text profile (its norms are not updated)
+ * @param progress Optional progress report and cancellation flag
+ */
+static void addChunkToTextProfile(const std::string& text,
+                                  size_t begin,
+                                  size_t end,
+                                  const bloomFilter_t& filter,
+                                  const settings_t& globalSettings,
+                                  textProfile_t& profile,
+                                  identificationProgress_t* progress) {
+    std::string line;
+    size_t lineStart = begin;
+    size_t reportedEnd = begin;
+    size_t operations = 0;
+
+    while (lineStart < end) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = text.length();
+
+        size_t trigramsEnd = lineEnd;
+        if (trigramsEnd > lineStart && text[trigramsEnd - 1] == '\r')
+            trigramsEnd--;  // Windows style end symbol '\r'
+
+        forEachTrigram(text, lineStart, trigramsEnd, [&](const std::string& trigram, size_t at) {
+            if (at >= end)
+                return false;  // Belongs to the next chunk
+
+            addTrigramToTextProfile(trigram, profile, filter);
+            return true;
+        });
+
+        bool isWholeLine = lineStart == 0 || text[lineStart - 1] == '\n';
+        if (globalSettings.featureSetting == FEATURES_CODE && isWholeLine) {
+            line.assign(text, lineStart, trigramsEnd - lineStart);
+            addToCodeProfile(line, profile.trigrams);
+        }
+
+        if (isPastDeadline(progress, operations, lineEnd + 1 - lineStart))
+            return;
+
+        lineStart = lineEnd + 1;
+        if (lineStart - reportedEnd >= PARALLEL_REPORT_BYTES || lineStart >= end) {
+            if (!reportBytes(progress, std::min(lineStart, end) - reportedEnd))
+                return;
+            reportedEnd = std::min(lineStart, end);
+        }
+    }
+}
+
+/**
+ * @name buildTextProfileParallel
+ * @brief Builds the trigram profile of a whole '\n'-separated text, without line or trigram
+ * limits, splitting it into one chunk per thread.
+ * Chunk boundaries are aligned so that every trigram is counted by exactly one chunk, and the
+ * merged profile is the one a single thread would build (counts are exact up to 2^24 per
+ * trigram, the float limit). Past the deadline of progress, every chunk stops at its next
+ * line and the profile holds the lines read so far.
+ *
+ * @param text String of UTF-8 characters
+ * @param profile The destination text profile (cleared before use, keeps its vocabulary)
+ * @param filter Filter of the trigrams present in some language (used without a vocabulary)
+ * @param globalSettings The struct containing all the settings data (profileThreads and
+ * featureSetting)
+ * @param progress Optional progress report and cancellation flag
+ * @return false if cancelled
+ */
+bool buildTextProfileParallel(const std::string& text,
+                              textProfile_t& profile,
+                              const bloomFilter_t& filter,
+                              const settings_t& globalSettings,
+                              identificationProgress_t* progress) {
+    size_t threadCount = globalSettings.profileThreads;
+    if (!threadCount)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::max((size_t)1,
+                           std::min(threadCount, text.length() / PARALLEL_CHUNK_MIN_BYTES));
+
+    std::vector<size_t> boundaries(1, 0);
+    for (size_t i = 1; i < threadCount; i++) {
+        size_t boundary = alignChunkBoundary(text, i * text.length() / threadCount);
+        if (boundary > boundaries.back() && boundary < text.length())
+            boundaries.push_back(boundary);
+    }
+    boundaries.push_back(text.length());
+
+    std::vector<textProfile_t> chunkProfiles(boundaries.size() - 1);
+    for (auto& chunkProfile : chunkProfiles) {
+        setTextProfileVocabulary(chunkProfile, profile.vocabulary);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunkProfiles.size(); i++)
+        threads.emplace_back(addChunkToTextProfile,
+                             std::cref(text),
+                             boundaries[i],
+                             boundaries[i + 1],
+                             std::cref(filter),
+                             std::cref(globalSettings),
+                             std::ref(chunkProfiles[i]),
+                             progress);
+    addChunkToTextProfile(
+        text, 0, boundaries[1], filter, globalSettings, chunkProfiles[0], progress);
+    for (auto& thread : threads)
+        thread.join();
+
+    if (progress && progress->cancelRequested.load(std::memory_order_relaxed))
+        return false;
+
+    // Merges into the largest table
+    size_t largest = 0;
+    for (size_t i = 1; i < chunkProfiles.size(); i++) {
+        if (getTextTrigramCount(chunkProfiles[i]) > getTextTrigramCount(chunkProfiles[largest]))
+            largest = i;
+    }
+
+    profile = std::move(chunkProfiles[largest]);
+    for (size_t i = 0; i < chunkProfiles.size(); i++) {
+        if (i == largest)
+            continue;
+
+        for (uint32_t slot : chunkProfiles[i].touchedSlots) {
+            if (profile.slotCounts[slot] == 0.0f)
+                profile.touchedSlots.push_back(slot);
+            profile.slotCounts[slot] += chunkProfiles[i].slotCounts[slot];
+        }
+        for (auto& entry : chunkProfiles[i].trigrams)
+            profile.trigrams[entry.first].real += entry.second.real;
+        profile.unknownCount += chunkProfiles[i].unknownCount;
+    }
+    updateTextProfileNorms(profile);  // Squared counts of the chunks don't add up
+
+    return true;
+}
+
+/**
+ * @name identifyLanguageFromClipboard
+ * @brief Identifies the language of a text given the clipboard contents
+ *
+ * @param path string of characters from the clipboard
+ * @param model The language model
+ * @param globalSettings The struct containing all the settings data
+ * @param progress Optional progress report and cancellation flag
+ * @return The language code of the most likely language ("" if cancelled)
+ */
+std::string identifyLanguageFromClipboard(std::string& clipboard,
+                                          LanguageModel& model,
+                                          settings_t& globalSettings,
+                                          identificationProgress_t* progress) {
+    // Counts in vocabulary slots: no allocation once the slot array exists
+    thread_local textProfile_t profile;
+    thread_local std::string converted;
+
+    // Special case: empty clipboard
+    if (clipboard.empty()) {
+        perror(("Error while opening Clipboard"));
+        return "";
+    }
+
+    if (progress)
+        progress->bytesTotal.store(clipboard.size(), std::memory_order_relaxed);
+
+    const std::string& text = getUTF8Text(clipboard, model, converted);
+    script_t script = detectInputScript(model, text);
+    LanguageCandidates& languages = model.scriptLanguages[script];
+    if (languages.size() == 1)
+        return languages.front()->languageCode;  // Only language written in this script
+
+    useModelVocabulary(profile, model);
+    if (!buildTextProfile(text, profile, model.trigramFilter, globalSettings, progress))
+        return "";
+
+    return compareLanguages(profile, model, script, globalSettings, progress);
+}
+
+/**
+ * @name identifyLanguagesBatch
+ * @brief Identifies the language of several texts at once.
+ * Every language profile is visited once per batch instead of once per text, so its hash
+ * table stays in cache while all the text profiles are scored against it. With
+ * globalSettings.clusterBeam set, each text is only scored against the languages of its best
+ * clusters.
+ *
+ * @param texts The texts to identify
+ * @param model The language model
+ * @param globalSettings The struct containing all the settings data
+ * @param results The language codes of the most likely languages, one per text
+ * ("" when none matched)
+ */
+void identifyLanguagesBatch(const std::vector<std::string>& texts,
+                            LanguageModel& model,
+                            settings_t& globalSettings,
+                            std::vector<std::string>& results) {
+    thread_local std::vector<textProfile_t> profiles;
+    similarityFunction_t getLanguageSimilarity = getSimilarityFunction(globalSettings);
+    std::vector<script_t> scripts(texts.size());
+    std::vector<float> max_values(texts.size(), 0.0f);
+    std::vector<const std::string*> max_value_names(texts.size(), nullptr);
+    LanguageCandidates& allLanguages = model.scriptLanguages[SCRIPT_UNKNOWN];
+    // Per text, whether each language is scored (empty: every language of its script)
+    std::vector<std::vector<bool>> scored(texts.size());
+    std::vector<unsigned int> members;
+    std::string converted;
+
+    if (profiles.size() < texts.size())
+        profiles.resize(texts.size());
+
+    for (size_t i = 0; i < texts.size(); i++) {
+        // The profile may still point at the vocabulary of a model reloaded since
+        useModelVocabulary(profiles[i], model);
+
+        const std::string& text = getUTF8Text(texts[i], model, converted);
+        scripts[i] = detectInputScript(model, text);
+
+        LanguageCandidates& languages = model.scriptLanguages[scripts[i]];
+        if (languages.size() == 1) {
+            // Only language written in this script
+            max_value_names[i] = &languages.front()->languageCode;
+            clearTextProfile(profiles[i]);
+            continue;
+        }
+
+        buildTextProfile(text, profiles[i], model.trigramFilter, globalSettings, nullptr);
+
+        if (globalSettings.algorithmSetting == ALGORITHM_NAIVE_BAYES) {
+            // One pass over the index already scores every language
+            max_value_names[i] = getNaiveBayesLeader(profiles[i], model, scripts[i], nullptr);
+            clearTextProfile(profiles[i]);
+            continue;
+        }
+
+        if (selectClusterMembers(
+                profiles[i], model, scripts[i], globalSettings, members, nullptr) ||
+            selectIndexCandidates(profiles[i], model, scripts[i], globalSettings, members)) {
+            scored[i].assign(allLanguages.size(), false);
+            for (unsigned int member : members)
+                scored[i][member] = true;
+        }
+    }
+
+    for (unsigned int index = 0; index < allLanguages.size(); index++) {
+        LanguageProfile& language = *allLanguages[index];
+
+        for (size_t i = 0; i < texts.size(); i++) {
+            if (!getTextTrigramCount(profiles[i]))
+                continue;
+            if (scripts[i] != SCRIPT_UNKNOWN && !(language.scriptMask & (1u << scripts[i])))
+                continue;
+            if (!scored[i].empty() && !scored[i][index])
+                continue;
+
+            float value =
+                getLanguageSimilarity(profiles[i], language.trigramProfile, language.aggregates);
+            if (value > max_values[i]) {
+                max_values[i] = value;
+                max_value_names[i] = &language.languageCode;
+            }
+        }
+    }
+
+    results.resize(texts.size());
+    for (size_t i = 0; i < texts.size(); i++)
+        results[i] = max_value_names[i] ? *max_value_names[i] : "";
+}
+
+/**
+ * @name indexLanguageModel
+ * @brief Classifies every language profile by script and builds the per-script sub-models
+ * and the inverted trigram index, the filter and the perfect hash of every trigram present
+ * in some language, the compressed language index and the language clusters.
+ * Must be called after the profiles of a model are loaded or changed (and normalized).
+ * A language joins the sub-model of every script holding at least SCRIPT_LANGUAGE_SHARE of
+ * its letters, so mixed-script languages such as Japanese (kana and kanji) are reachable
+ * from both.
+ *
+ * @param model The language model
+ */
+void indexLanguageModel(LanguageModel& model) {
+    for (auto& candidates : model.scriptLanguages)
+        candidates.clear();
+
+    for (auto& language : model.languages) {
+        scriptCounts_t counts;
+        float total = 0.0f;
+
+        for (auto& entry : language.trigramProfile) {
+            countScripts(entry.first, entry.first.length(), counts, entry.second.real);
+        }
+
+        for (int script = SCRIPT_UNKNOWN + 1; script < SCRIPT_COUNT; script++)
+            total += counts.letters[script];
+
+        language.scriptMask = 0;
+        for (int script = SCRIPT_UNKNOWN + 1; script < SCRIPT_COUNT; script++) {
+            if (total > 0.0f && counts.letters[script] >= SCRIPT_LANGUAGE_SHARE * total) {
+                language.scriptMask |= 1u << script;
+                model.scriptLanguages[script].push_back(&language);
+            }
+        }
+
+        model.scriptLanguages[SCRIPT_UNKNOWN].push_back(&language);
+    }
+
+    for (auto& language : model.languages)
+        aggregateTrigramProfile(language.trigramProfile, language.aggregates);
+
+    model.trigramIndex.clear();
+    LanguageCandidates& allLanguages = model.scriptLanguages[SCRIPT_UNKNOWN];
+    for (unsigned int i = 0; i < allLanguages.size(); i++) {
+        for (auto& entry : allLanguages[i]->trigramProfile) {
+            trigramPosting_t posting = {i, entry.second.normalized, 0.0f};
+            model.trigramIndex[entry.first].push_back(posting);
+        }
+    }
+
+    // Naive Bayes: P(t | language) = (1 - s) * count_t / total + s / V, V being the number of
+    // trigrams of the model, so logRatio = log(1 + (1 - s) / s * V * count_t / total)
+    float smoothing = (1.0f - NAIVE_BAYES_SMOOTHING) / NAIVE_BAYES_SMOOTHING *
+                      (float)model.trigramIndex.size();
+    for (auto& entry : model.trigramIndex) {
+        for (auto& posting : entry.second) {
+            const value_t& value = allLanguages[posting.language]->trigramProfile[entry.first];
+            float total = allLanguages[posting.language]->aggregates.realTotal;
+            posting.logRatio = total > 0.0f ? log1pf(smoothing * value.real / total) : 0.0f;
+        }
+    }
+
+    model.trigramFilter = bloomFilter_t();
+    initBloomFilter(model.trigramFilter, model.trigramIndex.size());
+    for (auto& entry : model.trigramIndex)
+        addToBloomFilter(model.trigramFilter, entry.first);
+
+    std::vector<std::string> vocabulary;
+    vocabulary.reserve(model.trigramIndex.size());
+    for (auto& entry : model.trigramIndex)
+        vocabulary.push_back(entry.first);
+    if (!buildPerfectHash(vocabulary, model.trigramHash))
+        std::cout << "Could not hash the trigram vocabulary." << std::endl;
+
+    model.slotPostings.resize(model.trigramHash.keys.size());
+    for (uint32_t slot = 0; slot < model.slotPostings.size(); slot++)
+        model.slotPostings[slot] = &model.trigramIndex[model.trigramHash.keys[slot]];
+
+    buildLanguageIndex(allLanguages, LANGUAGE_INDEX_BUDGET_BYTES, model.languageIndex);
+
+    clusterLanguageModel(model);
+}
+
+/**
+ * @name readLanguageProfile
+ * @brief Reads the trigram profile of a language, merging its trigrams into their normalized
+ * form. Code features (see CodeFeatures.h) are kept as they are.
+ *
+ * @param trigramsPath Folder containing one <language code>.lqp or .csv trigram profile per
+ * language
+ * @param languageCode The language code
+ * @param profile The destination profile (counts only; cleared before use)
+ * @return true Succeeded
+ * @return false Failed
+ */
+bool readLanguageProfile(const std::string& trigramsPath,
+                         const std::string& languageCode,
+                         TrigramProfile& profile) {
+    // A binary profile (see ProfileFile.h) replaces the CSV file of the same language
+    TrigramProfile fileProfile;
+    string binaryPath = trigramsPath + languageCode + PROFILE_FILE_EXTENSION;
+    if (ifstream(binaryPath).good()) {
+        if (!readProfileFile(binaryPath, fileProfile)) {
+            cerr << "Invalid profile file " << binaryPath << endl;
+            return false;
+        }
+    } else if (!readProfileCSV(trigramsPath + languageCode + ".csv", fileProfile))
+        return false;
+
+    profile.clear();
+    for (auto& entry : fileProfile) {
+        string trigram;
+
+        // Profiles built from raw text are merged into their normalized trigrams
+        if (isCodeFeature(entry.first))
+            profile[entry.first].real += entry.second.real;
+        else if (foldTrigram(entry.first, trigram))
+            profile[trigram].real += entry.second.real;
+    }
+
+    return true;
+}
+
+/**
+ * @name loadLanguagesData
+ * @brief Loads trigram data.
+ *
+ * @param languageCodeNamesPath CSV file with the language code vs. language name pairs
+ * @param trigramsPath Folder containing one <language code>.lqp or .csv trigram profile per
+ * language
+ * @param model The language model to fill: names, trigram profiles and script sub-models
+ * @return true Succeeded
+ * @return false Failed
+ */
+bool loadLanguagesData(const std::string& languageCodeNamesPath,
+                       const std::string& trigramsPath,
+                       LanguageModel& model) {
+    LanguageProfiles& languages = model.languages;
+
+    // Reads available language codes
+    cout << "Reading language codes..." << endl;
+
+    CSVData languageCodesCSVData;
+    if (!readCSV(languageCodeNamesPath, languageCodesCSVData))
+        return false;
+
+    // Reads trigram profile for each language code
+    for (auto& fields : languageCodesCSVData) {
+        if (fields.size() != 2)
+            continue;
+
+        string languageCode = fields[0];
+        string languageName = fields[1];
+
+        model.languageCodeNames[languageCode] = languageName;
+
+        cout << "Reading trigram profile for language code \"" << languageCode << "\"..." << endl;
+
+        languages.push_back(LanguageProfile());
+        LanguageProfile& language = languages.back();
+
+        language.languageCode = languageCode;
+        if (!readLanguageProfile(trigramsPath, languageCode, language.trigramProfile))
+            return false;
+
+        normalizeTrigramProfile(language.trigramProfile);
+    }
+
+    indexLanguageModel(model);
+
+    return true;
+}
@@ -1,85 +1,323 @@
-/**
- * @brief Lequel? language identification based on trigrams
- * @author Marc S. Ressl
- *
- * @copyright Copyright (c) 2022-2023
- *
- * @cite
- * https://towardsdatascience.com/understanding-cosine-similarity-and-its-application-fd42f585296a
- */
-
-#ifndef LEQUEL_H
-#define LEQUEL_H
-
-#include <list>
-#include <map>
-#include <string>
-#include <unordered_map>
-
-#include "CSVData.h"
-#include "Text.h"
-
-// #define NORMAL_TOGGLE_ENABLE  //(Un)commenting toggles the normalized/real values swap with a
-// trigram limit bar
-
-#ifdef NORMAL_TOGGLE_ENABLE
-// value_t: holds both real and normalized values
-struct value_t {
-    float real;
-    float normalized;
-};
-#endif
-
-// algorithmSetting_t: indicates which similarity model to use
-typedef enum { ALGORITHM_COSINE, ALGORITHM_JACCARD, ALGORITHM_CAVNARTRENKLE } algorithmSetting_t;
-// valueProcessingSetting_t: toggles real or normalized values to process
-typedef enum { VALUE_NORMALIZE = 0, VALUE_REAL } valueProcessingSetting_t;
-
-// settings_t: determines settings across the programs
-struct settings_t {
-    algorithmSetting_t algorithmSetting = ALGORITHM_COSINE;
-#ifdef NORMAL_TOGGLE_ENABLE
-    valueProcessingSetting_t valueProcessingSetting = VALUE_NORMALIZE;
-#else
-    const valueProcessingSetting_t valueProcessingSetting = VALUE_NORMALIZE;
-    unsigned int trigramLimit = 100;
-    unsigned int trigramCurrentCount = 0;
-#endif
-    unsigned int lineLimit = 100;
-};
-
-// TrigramProfile: map of trigram -> frequency
-// Swapped map for unordered_map
-#ifdef NORMAL_TOGGLE_ENABLE
-typedef std::unordered_map<std::string, value_t> TrigramProfile;
-#else
-typedef std::unordered_map<std::string, float> TrigramProfile;
-#endif
-
-// TrigramList: list of trigrams
-typedef std::list<std::string> TrigramList;
-
-struct LanguageProfile {
-    std::string languageCode;
-    TrigramProfile trigramProfile;
-};
-
-typedef std::list<LanguageProfile> LanguageProfiles;
-
-// Functions
-TrigramProfile buildTrigramProfile(const Text& text);
-void normalizeTrigramProfile(TrigramProfile& trigramProfile);
-float getCosineSimilarity(TrigramProfile& textProfile, TrigramProfile& languageProfile);
-std::string identifyLanguage(const Text& text, LanguageProfiles& languages);
-
-std::string identifyLanguageFromPath(char* path,
-                                     LanguageProfiles& languages,
-                                     settings_t& globalSettings);
-
-std::string identifyLanguageFromClipboard(std::string& clipboard,
-                                          LanguageProfiles& languages,
-                                          settings_t& globalSettings);
-
-void addToTrigramProfile(const std::string& text, TrigramProfile& profile);
-
-#endif
+/**
+ * @brief Lequel? language identification based on trigrams
+ * @author Marc S. Ressl
+ *
+ * @copyright Copyright (c) 2022-2023
+ *
+ * @cite
+ * https://towardsdatascience.com/understanding-cosine-similarity-and-its-application-fd42f585296a
+ */
+
+#ifndef LEQUEL_H
+#define LEQUEL_H
+
+#include <math.h>
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BloomFilter.h"
+#include "CSVData.h"
+#include "PerfectHash.h"
+#include "Text.h"
+#include "UnicodeScript.h"
+
+// value_t: holds both real and normalized values
+struct value_t {
+    float real = 0.0f;
+    float normalized = 0.0f;
+};
+
+// algorithmSetting_t: indicates which similarity model to use
+typedef enum {
+    ALGORITHM_COSINE,
+    ALGORITHM_JACCARD,
+    ALGORITHM_CAVNARTRENKLE,
+    ALGORITHM_NAIVE_BAYES  // Log-probabilities precomputed at load, scored through the index
+} algorithmSetting_t;
+// valueProcessingSetting_t: toggles real or normalized values to process
+typedef enum { VALUE_NORMALIZE = 0, VALUE_REAL } valueProcessingSetting_t;
+
+// featureSetting_t: what is extracted from the text
+typedef enum {
+    FEATURES_TRIGRAMS = 0,  // Natural languages
+    FEATURES_CODE           // Trigrams plus source code tokens (see CodeFeatures.h)
+} featureSetting_t;
+
+// samplingSetting_t: which part of a file identifyLanguageFromPath reads
+typedef enum {
+    SAMPLING_NONE = 0,  // The first lineLimit lines
+    SAMPLING_EVEN,      // sampleWindows evenly spaced windows (compressed files: as NONE)
+    SAMPLING_RANDOM,    // sampleWindows windows at random offsets (repeatable with sampleSeed)
+    SAMPLING_FULL       // The whole file, profiled by profileThreads threads (no limits)
+} samplingSetting_t;
+
+#define ALGORITHM_COUNT 4
+#define VALUE_PROCESSING_COUNT 2
+
+// settings_t: determines settings across the programs
+struct settings_t {
+    algorithmSetting_t algorithmSetting = ALGORITHM_COSINE;
+    valueProcessingSetting_t valueProcessingSetting = VALUE_NORMALIZE;
+    featureSetting_t featureSetting = FEATURES_TRIGRAMS;
+    unsigned int trigramLimit = 100;
+    unsigned int trigramCurrentCount = 0;
+    unsigned int lineLimit = 100;
+    samplingSetting_t samplingSetting = SAMPLING_NONE;
+    unsigned int sampleWindows = 16;
+    unsigned int sampleWindowBytes = 4096;
+    unsigned int sampleSeed = 1;
+    unsigned int clusterBeam = 0;  // Best clusters whose languages are scored (0: all of them)
+    unsigned int indexCandidates = 0;  // Best languages of the index that are scored (0: all)
+    unsigned int profileThreads = 0;  // Threads profiling a whole text (0: one per core)
+};
+
+// Fewest trigrams read from each sampling window, whatever share of trigramLimit it gets
+#define SAMPLE_WINDOW_MIN_TRIGRAMS 16u
+
+// Minimum bytes per thread of a parallel profile; smaller inputs use fewer threads
+#define PARALLEL_CHUNK_MIN_BYTES (1 << 20)
+// Bytes searched for a line break after each parallel chunk boundary
+#define PARALLEL_LINE_SEARCH_BYTES (1 << 16)
+// Bytes a parallel chunk profiles between progress reports
+#define PARALLEL_REPORT_BYTES (1 << 20)
+
+// TrigramProfile: map of trigram -> frequency
+// Swapped map for unordered_map
+typedef std::unordered_map<std::string, value_t> TrigramProfile;
+
+// textProfile_t: the profile of a text being identified. Trigrams that no language contains
+// (outside the vocabulary, or rejected by LanguageModel::trigramFilter without one) are only
+// counted: they can't match, so they just add to the text norm, as distinct trigrams seen
+// once each. Only counts are stored; both norms are kept up to date during extraction and
+// applied when scoring.
+// With a vocabulary (LanguageModel::trigramHash, see setTextProfileVocabulary), trigrams are
+// counted in a dense array indexed by vocabulary slot, and only the touched slots are reset
+// for the next text
+struct textProfile_t {
+    TrigramProfile trigrams;  // Counts (value_t::real): code features, or every trigram
+                              // without a vocabulary
+    const perfectHash_t* vocabulary = nullptr;
+    std::vector<float> slotCounts;       // Count of every vocabulary slot
+    std::vector<uint32_t> touchedSlots;  // Slots with a count, in order of appearance
+    float unknownCount = 0.0f;
+    float sum = 0.0f;             // Sum of the counts, unknown trigrams included (L1 norm)
+    float sumSquares = 0.0f;      // Sum of the squared counts, unknown trigrams included
+};
+
+/**
+ * @name getTextTrigramCount
+ * @brief Returns the number of distinct trigrams (and code features) of a text profile,
+ * unknown trigrams excluded.
+ *
+ * @param profile The text profile
+ * @return The number of counts stored
+ */
+inline size_t getTextTrigramCount(const textProfile_t& profile) {
+    return profile.touchedSlots.size() + profile.trigrams.size();
+}
+
+/**
+ * @name forEachTextTrigram
+ * @brief Visits the counts of a text profile, vocabulary slots first.
+ *
+ * @param profile The text profile
+ * @param handler Called as handler(const std::string& trigram, float count)
+ */
+template <typename TrigramHandler>
+void forEachTextTrigram(const textProfile_t& profile, TrigramHandler handler) {
+    for (uint32_t slot : profile.touchedSlots)
+        handler(profile.vocabulary->keys[slot], profile.slotCounts[slot]);
+    for (auto& entry : profile.trigrams)
+        handler(entry.first, entry.second.real);
+}
+
+/**
+ * @name getTextInvNorm
+ * @brief Returns the factor that turns the counts of a text profile into normalized values.
+ *
+ * @param profile The text profile
+ * @return 1 / L2 norm, 0 for an empty profile
+ */
+inline float getTextInvNorm(const textProfile_t& profile) {
+    return profile.sumSquares > 0.0f ? 1.0f / sqrtf(profile.sumSquares) : 0.0f;
+}
+
+// profileAggregates_t: constants of a language (or centroid) profile, computed once when the
+// model is indexed instead of on every comparison
+struct profileAggregates_t {
+    float realTotal = 0.0f;        // Sum of the counts (L1 norm)
+    float realSquares = 0.0f;      // Sum of the squared counts (squared L2 norm)
+    float normalizedTotal = 0.0f;  // Sum of the normalized values
+};
+
+// Minimum share of the inspected letters for a script to select its sub-model
+#define SCRIPT_INPUT_SHARE 0.5f
+// Minimum share of a profile's letters for the language to join a script sub-model
+#define SCRIPT_LANGUAGE_SHARE 0.05f
+
+// TrigramList: list of trigrams
+typedef std::list<std::string> TrigramList;
+
+struct LanguageProfile {
+    std::string languageCode;
+    TrigramProfile trigramProfile;
+    unsigned int scriptMask = 0;  // One bit per script_t with a noticeable share of the profile
+    profileAggregates_t aggregates;
+};
+
+typedef std::list<LanguageProfile> LanguageProfiles;
+
+// LanguageCandidates: languages to score a text against
+typedef std::vector<LanguageProfile*> LanguageCandidates;
+
+// trigramPosting_t: a language containing a trigram and its normalized frequency there
+struct trigramPosting_t {
+    unsigned int language;  // Index into scriptLanguages[SCRIPT_UNKNOWN]
+    float weight;
+    float logRatio;  // Naive Bayes: log(P(trigram | language) / P(unseen trigram))
+};
+
+// Share of the Naive Bayes probability mass spread evenly over every trigram of the model, so
+// a trigram a language lacks has the same probability in every language
+#define NAIVE_BAYES_SMOOTHING 0.1f
+
+// TrigramIndex: inverted index of trigram -> languages containing it
+typedef std::unordered_map<std::string, std::vector<trigramPosting_t>> TrigramIndex;
+
+// languageCluster_t: similar languages, scored first as a whole through their centroid
+struct languageCluster_t {
+    TrigramProfile centroid;            // Mean of the member profiles
+    profileAggregates_t centroidAggregates;
+    std::vector<unsigned int> members;  // Indexes into scriptLanguages[SCRIPT_UNKNOWN]
+};
+
+typedef std::vector<languageCluster_t> LanguageClusters;
+
+#define LANGUAGE_INDEX_SHARDS 16
+#define LANGUAGE_INDEX_IMPACTS 256  // Impact levels, 0 is never stored
+
+// languageIndexShard_t: the posting lists of the trigrams hashed to one shard
+struct languageIndexShard_t {
+    std::unordered_map<std::string, uint32_t> lists;  // Trigram -> posting list offset in data
+    std::vector<uint8_t> data;
+};
+
+// languageIndex_t: compressed inverted index of a set of language profiles
+struct languageIndex_t {
+    languageIndexShard_t shards[LANGUAGE_INDEX_SHARDS];
+    unsigned int languageCount = 0;
+    float impactWeights[LANGUAGE_INDEX_IMPACTS] = {};  // Weight of every impact
+    unsigned int minImpact = 1;  // Lower impacts were pruned to fit the memory budget
+    size_t postingCount = 0;
+};
+
+// languageScore_t: a language and its (approximate cosine) score
+struct languageScore_t {
+    unsigned int language;  // Index into the languages the index was built from
+    float score;
+};
+
+// Memory budget of LanguageModel::languageIndex; past it, the lowest impacts are pruned
+#define LANGUAGE_INDEX_BUDGET_BYTES (64 << 20)
+
+// LanguageModel: the loaded languages and the per-script sub-models built on them
+struct LanguageModel {
+    LanguageProfiles languages;
+    std::unordered_map<std::string, std::string> languageCodeNames;
+    // Candidates for a text written in each script (SCRIPT_UNKNOWN: every language)
+    LanguageCandidates scriptLanguages[SCRIPT_COUNT];
+    TrigramIndex trigramIndex;
+    bloomFilter_t trigramFilter;  // Every key of every language profile
+    perfectHash_t trigramHash;    // Vocabulary: a slot for every key of every language profile
+    std::vector<const std::vector<trigramPosting_t>*> slotPostings;  // Index entry of each slot
+    // Clusters of the candidates of each script (see LanguageClusters.h)
+    LanguageClusters scriptClusters[SCRIPT_COUNT];
+    // Compressed index of scriptLanguages[SCRIPT_UNKNOWN] (see LanguageIndex.h)
+    languageIndex_t languageIndex;
+    unsigned int generation = 0;  // Version of the model (see LanguageModelStore.h)
+
+    LanguageModel() {}
+    // scriptLanguages points into languages
+    LanguageModel(const LanguageModel&) = delete;
+    LanguageModel& operator=(const LanguageModel&) = delete;
+};
+
+// identificationProgress_t: lets another thread follow and cancel a running identification,
+// and bounds its latency. Past the deadline, reading stops and languages are no longer scored:
+// the best language so far is returned and partial is set
+struct identificationProgress_t {
+    std::atomic<size_t> bytesProcessed{0};
+    std::atomic<size_t> bytesTotal{0};
+    std::atomic<const std::string*> leader{nullptr};  // Best language code so far
+    std::atomic<size_t> profilesScored{0};            // Language and cluster profiles
+    std::atomic<bool> cancelRequested{false};
+    // Set before the identification starts (max: no deadline)
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    std::atomic<bool> partial{false};  // The deadline cut the identification short
+};
+
+// Input bytes, trigram lookups or postings processed between two reads of the clock
+#define DEADLINE_CHECK_OPERATIONS 4096
+// Most frequent text trigrams that order the languages when a deadline is set
+#define ANYTIME_ESTIMATE_TRIGRAMS 32
+
+// Functions
+TrigramProfile buildTrigramProfile(const Text& text);
+void normalizeTrigramProfile(TrigramProfile& trigramProfile);
+void aggregateTrigramProfile(const TrigramProfile& trigramProfile,
+                             profileAggregates_t& aggregates);
+void clearTextProfile(textProfile_t& profile);
+void setTextProfileVocabulary(textProfile_t& profile, const perfectHash_t* vocabulary);
+float getSimilarityScore(const textProfile_t& profile,
+                         const LanguageProfile& language,
+                         const settings_t& globalSettings);
+std::string identifyLanguage(const Text& text, LanguageProfiles& languages);
+
+std::string identifyLanguageFromPath(char* path,
+                                     LanguageModel& model,
+                                     settings_t& globalSettings,
+                                     identificationProgress_t* progress = nullptr);
+
+std::string identifyLanguageFromClipboard(std::string& clipboard,
+                                          LanguageModel& model,
+                                          settings_t& globalSettings,
+                                          identificationProgress_t* progress = nullptr);
+
+void setIdentificationBudget(identificationProgress_t& progress, unsigned int microseconds);
+
+void identifyLanguagesBatch(const std::vector<std::string>& texts,
+                            LanguageModel& model,
+                            settings_t& globalSettings,
+                            std::vector<std::string>& results);
+
+bool buildTextProfile(const std::string& text,
+                      textProfile_t& profile,
+                      const bloomFilter_t& filter,
+                      settings_t& globalSettings,
+                      identificationProgress_t* progress = nullptr);
+
+bool buildTextProfileParallel(const std::string& text,
+                              textProfile_t& profile,
+                              const bloomFilter_t& filter,
+                              const settings_t& globalSettings,
+                              identificationProgress_t* progress = nullptr);
+
+void indexLanguageModel(LanguageModel& model);
+
+bool readLanguageProfile(const std::string& trigramsPath,
+                         const std::string& languageCode,
+                         TrigramProfile& profile);
+
+bool loadLanguagesData(const std::string& languageCodeNamesPath,
+                       const std::string& trigramsPath,
+                       LanguageModel& model);
+
+void addToTrigramProfile(const std::string& text, TrigramProfile& profile);
+
+#endif
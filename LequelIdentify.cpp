@@ -0,0 +1,179 @@
+/**
+ * @brief Lequel? one-shot identification
+ *
+ * Identifies the language of each file given, or of the standard input, prints the language
+ * codes and exits:
+ *
+ *   lequel_identify texto.txt otro.txt.gz      (one "path<TAB>code" line per file)
+ *   echo "Bon dia a tothom" | lequel_identify  (one "code" line)
+ *
+ * lequel_identify reads its model from resources/. lequel_identify_embedded is built with
+ * LEQUEL_EMBEDDED_MODEL: its model is compiled in (see EmbeddedModel.h), so it only reads its
+ * input and starts without parsing any profile, for short-lived invocations.
+ * --timing reports how long loading the model took on the standard error.
+ * --segment splits each input into spans of one language (see Segmentation.h) and prints one
+ * "offset<TAB>length<TAB>code" line per span, after the path for files. Offsets and lengths
+ * are in bytes of the UTF-8 text.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "InputStream.h"
+#include "Lequel.h"
+#include "Segmentation.h"
+#include "UnicodeScript.h"
+
+#ifdef LEQUEL_EMBEDDED_MODEL
+#include "EmbeddedModel.h"
+#endif
+
+using namespace std;
+
+const string LANGUAGECODE_NAMES_FILE = "resources/languagecode_names_es.csv";
+const string TRIGRAMS_PATH = "resources/trigrams/";
+
+/**
+ * @name loadModel
+ * @brief Loads the compiled-in model, or the one in resources/ without its progress messages.
+ *
+ * @param model The language model to fill
+ * @return false if the model can't be loaded
+ */
+static bool loadModel(LanguageModel& model) {
+#ifdef LEQUEL_EMBEDDED_MODEL
+    return loadEmbeddedModel(EMBEDDED_MODEL, model);
+#else
+    streambuf* output = cout.rdbuf(nullptr);
+    bool isLoaded = loadLanguagesData(LANGUAGECODE_NAMES_FILE, TRIGRAMS_PATH, model);
+    cout.rdbuf(output);
+
+    return isLoaded;
+#endif
+}
+
+/**
+ * @name readInputText
+ * @brief Reads a whole file as UTF-8, decompressing and converting it as the identification
+ * does.
+ *
+ * @param path The file path
+ * @param model The language model (its vocabulary helps pick a code page)
+ * @param text The destination text
+ * @return false if the file can't be read
+ */
+static bool readInputText(const string& path, const LanguageModel& model, string& text) {
+    inputStream_t stream;
+    if (!openInputStream(path.c_str(), stream))
+        return false;
+
+    peekInputStream(stream, SCRIPT_DETECTION_BYTES, text);
+    setInputStreamEncoding(
+        stream, detectEncoding(text.data(), text.length(), &model.trigramFilter));
+
+    text.clear();
+    return readInputStream(stream, text);
+}
+
+/**
+ * @name printSpans
+ * @brief Segments a text by language and prints one "offset<TAB>length<TAB>code" line per span.
+ *
+ * @param prefix Printed before every line ("" or the path and a tab)
+ * @param text The UTF-8 text
+ * @param model The language model
+ */
+static void printSpans(const string& prefix, const string& text, LanguageModel& model) {
+    LanguageSpans spans;
+    segmentLanguages(text, model, segmentationSettings_t(), spans);
+
+    for (auto& span : spans) {
+        cout << prefix << span.begin << "\t" << span.end - span.begin << "\t"
+             << (span.languageCode ? *span.languageCode : "-") << "\n";
+    }
+    cout.flush();
+}
+
+int main(int argc, char* argv[]) {
+    bool timing = false;
+    bool segment = false;
+    vector<string> paths;
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+        if (argument == "--timing")
+            timing = true;
+        else if (argument == "--segment")
+            segment = true;
+        else if (argument.size() > 1 && argument[0] == '-') {
+            cerr << "Usage: " << argv[0] << " [--timing] [--segment] [FILE ...]\n"
+                 << "Identifies the language of each file, or of the standard input.\n"
+                 << "--segment prints the language of every span of one language." << endl;
+            return 1;
+        } else
+            paths.push_back(argument);
+    }
+
+    auto startTime = chrono::steady_clock::now();
+
+    LanguageModel model;
+    if (!loadModel(model)) {
+        cerr << "Could not load trigram data." << endl;
+        return 1;
+    }
+
+    if (timing) {
+        double milliseconds =
+            chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+        cerr << "Model loaded in " << milliseconds << " ms (" << model.languages.size()
+             << " languages)" << endl;
+    }
+
+    settings_t settings;
+    int status = 0;
+
+    if (paths.empty()) {
+        string text((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+        if (segment) {
+            size_t sampleLength = min(text.length(), (size_t)SCRIPT_DETECTION_BYTES);
+            encoding_t encoding = detectEncoding(text.data(), sampleLength, &model.trigramFilter);
+            if (encoding != ENCODING_UTF8) {
+                string converted;
+                transcodeText(text, encoding, converted);
+                text.swap(converted);
+            }
+
+            printSpans("", text, model);
+            return 0;
+        }
+
+        string languageCode = identifyLanguageFromClipboard(text, model, settings);
+        if (languageCode.empty())
+            return 1;
+
+        cout << languageCode << endl;
+        return 0;
+    }
+
+    for (auto& path : paths) {
+        if (segment) {
+            string text;
+            if (readInputText(path, model, text))
+                printSpans(path + "\t", text, model);
+            else
+                status = 1;
+            continue;
+        }
+
+        string languageCode = identifyLanguageFromPath(&path[0], model, settings);
+        if (languageCode.empty())
+            status = 1;
+
+        cout << path << "\t" << (languageCode.empty() ? "-" : languageCode) << endl;
+    }
+
+    return status;
+}
@@ -0,0 +1,924 @@
+/**
+ * @brief Lequel? headless identification server
+ *
+ * A single epoll event loop owns every socket. Complete requests are queued and picked up by
+ * worker threads in micro-batches (see identifyLanguagesBatch); results come back through a
+ * response queue and an eventfd that wakes the event loop, which writes them in order.
+ * Model reloads run on their own thread; the event loop only schedules them, after a short
+ * delay so a burst of file changes (build_profiles writing many profiles) reloads once.
+ *
+ * @cite https://man7.org/linux/man-pages/man7/epoll.7.html
+ * @cite https://man7.org/linux/man-pages/man7/inotify.7.html
+ */
+
+#include "LequelServer.h"
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "CommandLine.h"
+
+#define LISTEN_EVENT_ID 0
+#define WAKEUP_EVENT_ID 1
+#define WATCH_EVENT_ID 2
+#define FIRST_CONNECTION_ID 3
+#define MAX_EVENTS 64
+#define READ_CHUNK_SIZE 65536
+#define FRAME_HEADER_SIZE 4
+#define RELOAD_DELAY_MS 500  // Quiet time after a file change before reloading
+#define PARTIAL_RESULT_MARK '?'  // Appended to the language code of a result cut short
+
+using namespace std;
+
+const string LANGUAGECODE_NAMES_FILE = "resources/languagecode_names_es.csv";
+const string TRIGRAMS_PATH = "resources/trigrams/";
+const string CODE_NAMES_FILE = "resources/code/languagecode_names_es.csv";
+const string CODE_PROFILES_PATH = "resources/code/";
+
+// request_t: a complete request waiting for a worker
+struct request_t {
+    uint64_t connectionId;
+    uint64_t sequence;
+    string text;
+    chrono::steady_clock::time_point arrival;  // When the request was read
+};
+
+// response_t: a finished request waiting for the event loop
+struct response_t {
+    uint64_t connectionId;
+    uint64_t sequence;
+    string languageCode;
+};
+
+// connection_t: per-client buffers, owned by the event loop thread
+struct connection_t {
+    int fd;
+    uint32_t events = 0;  // Current epoll interest
+    string input;
+    string output;
+    uint64_t nextSequence = 0;    // Sequence of the next request read
+    uint64_t nextToSend = 0;      // Sequence of the next response to write
+    map<uint64_t, string> ready;  // Responses that finished out of order
+    bool readClosed = false;
+};
+
+// workQueue_t: shared state between the event loop and the workers
+struct workQueue_t {
+    mutex requestLock;
+    condition_variable requestAvailable;
+    deque<request_t> requests;
+    bool stopping = false;
+
+    mutex responseLock;
+    vector<response_t> responses;
+    int wakeupFd = -1;
+};
+
+// reloadQueue_t: hands reload requests from the event loop to the reload thread
+struct reloadQueue_t {
+    mutex lock;
+    condition_variable requested;
+    bool pending = false;
+    bool stopping = false;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+static volatile sig_atomic_t reloadRequested = 0;
+
+static void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+static void onReloadSignal(int) {
+    reloadRequested = 1;
+}
+
+/**
+ * @name appendFrame
+ * @brief Appends a length-prefixed frame to a buffer.
+ *
+ * @param buffer The destination buffer
+ * @param payload The frame contents
+ */
+static void appendFrame(string& buffer, const string& payload) {
+    uint32_t length = (uint32_t)payload.size();
+
+    buffer += (char)(length >> 24);
+    buffer += (char)(length >> 16);
+    buffer += (char)(length >> 8);
+    buffer += (char)length;
+    buffer += payload;
+}
+
+/**
+ * @name readFrameLength
+ * @brief Decodes the big-endian length of a frame header.
+ *
+ * @param data Pointer to the first header byte
+ * @return The payload length
+ */
+static uint32_t readFrameLength(const char* data) {
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) |
+           (uint32_t)bytes[3];
+}
+
+/**
+ * @name identifyByDeadline
+ * @brief Identifies requests one by one, each bounded by its own deadline (see
+ * identificationProgress_t). Results cut short are marked and not cached.
+ *
+ * @param texts The request texts
+ * @param arrivals When each request was read
+ * @param model The language model
+ * @param cache Results of previous requests
+ * @param globalSettings The identification settings
+ * @param deadlineMs Time budget of a request from its arrival
+ * @param results The destination language codes, one per text
+ */
+static void identifyByDeadline(vector<string>& texts,
+                               const vector<chrono::steady_clock::time_point>& arrivals,
+                               LanguageModel& model,
+                               resultCache_t& cache,
+                               settings_t& globalSettings,
+                               unsigned int deadlineMs,
+                               vector<string>& results) {
+    results.resize(texts.size());
+
+    for (size_t i = 0; i < texts.size(); i++) {
+        resultCacheKey_t key{};
+        if (cache.shardCapacity) {
+            key = getResultCacheKey(texts[i], globalSettings, model);
+            if (lookupResultCache(cache, key, results[i]))
+                continue;
+        }
+
+        results[i].clear();
+        if (texts[i].empty())
+            continue;
+
+        identificationProgress_t progress;
+        progress.deadline = arrivals[i] + chrono::milliseconds(deadlineMs);
+        results[i] = identifyLanguageFromClipboard(texts[i], model, globalSettings, &progress);
+
+        if (progress.partial.load(memory_order_relaxed))
+            results[i] += PARTIAL_RESULT_MARK;
+        else
+            storeResultCache(cache, key, results[i]);
+    }
+}
+
+/**
+ * @name runWorker
+ * @brief Worker thread: takes up to maxBatchSize queued requests at a time and identifies them
+ * together, or one by one when requests have a deadline (a batch only finishes as a whole).
+ *
+ * @param queue The shared work queue
+ * @param store The language model store (each batch uses the model current when it starts)
+ * @param cache Results of previous requests, only the misses are identified
+ * @param globalSettings A private copy of the identification settings
+ * @param maxBatchSize Maximum number of requests scored together
+ * @param deadlineMs Time budget of a request from its arrival, 0: no deadline
+ */
+static void runWorker(workQueue_t& queue,
+                      languageModelStore_t& store,
+                      resultCache_t& cache,
+                      settings_t globalSettings,
+                      unsigned int maxBatchSize,
+                      unsigned int deadlineMs) {
+    vector<uint64_t> connectionIds;
+    vector<uint64_t> sequences;
+    vector<string> texts;
+    vector<chrono::steady_clock::time_point> arrivals;
+    vector<string> results;
+    vector<resultCacheKey_t> keys;
+    vector<size_t> missIndexes;
+    vector<string> missTexts;
+    vector<string> missResults;
+
+    while (true) {
+        connectionIds.clear();
+        sequences.clear();
+        texts.clear();
+        arrivals.clear();
+
+        {
+            unique_lock<mutex> guard(queue.requestLock);
+            queue.requestAvailable.wait(
+                guard, [&queue] { return queue.stopping || !queue.requests.empty(); });
+
+            if (queue.stopping)
+                return;
+
+            while (!queue.requests.empty() && texts.size() < maxBatchSize) {
+                request_t& request = queue.requests.front();
+                connectionIds.push_back(request.connectionId);
+                sequences.push_back(request.sequence);
+                texts.push_back(std::move(request.text));
+                arrivals.push_back(request.arrival);
+                queue.requests.pop_front();
+            }
+        }
+
+        shared_ptr<LanguageModel> model = acquireLanguageModel(store);
+
+        if (deadlineMs)
+            identifyByDeadline(
+                texts, arrivals, *model, cache, globalSettings, deadlineMs, results);
+        else if (cache.shardCapacity) {
+            results.resize(texts.size());
+            keys.resize(texts.size());
+            missIndexes.clear();
+            missTexts.clear();
+
+            for (size_t i = 0; i < texts.size(); i++) {
+                keys[i] = getResultCacheKey(texts[i], globalSettings, *model);
+                if (!lookupResultCache(cache, keys[i], results[i])) {
+                    missIndexes.push_back(i);
+                    missTexts.push_back(std::move(texts[i]));
+                }
+            }
+
+            if (!missTexts.empty())
+                identifyLanguagesBatch(missTexts, *model, globalSettings, missResults);
+
+            for (size_t i = 0; i < missIndexes.size(); i++) {
+                storeResultCache(cache, keys[missIndexes[i]], missResults[i]);
+                results[missIndexes[i]] = std::move(missResults[i]);
+            }
+        } else
+            identifyLanguagesBatch(texts, *model, globalSettings, results);
+
+        {
+            lock_guard<mutex> guard(queue.responseLock);
+            for (size_t i = 0; i < texts.size(); i++)
+                queue.responses.push_back({connectionIds[i], sequences[i], std::move(results[i])});
+        }
+
+        uint64_t one = 1;
+        if (write(queue.wakeupFd, &one, sizeof(one)) < 0)
+            perror("Error while waking up the event loop");
+
+        // Only now can a reload free the model the batch was identified with
+        model.reset();
+    }
+}
+
+/**
+ * @name runReloader
+ * @brief Reload thread: reloads the model every time the event loop asks for it.
+ *
+ * @param reloads The reload queue
+ * @param store The language model store
+ */
+static void runReloader(reloadQueue_t& reloads, languageModelStore_t& store) {
+    while (true) {
+        {
+            unique_lock<mutex> guard(reloads.lock);
+            reloads.requested.wait(
+                guard, [&reloads] { return reloads.stopping || reloads.pending; });
+
+            if (reloads.stopping)
+                return;
+            reloads.pending = false;
+        }
+
+        if (reloadLanguageModel(store))
+            cout << "Language model reloaded (generation " << store.generation << ", "
+                 << acquireLanguageModel(store)->languages.size() << " languages)" << endl;
+        else
+            cerr << "Error: could not reload the language model, keeping the previous one"
+                 << endl;
+    }
+}
+
+/**
+ * @name getParentPath
+ * @brief Returns the folder of a file path.
+ *
+ * @param path The file path
+ * @return The folder, "." if path has none
+ */
+static string getParentPath(const string& path) {
+    size_t separator = path.rfind('/');
+
+    return separator == string::npos ? "." : path.substr(0, separator + 1);
+}
+
+/**
+ * @name openWatch
+ * @brief Watches the trigram folder and the language code names file for changes.
+ *
+ * @param store The language model store
+ * @param namesWatch Destination for the watch descriptor of the names file folder
+ * @return The non-blocking inotify descriptor, -1 on failure
+ */
+static int openWatch(const languageModelStore_t& store, int& namesWatch) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        perror("Error while watching the model files");
+        return -1;
+    }
+
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE;
+    namesWatch = inotify_add_watch(fd, getParentPath(store.languageCodeNamesPath).c_str(), mask);
+    if (namesWatch < 0 || inotify_add_watch(fd, store.trigramsPath.c_str(), mask) < 0) {
+        perror("Error while watching the model files");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @name readWatch
+ * @brief Drains the inotify descriptor.
+ *
+ * @param watchFd The inotify descriptor
+ * @param namesWatch Watch descriptor of the names file folder
+ * @param namesFile File name of the language code names file
+ * @return true if a model file changed
+ */
+static bool readWatch(int watchFd, int namesWatch, const string& namesFile) {
+    alignas(inotify_event) char buffer[4096];
+    bool changed = false;
+    ssize_t count;
+
+    while ((count = read(watchFd, buffer, sizeof(buffer))) > 0) {
+        for (char* position = buffer; position < buffer + count;) {
+            inotify_event* watchEvent = (inotify_event*)position;
+
+            // The names file folder holds other files too
+            if (watchEvent->wd != namesWatch ||
+                (watchEvent->len && namesFile == watchEvent->name))
+                changed = true;
+
+            position += sizeof(inotify_event) + watchEvent->len;
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * @name openListenSocket
+ * @brief Creates the non-blocking listening socket.
+ *
+ * @param serverSettings The struct containing all the server settings
+ * @return The socket descriptor, -1 on failure
+ */
+static int openListenSocket(const serverSettings_t& serverSettings) {
+    int fd;
+
+    if (!serverSettings.socketPath.empty()) {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+
+        if (serverSettings.socketPath.size() >= sizeof(address.sun_path)) {
+            cerr << "Error: socket path too long" << endl;
+            return -1;
+        }
+        strcpy(address.sun_path, serverSettings.socketPath.c_str());
+
+        if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+            perror("Error while creating socket");
+            return -1;
+        }
+
+        // Removes a stale socket left by a previous run
+        unlink(serverSettings.socketPath.c_str());
+
+        if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+            perror(("Error while binding " + serverSettings.socketPath).c_str());
+            close(fd);
+            return -1;
+        }
+    } else {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(serverSettings.tcpPort);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+            perror("Error while creating socket");
+            return -1;
+        }
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+            perror("Error while binding localhost port");
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (listen(fd, SOMAXCONN) < 0) {
+        perror("Error while listening");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @name updateInterest
+ * @brief Registers for reads while the client may still send requests and the request queue
+ * has room, and for writes while there is pending output. Hang-ups are always reported.
+ *
+ * @param epollFd The epoll instance
+ * @param id The connection id
+ * @param connection The connection
+ * @param readsPaused The request queue is full
+ */
+static void updateInterest(int epollFd,
+                           uint64_t id,
+                           connection_t& connection,
+                           bool readsPaused) {
+    uint32_t events = 0;
+    if (!connection.readClosed && !readsPaused)
+        events |= EPOLLIN;
+    if (!connection.output.empty())
+        events |= EPOLLOUT;
+    if (events == connection.events)
+        return;
+
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = id;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+/**
+ * @name readConnection
+ * @brief Reads everything available and extracts complete request frames.
+ *
+ * @param id The connection id
+ * @param connection The connection
+ * @param serverSettings The struct containing all the server settings
+ * @param requests Destination for the complete requests
+ * @return false if the connection must be closed
+ */
+static bool readConnection(uint64_t id,
+                           connection_t& connection,
+                           const serverSettings_t& serverSettings,
+                           vector<request_t>& requests) {
+    char buffer[READ_CHUNK_SIZE];
+
+    while (true) {
+        ssize_t count = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (count > 0)
+            connection.input.append(buffer, count);
+        else if (count == 0) {
+            connection.readClosed = true;
+            break;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        else if (errno != EINTR)
+            return false;
+    }
+
+    auto arrival = chrono::steady_clock::now();
+    size_t offset = 0;
+    while (connection.input.size() - offset >= FRAME_HEADER_SIZE) {
+        uint32_t length = readFrameLength(&connection.input[offset]);
+        if (length > serverSettings.maxRequestSize)
+            return false;
+        if (connection.input.size() - offset - FRAME_HEADER_SIZE < length)
+            break;
+
+        requests.push_back({id,
+                            connection.nextSequence++,
+                            connection.input.substr(offset + FRAME_HEADER_SIZE, length),
+                            arrival});
+        offset += FRAME_HEADER_SIZE + length;
+    }
+    connection.input.erase(0, offset);
+
+    return true;
+}
+
+/**
+ * @name flushConnection
+ * @brief Writes as much pending output as the socket accepts.
+ *
+ * @param connection The connection
+ * @return false if the connection must be closed
+ */
+static bool flushConnection(connection_t& connection) {
+    size_t offset = 0;
+
+    while (offset < connection.output.size()) {
+        ssize_t count = send(connection.fd,
+                             connection.output.data() + offset,
+                             connection.output.size() - offset,
+                             MSG_NOSIGNAL);
+        if (count > 0)
+            offset += count;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        else if (errno != EINTR)
+            return false;
+    }
+    connection.output.erase(0, offset);
+
+    return true;
+}
+
+/**
+ * @name runServer
+ * @brief Serves identification requests until SIGINT or SIGTERM. Reloads the model on
+ * SIGHUP and, if serverSettings.watchFiles is set, when its files change.
+ *
+ * @param serverSettings The struct containing all the server settings
+ * @param store The language model store (already loaded)
+ * @param globalSettings The identification settings (copied by every worker)
+ * @return true Clean shutdown
+ * @return false Could not start
+ */
+bool runServer(const serverSettings_t& serverSettings,
+               languageModelStore_t& store,
+               const settings_t& globalSettings) {
+    int listenFd = openListenSocket(serverSettings);
+    if (listenFd < 0)
+        return false;
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    workQueue_t queue;
+    queue.wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || queue.wakeupFd < 0) {
+        perror("Error while creating the event loop");
+        close(listenFd);
+        return false;
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = LISTEN_EVENT_ID;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.u64 = WAKEUP_EVENT_ID;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, queue.wakeupFd, &event);
+
+    int namesWatch = -1;
+    int watchFd = serverSettings.watchFiles ? openWatch(store, namesWatch) : -1;
+    string namesFile = store.languageCodeNamesPath.substr(
+        store.languageCodeNamesPath.rfind('/') + 1);  // npos + 1 == 0
+    if (watchFd >= 0) {
+        event.data.u64 = WATCH_EVENT_ID;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, watchFd, &event);
+    }
+
+    // Interrupts epoll_wait() instead of restarting it
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onStopSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    action.sa_handler = onReloadSignal;
+    sigaction(SIGHUP, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Threads inherit the signal mask: blocking the signals meanwhile makes sure they reach
+    // the event loop thread and interrupt epoll_wait()
+    sigset_t signals;
+    sigset_t previousSignals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, &previousSignals);
+
+    resultCache_t cache;
+    initResultCache(cache, serverSettings.cacheSize);
+
+    vector<thread> workers;
+    for (unsigned int i = 0; i < serverSettings.workerCount; i++)
+        workers.push_back(thread(runWorker,
+                                 std::ref(queue),
+                                 std::ref(store),
+                                 std::ref(cache),
+                                 globalSettings,
+                                 serverSettings.maxBatchSize,
+                                 serverSettings.deadlineMs));
+
+    reloadQueue_t reloads;
+    thread reloader(runReloader, std::ref(reloads), std::ref(store));
+    pthread_sigmask(SIG_SETMASK, &previousSignals, nullptr);
+
+    bool reloadScheduled = false;
+    chrono::steady_clock::time_point reloadTime;
+
+    cout << "Listening on "
+         << (serverSettings.socketPath.empty()
+                 ? "127.0.0.1:" + to_string(serverSettings.tcpPort)
+                 : serverSettings.socketPath)
+         << " with " << serverSettings.workerCount << " workers..." << endl;
+
+    unordered_map<uint64_t, connection_t> connections;
+    uint64_t nextConnectionId = FIRST_CONNECTION_ID;
+    epoll_event events[MAX_EVENTS];
+    vector<request_t> requests;
+    vector<response_t> responses;
+    vector<uint64_t> touched;
+    bool readsPaused = false;
+
+    while (!stopRequested) {
+        if (reloadRequested) {
+            reloadRequested = 0;
+            reloadScheduled = true;
+            reloadTime = chrono::steady_clock::now();
+        }
+
+        int timeout = -1;
+        if (reloadScheduled) {
+            auto now = chrono::steady_clock::now();
+            if (now >= reloadTime) {
+                {
+                    lock_guard<mutex> guard(reloads.lock);
+                    reloads.pending = true;
+                }
+                reloads.requested.notify_one();
+                reloadScheduled = false;
+            } else
+                timeout = (int)chrono::duration_cast<chrono::milliseconds>(reloadTime - now)
+                              .count() + 1;
+        }
+
+        int eventCount = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+        if (eventCount < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("Error while waiting for events");
+            break;
+        }
+
+        touched.clear();
+
+        for (int i = 0; i < eventCount; i++) {
+            uint64_t id = events[i].data.u64;
+
+            if (id == LISTEN_EVENT_ID) {
+                int fd;
+                while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >=
+                       0) {
+                    uint64_t connectionId = nextConnectionId++;
+                    connection_t& connection = connections[connectionId];
+                    connection.fd = fd;
+                    if (!readsPaused)
+                        connection.events = EPOLLIN;
+
+                    event.events = connection.events;
+                    event.data.u64 = connectionId;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+                }
+            } else if (id == WATCH_EVENT_ID) {
+                if (readWatch(watchFd, namesWatch, namesFile)) {
+                    // Waits for the files to settle
+                    reloadScheduled = true;
+                    reloadTime = chrono::steady_clock::now() +
+                                 chrono::milliseconds(RELOAD_DELAY_MS);
+                }
+            } else if (id == WAKEUP_EVENT_ID) {
+                uint64_t counter;
+                if (read(queue.wakeupFd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+                    perror("Error while reading wakeup counter");
+
+                {
+                    lock_guard<mutex> guard(queue.responseLock);
+                    responses.swap(queue.responses);
+                }
+
+                // Responses are released strictly in request order
+                for (auto& response : responses) {
+                    auto connectionIterator = connections.find(response.connectionId);
+                    if (connectionIterator == connections.end())
+                        continue;  // Client left before the result was ready
+
+                    connection_t& connection = connectionIterator->second;
+                    connection.ready[response.sequence] = std::move(response.languageCode);
+
+                    auto readyIterator = connection.ready.begin();
+                    while (readyIterator != connection.ready.end() &&
+                           readyIterator->first == connection.nextToSend) {
+                        appendFrame(connection.output, readyIterator->second);
+                        readyIterator = connection.ready.erase(readyIterator);
+                        connection.nextToSend++;
+                    }
+                    touched.push_back(response.connectionId);
+                }
+                responses.clear();
+            } else {
+                auto connectionIterator = connections.find(id);
+                if (connectionIterator == connections.end())
+                    continue;
+
+                // A client that hung up can't take its responses; EPOLLHUP is reported
+                // whatever the interest, so the connection would wake the loop forever
+                connection_t& connection = connectionIterator->second;
+                bool keep = !(events[i].events & (EPOLLERR | EPOLLHUP));
+                if (keep && (events[i].events & EPOLLIN))
+                    keep = readConnection(id, connection, serverSettings, requests);
+
+                if (!keep) {
+                    close(connection.fd);
+                    connections.erase(connectionIterator);
+                    continue;
+                }
+                touched.push_back(id);
+            }
+        }
+
+        // Hands every request read in this iteration to the workers at once, so they can be
+        // coalesced into batches
+        size_t queuedCount;
+        {
+            lock_guard<mutex> guard(queue.requestLock);
+            for (auto& request : requests)
+                queue.requests.push_back(std::move(request));
+            queuedCount = queue.requests.size();
+        }
+        if (!requests.empty()) {
+            queue.requestAvailable.notify_all();
+            requests.clear();
+        }
+
+        // Stops reading while the queue is full; workers wake the loop as they empty it
+        if ((queuedCount >= serverSettings.maxQueuedRequests) != readsPaused) {
+            readsPaused = !readsPaused;
+            for (auto& entry : connections)
+                updateInterest(epollFd, entry.first, entry.second, readsPaused);
+        }
+
+        for (uint64_t id : touched) {
+            auto connectionIterator = connections.find(id);
+            if (connectionIterator == connections.end())
+                continue;
+
+            connection_t& connection = connectionIterator->second;
+            bool finished = connection.readClosed &&
+                            connection.nextToSend == connection.nextSequence;
+
+            if (!flushConnection(connection) || (finished && connection.output.empty())) {
+                close(connection.fd);
+                connections.erase(connectionIterator);
+                continue;
+            }
+            updateInterest(epollFd, id, connection, readsPaused);
+        }
+    }
+
+    cout << "Shutting down..." << endl;
+
+    {
+        lock_guard<mutex> guard(queue.requestLock);
+        queue.stopping = true;
+    }
+    queue.requestAvailable.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+
+    {
+        lock_guard<mutex> guard(reloads.lock);
+        reloads.stopping = true;
+    }
+    reloads.requested.notify_all();
+    reloader.join();
+    if (watchFd >= 0)
+        close(watchFd);
+
+    if (cache.shardCapacity)
+        cout << "Result cache: " << cache.hits << " hits, " << cache.misses << " misses" << endl;
+
+    for (auto& entry : connections)
+        close(entry.second.fd);
+    close(queue.wakeupFd);
+    close(epollFd);
+    close(listenFd);
+    if (!serverSettings.socketPath.empty())
+        unlink(serverSettings.socketPath.c_str());
+
+    return true;
+}
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --unix PATH          listen on a Unix domain socket\n"
+         << "  --tcp PORT           listen on 127.0.0.1:PORT (default 7070)\n"
+         << "  --workers N          worker threads (default 4)\n"
+         << "  --batch N            maximum requests per batch (default 32)\n"
+         << "  --queue N            stop reading while N requests wait (default 1024)\n"
+         << "  --cache N            cache the results of the last N distinct requests\n"
+         << "  --algorithm NAME     cosine, jaccard, cavnartrenkle or bayes (default cosine)\n"
+         << "  --lines N            line limit per request (default 100)\n"
+         << "  --trigrams N         trigram limit per request (default 100)\n"
+         << "  --real               score real frequencies instead of normalized ones\n"
+         << "  --clusters N         only score the languages of the N best clusters\n"
+         << "  --index N            only score the N best languages of the language index\n"
+         << "  --deadline-ms N      answer every request within N ms of its arrival, with\n"
+         << "                       the best language so far followed by '?' if cut short\n"
+         << "  --code               identify C, C++ and Python instead of natural languages\n"
+         << "  --no-watch           only reload the model on SIGHUP, not on file changes\n";
+}
+
+int main(int argc, char* argv[]) {
+    serverSettings_t serverSettings;
+    settings_t globalSettings;
+
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : "";
+        unsigned int number = 0;
+        bool valid = true;
+
+        if (option == "--unix" && *value)
+            serverSettings.socketPath = value;
+        else if (option == "--tcp" && (valid = parseUnsigned(value, number) && number <= 0xffff))
+            serverSettings.tcpPort = (unsigned short)number;
+        else if (option == "--workers" && (valid = parseUnsigned(value, number)))
+            serverSettings.workerCount = number;
+        else if (option == "--batch" && (valid = parseUnsigned(value, number)))
+            serverSettings.maxBatchSize = number;
+        else if (option == "--queue" && (valid = parseUnsigned(value, number)))
+            serverSettings.maxQueuedRequests = number;
+        else if (option == "--cache" && (valid = parseUnsigned(value, number)))
+            serverSettings.cacheSize = number;
+        else if (option == "--deadline-ms" && (valid = parseUnsigned(value, number)))
+            serverSettings.deadlineMs = number;
+        else if (option == "--lines" && (valid = parseUnsigned(value, number)))
+            globalSettings.lineLimit = number;
+        else if (option == "--trigrams" && (valid = parseUnsigned(value, number)))
+            globalSettings.trigramLimit = number;
+        else if (option == "--clusters" && (valid = parseUnsigned(value, number)))
+            globalSettings.clusterBeam = number;
+        else if (option == "--index" && (valid = parseUnsigned(value, number)))
+            globalSettings.indexCandidates = number;
+        else if (option == "--real") {
+            globalSettings.valueProcessingSetting = VALUE_REAL;
+            continue;  // No option value
+        }
+        else if (option == "--code") {
+            globalSettings.featureSetting = FEATURES_CODE;
+            continue;
+        } else if (option == "--no-watch") {
+            serverSettings.watchFiles = false;
+            continue;
+        }
+        else if (option == "--algorithm" && !strcmp(value, "cosine"))
+            globalSettings.algorithmSetting = ALGORITHM_COSINE;
+        else if (option == "--algorithm" && !strcmp(value, "jaccard"))
+            globalSettings.algorithmSetting = ALGORITHM_JACCARD;
+        else if (option == "--algorithm" && !strcmp(value, "cavnartrenkle"))
+            globalSettings.algorithmSetting = ALGORITHM_CAVNARTRENKLE;
+        else if (option == "--algorithm" && !strcmp(value, "bayes"))
+            globalSettings.algorithmSetting = ALGORITHM_NAIVE_BAYES;
+        else
+            valid = false;
+
+        if (!valid) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        i++;  // Skips the option value
+    }
+
+    languageModelStore_t store;
+
+    bool code = globalSettings.featureSetting == FEATURES_CODE;
+    if (!initLanguageModelStore(store,
+                                code ? CODE_NAMES_FILE : LANGUAGECODE_NAMES_FILE,
+                                code ? CODE_PROFILES_PATH : TRIGRAMS_PATH)) {
+        cout << "Could not load trigram data." << endl;
+        return 1;
+    }
+
+    return runServer(serverSettings, store, globalSettings) ? 0 : 1;
+}
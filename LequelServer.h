@@ -0,0 +1,45 @@
+/**
+ * @brief Lequel? headless identification server
+ *
+ * Serves identification requests over a Unix domain socket or a localhost TCP port, so the
+ * language profiles are loaded once instead of once per document.
+ *
+ * Protocol (every integer is a 32-bit big-endian unsigned value):
+ *   request:  <length> <length bytes of UTF-8 text>
+ *   response: <length> <length bytes of language code> (empty code: no language matched)
+ * Requests can be pipelined; responses on a connection are sent in request order. While too
+ * many requests wait for a worker, the server stops reading from every connection. A client
+ * that hangs up is disconnected at once, dropping its pending responses.
+ * With a deadline, a request still running when its budget (counted from its arrival) runs
+ * out is answered with the best language so far followed by '?'.
+ *
+ * The language model is reloaded without a restart on SIGHUP or when the profile files
+ * change; requests in flight finish with the model they started with.
+ */
+
+#ifndef LEQUELSERVER_H
+#define LEQUELSERVER_H
+
+#include <string>
+
+#include "LanguageModelStore.h"
+#include "ResultCache.h"
+
+// serverSettings_t: determines how the server listens and schedules work
+struct serverSettings_t {
+    std::string socketPath;         // Unix domain socket path (used when not empty)
+    unsigned short tcpPort = 7070;  // localhost TCP port (used when socketPath is empty)
+    unsigned int workerCount = 4;
+    unsigned int maxBatchSize = 32;               // requests scored together by a worker
+    unsigned int maxQueuedRequests = 1024;  // waiting requests past which reads pause
+    unsigned int maxRequestSize = 16 * 1024 * 1024;  // bytes, larger requests close the connection
+    bool watchFiles = true;  // Reloads the model when its files change
+    unsigned int cacheSize = 0;  // Results kept for repeated requests, 0: no cache
+    unsigned int deadlineMs = 0;  // Time budget of a request from its arrival, 0: no deadline
+};
+
+bool runServer(const serverSettings_t& serverSettings,
+               languageModelStore_t& store,
+               const settings_t& globalSettings);
+
+#endif
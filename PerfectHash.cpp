@@ -0,0 +1,145 @@
+/**
+ * @brief Lequel? minimal perfect hash of the model vocabulary
+ *
+ * @cite https://arxiv.org/abs/2104.10402
+ * PTHash: pilot search and the remap of spare slots
+ */
+
+#include "PerfectHash.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * @name placeBuckets
+ * @brief Searches the pilot of every bucket, largest buckets first.
+ *
+ * @param hashes The hash of every key
+ * @param perfectHash The perfect hash (seed, bucketCount and tableSize set; pilots filled in)
+ * @param slotKeys The destination key of every table slot (PERFECT_HASH_MISSING: free)
+ * @return false if some bucket could not be placed with any pilot
+ */
+static bool placeBuckets(const vector<uint64_t>& hashes,
+                         perfectHash_t& perfectHash,
+                         vector<uint32_t>& slotKeys) {
+    uint32_t bucketCount = perfectHash.bucketCount;
+
+    // Keys grouped by bucket (counting sort)
+    vector<uint32_t> bucketStarts(bucketCount + 1, 0);
+    for (uint64_t hash : hashes)
+        bucketStarts[(uint32_t)((hash >> 32) * bucketCount >> 32) + 1]++;
+    for (uint32_t bucket = 0; bucket < bucketCount; bucket++)
+        bucketStarts[bucket + 1] += bucketStarts[bucket];
+
+    vector<uint32_t> bucketKeys(hashes.size());
+    vector<uint32_t> fill(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (uint32_t key = 0; key < hashes.size(); key++)
+        bucketKeys[fill[(uint32_t)((hashes[key] >> 32) * bucketCount >> 32)]++] = key;
+
+    vector<uint32_t> order(bucketCount);
+    for (uint32_t bucket = 0; bucket < bucketCount; bucket++)
+        order[bucket] = bucket;
+    stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return bucketStarts[a + 1] - bucketStarts[a] > bucketStarts[b + 1] - bucketStarts[b];
+    });
+
+    perfectHash.pilots.assign(bucketCount, 0);
+    slotKeys.assign(perfectHash.tableSize, PERFECT_HASH_MISSING);
+    vector<uint32_t> positions;
+
+    for (uint32_t bucket : order) {
+        uint32_t first = bucketStarts[bucket];
+        uint32_t last = bucketStarts[bucket + 1];
+        if (first == last)
+            break;  // Only empty buckets are left
+
+        bool placed = false;
+        for (uint32_t pilot = 0; pilot <= 0xFFFF && !placed; pilot++) {
+            positions.clear();
+            placed = true;
+
+            for (uint32_t i = first; i < last && placed; i++) {
+                uint32_t position = getPerfectHashPosition(
+                    hashes[bucketKeys[i]], (uint16_t)pilot, perfectHash.tableSize);
+                placed = slotKeys[position] == PERFECT_HASH_MISSING &&
+                         find(positions.begin(), positions.end(), position) == positions.end();
+                positions.push_back(position);
+            }
+
+            if (placed) {
+                perfectHash.pilots[bucket] = (uint16_t)pilot;
+                for (uint32_t i = first; i < last; i++)
+                    slotKeys[positions[i - first]] = bucketKeys[i];
+            }
+        }
+
+        if (!placed)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @name buildPerfectHash
+ * @brief Builds the minimal perfect hash of a set of keys.
+ *
+ * @param keys The keys (distinct)
+ * @param perfectHash The destination perfect hash
+ * @return false if no seed placed every key (the perfect hash is left empty)
+ */
+bool buildPerfectHash(const vector<string>& keys, perfectHash_t& perfectHash) {
+    perfectHash = perfectHash_t();
+    if (keys.empty())
+        return true;
+
+    uint32_t keyCount = (uint32_t)keys.size();
+    vector<uint64_t> hashes(keyCount);
+    vector<uint32_t> slotKeys;
+
+    perfectHash.bucketCount = max(1u, keyCount / PERFECT_HASH_BUCKET_KEYS);
+    perfectHash.tableSize = max(keyCount, (uint32_t)(keyCount / PERFECT_HASH_LOAD) + 1);
+
+    bool placed = false;
+    for (unsigned int attempt = 0; attempt < PERFECT_HASH_ATTEMPTS && !placed; attempt++) {
+        perfectHash.seed = 0x9E3779B97F4A7C15ULL * (attempt + 1);
+        for (uint32_t key = 0; key < keyCount; key++)
+            hashes[key] = hashPerfectHashKey(keys[key], perfectHash.seed);
+
+        placed = placeBuckets(hashes, perfectHash, slotKeys);
+    }
+
+    if (!placed) {
+        perfectHash = perfectHash_t();
+        return false;
+    }
+
+    // Keys on spare slots move to the free slots below keyCount
+    vector<uint32_t> freeSlots;
+    for (uint32_t slot = 0; slot < keyCount; slot++) {
+        if (slotKeys[slot] == PERFECT_HASH_MISSING)
+            freeSlots.push_back(slot);
+    }
+
+    // Unused spare slots point anywhere: the fingerprint rejects whatever lands there
+    perfectHash.remap.assign(perfectHash.tableSize - keyCount, 0);
+    size_t nextFree = 0;
+    for (uint32_t slot = keyCount; slot < perfectHash.tableSize; slot++) {
+        if (slotKeys[slot] == PERFECT_HASH_MISSING)
+            continue;
+
+        uint32_t target = freeSlots[nextFree++];
+        perfectHash.remap[slot - keyCount] = target;
+        slotKeys[target] = slotKeys[slot];
+    }
+
+    perfectHash.fingerprints.resize(keyCount);
+    perfectHash.keys.resize(keyCount);
+    for (uint32_t slot = 0; slot < keyCount; slot++) {
+        perfectHash.fingerprints[slot] = (uint32_t)hashes[slotKeys[slot]];
+        perfectHash.keys[slot] = keys[slotKeys[slot]];
+    }
+
+    return true;
+}
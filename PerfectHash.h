@@ -0,0 +1,113 @@
+/**
+ * @brief Lequel? minimal perfect hash of the model vocabulary
+ *
+ * Maps each of the n keys of every language profile to its own slot in [0, n), so a text
+ * profile can count trigrams in a dense array instead of a hash table. Keys are split into
+ * buckets of about PERFECT_HASH_BUCKET_KEYS keys; buckets are placed largest first, each
+ * trying pilot values until all of its keys land on free slots. The table has a few spare
+ * slots so the last buckets are placed quickly, and keys landing on a spare slot are sent to
+ * the free slots below n through a small remap array. Every slot keeps a 32-bit fingerprint
+ * of its key, so keys outside the vocabulary are rejected (a false match has a 2^-32 chance).
+ *
+ * @cite https://arxiv.org/abs/2104.10402
+ * PTHash: pilot search and the remap of spare slots
+ */
+
+#ifndef PERFECTHASH_H
+#define PERFECTHASH_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#define PERFECT_HASH_MISSING 0xFFFFFFFFu  // Slot of a key outside the vocabulary
+#define PERFECT_HASH_BUCKET_KEYS 4         // Mean keys per bucket
+#define PERFECT_HASH_LOAD 0.98             // Keys per table slot
+#define PERFECT_HASH_ATTEMPTS 16           // Seeds tried before giving up
+
+// perfectHash_t: slot of every key of a fixed set (no keys: every lookup misses)
+struct perfectHash_t {
+    uint64_t seed = 0;
+    uint32_t bucketCount = 0;
+    uint32_t tableSize = 0;              // Slots the pilots place keys on, spare ones included
+    std::vector<uint16_t> pilots;        // One per bucket
+    std::vector<uint32_t> remap;         // Spare slot - keys.size() -> slot below
+    std::vector<uint32_t> fingerprints;  // One per slot
+    std::vector<std::string> keys;       // The key of every slot
+};
+
+/**
+ * @name hashPerfectHashKey
+ * @brief Hashes a key with a seed.
+ *
+ * @param key The key
+ * @param seed The seed of the hash
+ * @return 64-bit hash: the high half picks the bucket, the low half is the fingerprint
+ */
+inline uint64_t hashPerfectHashKey(const std::string& key, uint64_t seed) {
+    uint64_t hash = seed ^ (key.length() * 0x9E3779B185EBCA87ULL);
+    size_t length = key.length();
+    size_t position = 0;
+
+    do {
+        uint64_t block[2] = {0, 0};
+        size_t count = length - position < sizeof(block) ? length - position : sizeof(block);
+        memcpy(block, key.data() + position, count);
+
+        __uint128_t product = (__uint128_t)(block[0] ^ hash ^ 0xC2B2AE3D27D4EB4FULL) *
+                              (block[1] ^ seed ^ 0x165667B19E3779F9ULL);
+        hash = (uint64_t)product ^ (uint64_t)(product >> 64);
+        position += sizeof(block);
+    } while (position < length);
+
+    hash ^= hash >> 37;
+    hash *= 0x165667B19E3779F9ULL;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+/**
+ * @name getPerfectHashPosition
+ * @brief Computes the table slot a pilot sends a key to.
+ *
+ * @param hash The key hash
+ * @param pilot The pilot of the key's bucket
+ * @param tableSize Slots of the table
+ * @return The slot, in [0, tableSize)
+ */
+inline uint32_t getPerfectHashPosition(uint64_t hash, uint16_t pilot, uint32_t tableSize) {
+    __uint128_t product = (__uint128_t)(hash ^ (pilot * 0xBF58476D1CE4E5B9ULL)) *
+                          0x94D049BB133111EBULL;
+    uint64_t mixed = (uint64_t)product ^ (uint64_t)(product >> 64);
+
+    return (uint32_t)((mixed >> 32) * tableSize >> 32);
+}
+
+/**
+ * @name lookupPerfectHash
+ * @brief Finds the slot of a key.
+ *
+ * @param perfectHash The perfect hash
+ * @param key The key
+ * @return Its slot, in [0, keys.size()), or PERFECT_HASH_MISSING if it is not a key
+ */
+inline uint32_t lookupPerfectHash(const perfectHash_t& perfectHash, const std::string& key) {
+    if (!perfectHash.bucketCount)
+        return PERFECT_HASH_MISSING;
+
+    uint64_t hash = hashPerfectHashKey(key, perfectHash.seed);
+    uint32_t bucket = (uint32_t)((hash >> 32) * perfectHash.bucketCount >> 32);
+    uint32_t slot =
+        getPerfectHashPosition(hash, perfectHash.pilots[bucket], perfectHash.tableSize);
+    if (slot >= perfectHash.keys.size())
+        slot = perfectHash.remap[slot - perfectHash.keys.size()];
+
+    return perfectHash.fingerprints[slot] == (uint32_t)hash ? slot : PERFECT_HASH_MISSING;
+}
+
+bool buildPerfectHash(const std::vector<std::string>& keys, perfectHash_t& perfectHash);
+
+#endif
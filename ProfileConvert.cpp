@@ -0,0 +1,59 @@
+/**
+ * @brief Lequel? profile converter
+ *
+ * Converts trigram profiles between the CSV and the binary (.lqp) formats, to inspect
+ * binary profiles or to convert a folder of CSV profiles:
+ *
+ *   profile_convert resources/trigrams/eng.csv resources/trigrams/eng.lqp
+ *   profile_convert resources/trigrams/eng.lqp eng.csv
+ */
+
+#include <iostream>
+#include <string>
+
+#include "ProfileFile.h"
+
+using namespace std;
+
+/**
+ * @name isBinaryPath
+ * @brief Checks the extension of a profile path.
+ *
+ * @param path The path
+ * @return true for binary profiles
+ */
+static bool isBinaryPath(const string& path) {
+    size_t extension = path.rfind('.');
+
+    return extension != string::npos && path.substr(extension) == PROFILE_FILE_EXTENSION;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " INPUT OUTPUT\n"
+             << "Converts a trigram profile between CSV and binary (" << PROFILE_FILE_EXTENSION
+             << "), according to the file extensions." << endl;
+        return 1;
+    }
+
+    string inputPath = argv[1];
+    string outputPath = argv[2];
+    TrigramProfile profile;
+
+    bool read = isBinaryPath(inputPath) ? readProfileFile(inputPath, profile)
+                                        : readProfileCSV(inputPath, profile);
+    if (!read) {
+        cerr << "Error: could not read profile " << inputPath << endl;
+        return 1;
+    }
+
+    bool written = isBinaryPath(outputPath) ? writeProfileFile(outputPath, profile)
+                                            : writeProfileCSV(outputPath, profile);
+    if (!written) {
+        cerr << "Error: could not write profile " << outputPath << endl;
+        return 1;
+    }
+
+    cout << profile.size() << " entries: " << inputPath << " -> " << outputPath << endl;
+    return 0;
+}
@@ -0,0 +1,493 @@
+/**
+ * @brief Lequel? binary trigram profile files
+ *
+ * @cite https://www.w3.org/TR/png/#D-CRCAppendix CRC-32
+ */
+
+#include "ProfileFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "CSVData.h"
+
+using namespace std;
+
+#define PROFILE_HEADER_WORDS 6
+#define COUNTS_HEADER_WORDS 9
+
+/**
+ * @name buildCRCTable
+ * @brief Builds the CRC-32 lookup table (reflected polynomial 0xEDB88320).
+ *
+ * @return The table
+ */
+static const uint32_t* buildCRCTable() {
+    static uint32_t table[256];
+
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+        table[byte] = crc;
+    }
+
+    return table;
+}
+
+static const uint32_t* CRC_TABLE = buildCRCTable();
+
+/**
+ * @name getCRC32
+ * @brief Computes the CRC-32 of a byte range.
+ *
+ * @param data The bytes
+ * @param length Number of bytes
+ * @return The CRC
+ */
+uint32_t getCRC32(const unsigned char* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < length; i++)
+        crc = CRC_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * @name appendVarint
+ * @brief Appends an unsigned integer, 7 bits per byte, lowest bits first.
+ *
+ * @param buffer The destination
+ * @param value The value
+ */
+static void appendVarint(string& buffer, uint64_t value) {
+    while (value >= 0x80) {
+        buffer += (char)(value | 0x80);
+        value >>= 7;
+    }
+    buffer += (char)value;
+}
+
+/**
+ * @name readVarint
+ * @brief Reads an unsigned integer written by appendVarint.
+ *
+ * @param data The bytes
+ * @param end One past the last readable byte
+ * @param position Position to read from, moved past the value
+ * @param value The destination value (uint32_t or uint64_t)
+ * @return false if the value is truncated or too long
+ */
+template <typename Value>
+static bool readVarint(const unsigned char* data, size_t end, size_t& position, Value& value) {
+    value = 0;
+
+    for (int shift = 0; shift < (int)sizeof(Value) * 8; shift += 7) {
+        if (position >= end)
+            return false;
+
+        unsigned char byte = data[position++];
+        value |= (Value)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @name appendWords
+ * @brief Appends 32-bit words in little-endian order.
+ *
+ * @param buffer The destination
+ * @param words The words
+ * @param count Number of words
+ */
+static void appendWords(string& buffer, const uint32_t* words, int count) {
+    for (int word = 0; word < count; word++) {
+        for (int byte = 0; byte < 4; byte++)
+            buffer += (char)(words[word] >> (8 * byte));
+    }
+}
+
+/**
+ * @name readWords
+ * @brief Reads 32-bit words written by appendWords.
+ *
+ * @param data The bytes
+ * @param words The destination words
+ * @param count Number of words
+ */
+static void readWords(const unsigned char* data, uint32_t* words, int count) {
+    for (int word = 0; word < count; word++) {
+        words[word] = 0;
+        for (int byte = 3; byte >= 0; byte--)
+            words[word] = words[word] << 8 | data[4 * word + byte];
+    }
+}
+
+/**
+ * @name appendTrigramColumns
+ * @brief Appends sorted trigrams, front coded, and their counts as varints.
+ *
+ * @param entries The trigrams and their counts, sorted by trigram
+ * @param trigrams The destination trigram column
+ * @param counts The destination count column
+ */
+static void appendTrigramColumns(const vector<pair<string, uint64_t>>& entries,
+                                 string& trigrams,
+                                 string& counts) {
+    const string* previous = nullptr;
+
+    for (auto& entry : entries) {
+        size_t shared = 0;
+        if (previous) {
+            size_t limit = min(previous->length(), entry.first.length());
+            while (shared < limit && (*previous)[shared] == entry.first[shared])
+                shared++;
+        }
+
+        appendVarint(trigrams, shared);
+        appendVarint(trigrams, entry.first.length() - shared);
+        trigrams.append(entry.first, shared, string::npos);
+        appendVarint(counts, entry.second);
+
+        previous = &entry.first;
+    }
+}
+
+/**
+ * @name readTrigramColumn
+ * @brief Reads a trigram column written by appendTrigramColumns.
+ *
+ * @param contents The file contents
+ * @param position First byte of the column, moved past it
+ * @param end One past the last byte of the column
+ * @param entryCount Number of trigrams
+ * @param trigrams The destination trigrams
+ * @return false if the column is malformed
+ */
+static bool readTrigramColumn(const string& contents,
+                              size_t& position,
+                              size_t end,
+                              uint32_t entryCount,
+                              vector<string>& trigrams) {
+    const unsigned char* data = (const unsigned char*)contents.data();
+    trigrams.assign(entryCount, string());
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        uint32_t shared, suffix;
+        if (!readVarint(data, end, position, shared) ||
+            !readVarint(data, end, position, suffix) ||
+            (i == 0 ? shared != 0 : shared > trigrams[i - 1].length()) ||
+            suffix > end - position)
+            return false;
+
+        if (i > 0)
+            trigrams[i].assign(trigrams[i - 1], 0, shared);
+        trigrams[i].append(contents, position, suffix);
+        position += suffix;
+    }
+
+    return position == end;
+}
+
+/**
+ * @name readFileContents
+ * @brief Reads a whole file.
+ *
+ * @param path The file path
+ * @param contents The destination
+ * @return false if the file can't be read
+ */
+static bool readFileContents(const std::string& path, string& contents) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+        return false;
+
+    contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+/**
+ * @name writeFileContents
+ * @brief Writes a whole file.
+ *
+ * @param path The file path
+ * @param contents The bytes to write
+ * @return false if the file can't be written
+ */
+static bool writeFileContents(const std::string& path, const string& contents) {
+    ofstream file(path, ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.write(contents.data(), contents.length());
+    return file.good();
+}
+
+/**
+ * @name readProfileFile
+ * @brief Reads a binary profile, checking its header and checksum.
+ *
+ * @param path The file path
+ * @param profile The destination profile (real values only; cleared before use)
+ * @return false if the file can't be read or is not a valid profile
+ */
+bool readProfileFile(const std::string& path, TrigramProfile& profile) {
+    string contents;
+    if (!readFileContents(path, contents))
+        return false;
+
+    const unsigned char* data = (const unsigned char*)contents.data();
+    size_t headerBytes = PROFILE_HEADER_WORDS * 4;
+
+    if (contents.length() < headerBytes || memcmp(data, PROFILE_FILE_MAGIC, 4))
+        return false;
+
+    uint32_t header[PROFILE_HEADER_WORDS];
+    readWords(data, header, PROFILE_HEADER_WORDS);
+
+    uint32_t entryCount = header[2];
+    size_t trigramsEnd = headerBytes + header[3];
+    size_t countsEnd = trigramsEnd + header[4];
+
+    if (header[1] != PROFILE_FILE_VERSION || countsEnd != contents.length() ||
+        getCRC32(data + headerBytes, countsEnd - headerBytes) != header[5])
+        return false;
+
+    vector<string> trigrams;
+    size_t position = headerBytes;
+    if (!readTrigramColumn(contents, position, trigramsEnd, entryCount, trigrams))
+        return false;
+
+    profile.clear();
+    profile.reserve(entryCount);
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        uint32_t count;
+        if (!readVarint(data, countsEnd, position, count))
+            return false;
+
+        profile[trigrams[i]].real = (float)count;
+    }
+
+    return position == countsEnd;
+}
+
+/**
+ * @name writeProfileFile
+ * @brief Writes a profile in the binary format. Real values are rounded to integers.
+ *
+ * @param path The file path
+ * @param profile The profile
+ * @return false if the file can't be written
+ */
+bool writeProfileFile(const std::string& path, const TrigramProfile& profile) {
+    vector<pair<string, uint64_t>> entries;
+    entries.reserve(profile.size());
+    for (auto& entry : profile) {
+        float count = entry.second.real > 0.0f ? roundf(entry.second.real) : 0.0f;
+        entries.push_back(make_pair(entry.first, (uint32_t)count));
+    }
+    sort(entries.begin(), entries.end());
+
+    string trigrams;
+    string counts;
+    appendTrigramColumns(entries, trigrams, counts);
+
+    string columns = trigrams + counts;
+    uint32_t header[PROFILE_HEADER_WORDS] = {
+        0,
+        PROFILE_FILE_VERSION,
+        (uint32_t)entries.size(),
+        (uint32_t)trigrams.length(),
+        (uint32_t)counts.length(),
+        getCRC32((const unsigned char*)columns.data(), columns.length()),
+    };
+
+    string output(PROFILE_FILE_MAGIC);
+    appendWords(output, header + 1, PROFILE_HEADER_WORDS - 1);
+    output += columns;
+
+    return writeFileContents(path, output);
+}
+
+/**
+ * @name readCountsFile
+ * @brief Reads the counts of a profile being built incrementally, checking their header and
+ * checksum.
+ *
+ * @param path The file path
+ * @param counts The destination counts (cleared before use)
+ * @return false if the file can't be read or is not a valid counts file
+ */
+bool readCountsFile(const std::string& path, profileCounts_t& counts) {
+    string contents;
+    if (!readFileContents(path, contents))
+        return false;
+
+    const unsigned char* data = (const unsigned char*)contents.data();
+    size_t headerBytes = COUNTS_HEADER_WORDS * 4;
+
+    if (contents.length() < headerBytes || memcmp(data, COUNTS_FILE_MAGIC, 4))
+        return false;
+
+    uint32_t header[COUNTS_HEADER_WORDS];
+    readWords(data, header, COUNTS_HEADER_WORDS);
+
+    uint32_t corpusCount = header[3];
+    uint32_t entryCount = header[4];
+    size_t corporaEnd = headerBytes + header[5];
+    size_t trigramsEnd = corporaEnd + header[6];
+    size_t countsEnd = trigramsEnd + header[7];
+
+    if (header[1] != COUNTS_FILE_VERSION || header[2] > FEATURES_CODE ||
+        countsEnd != contents.length() ||
+        getCRC32(data + headerBytes, countsEnd - headerBytes) != header[8])
+        return false;
+
+    counts.features = (featureSetting_t)header[2];
+    counts.corpora.assign(corpusCount, corpusRecord_t());
+    counts.counts.clear();
+
+    size_t position = headerBytes;
+    for (auto& corpus : counts.corpora) {
+        uint32_t pathLength;
+        if (!readVarint(data, corporaEnd, position, pathLength) ||
+            pathLength > corporaEnd - position)
+            return false;
+
+        corpus.path.assign(contents, position, pathLength);
+        position += pathLength;
+        if (!readVarint(data, corporaEnd, position, corpus.countedBytes) ||
+            !readVarint(data, corporaEnd, position, corpus.tailCRC))
+            return false;
+    }
+    if (position != corporaEnd)
+        return false;
+
+    vector<string> trigrams;
+    if (!readTrigramColumn(contents, position, trigramsEnd, entryCount, trigrams))
+        return false;
+
+    counts.counts.reserve(entryCount);
+    for (uint32_t i = 0; i < entryCount; i++) {
+        uint64_t count;
+        if (!readVarint(data, countsEnd, position, count))
+            return false;
+
+        counts.counts[trigrams[i]] = count;
+    }
+
+    return position == countsEnd;
+}
+
+/**
+ * @name writeCountsFile
+ * @brief Writes the counts of a profile being built incrementally. The file is replaced
+ * only once completely written, so an interrupted build keeps the previous counts.
+ *
+ * @param path The file path
+ * @param counts The counts
+ * @return false if the file can't be written
+ */
+bool writeCountsFile(const std::string& path, const profileCounts_t& counts) {
+    string corpora;
+    for (auto& corpus : counts.corpora) {
+        appendVarint(corpora, corpus.path.length());
+        corpora += corpus.path;
+        appendVarint(corpora, corpus.countedBytes);
+        appendVarint(corpora, corpus.tailCRC);
+    }
+
+    vector<pair<string, uint64_t>> entries(counts.counts.begin(), counts.counts.end());
+    sort(entries.begin(), entries.end());
+
+    string trigrams;
+    string values;
+    appendTrigramColumns(entries, trigrams, values);
+
+    string sections = corpora + trigrams + values;
+    uint32_t header[COUNTS_HEADER_WORDS] = {
+        0,
+        COUNTS_FILE_VERSION,
+        (uint32_t)counts.features,
+        (uint32_t)counts.corpora.size(),
+        (uint32_t)entries.size(),
+        (uint32_t)corpora.length(),
+        (uint32_t)trigrams.length(),
+        (uint32_t)values.length(),
+        getCRC32((const unsigned char*)sections.data(), sections.length()),
+    };
+
+    string output(COUNTS_FILE_MAGIC);
+    appendWords(output, header + 1, COUNTS_HEADER_WORDS - 1);
+    output += sections;
+
+    string temporaryPath = path + ".tmp";
+    if (!writeFileContents(temporaryPath, output))
+        return false;
+
+    return rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+/**
+ * @name readProfileCSV
+ * @brief Reads a profile from a CSV file of trigram, count rows.
+ *
+ * @param path The file path
+ * @param profile The destination profile (real values only; cleared before use)
+ * @return false if the file can't be read
+ */
+bool readProfileCSV(const std::string& path, TrigramProfile& profile) {
+    CSVData data;
+    if (!readCSV(path, data))
+        return false;
+
+    profile.clear();
+    profile.reserve(data.size());
+
+    for (auto& fields : data) {
+        if (fields.size() != 2)
+            continue;
+
+        profile[fields[0]].real += (float)stoi(fields[1]);
+    }
+
+    return true;
+}
+
+/**
+ * @name writeProfileCSV
+ * @brief Writes a profile as CSV rows, most frequent trigram first, like build_profiles.
+ *
+ * @param path The file path
+ * @param profile The profile
+ * @return false if the file can't be written
+ */
+bool writeProfileCSV(const std::string& path, const TrigramProfile& profile) {
+    vector<pair<float, string>> entries;
+    entries.reserve(profile.size());
+    for (auto& entry : profile)
+        entries.push_back(make_pair(-entry.second.real, entry.first));
+    sort(entries.begin(), entries.end());
+
+    CSVData data;
+    data.reserve(entries.size());
+    for (auto& entry : entries) {
+        vector<string> row;
+        row.push_back(entry.second);
+        row.push_back(to_string((long long)roundf(-entry.first)));
+        data.push_back(row);
+    }
+
+    return writeCSV(path, data);
+}
@@ -0,0 +1,76 @@
+/**
+ * @brief Lequel? binary trigram profile files
+ *
+ * A .lqp file stores a profile as two columns instead of quoted CSV rows:
+ *
+ *   header   "LQPF", version, entry count, byte size of each column, CRC-32 of the columns
+ *            (six little-endian 32-bit words)
+ *   trigrams sorted, front coded: per entry, the length of the prefix shared with the
+ *            previous trigram and the length of the rest (varints), then the rest
+ *   counts   one varint per entry, in trigram order
+ *
+ * Counts are stored as integers, like in the CSV files.
+ *
+ * A .lqc file keeps the exact counts of every trigram of a profile being built incrementally
+ * (see build_profiles --incremental), and how much of each corpus file they include, so new
+ * corpus material only adds to them:
+ *
+ *   header   "LQPC", version, feature setting, corpus count, entry count, byte size of each
+ *            section, CRC-32 of the sections (nine little-endian 32-bit words)
+ *   corpora  per corpus file: path length and path, bytes counted, CRC-32 of the last
+ *            counted bytes (varints)
+ *   trigrams as in .lqp files
+ *   counts   one 64-bit varint per entry, in trigram order
+ *
+ * @cite https://protobuf.dev/programming-guides/encoding/#varints
+ * @cite https://en.wikipedia.org/wiki/Incremental_encoding front coding
+ */
+
+#ifndef PROFILEFILE_H
+#define PROFILEFILE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Lequel.h"
+
+#define PROFILE_FILE_MAGIC "LQPF"
+#define PROFILE_FILE_VERSION 1
+#define PROFILE_FILE_EXTENSION ".lqp"
+
+#define COUNTS_FILE_MAGIC "LQPC"
+#define COUNTS_FILE_VERSION 1
+#define COUNTS_FILE_EXTENSION ".lqc"
+
+// Last counted bytes of a corpus file checked before counting what was appended to it
+#define COUNTS_TAIL_BYTES 4096
+
+// corpusRecord_t: how much of a corpus file a profile has counted
+struct corpusRecord_t {
+    std::string path;
+    uint64_t countedBytes = 0;  // Complete lines counted: [0, countedBytes)
+    uint32_t tailCRC = 0;       // CRC-32 of the last COUNTS_TAIL_BYTES counted bytes (or fewer)
+};
+
+// profileCounts_t: exact counts of a profile and the corpus files they come from
+struct profileCounts_t {
+    featureSetting_t features = FEATURES_TRIGRAMS;
+    std::vector<corpusRecord_t> corpora;
+    std::unordered_map<std::string, uint64_t> counts;
+};
+
+bool readProfileFile(const std::string& path, TrigramProfile& profile);
+bool writeProfileFile(const std::string& path, const TrigramProfile& profile);
+
+bool readCountsFile(const std::string& path, profileCounts_t& counts);
+bool writeCountsFile(const std::string& path, const profileCounts_t& counts);
+
+uint32_t getCRC32(const unsigned char* data, size_t length);
+
+bool readProfileCSV(const std::string& path, TrigramProfile& profile);
+bool writeProfileCSV(const std::string& path, const TrigramProfile& profile);
+
+#endif
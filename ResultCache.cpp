@@ -0,0 +1,205 @@
+/**
+ * @brief Lequel? identification result cache
+ *
+ * @cite https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ * The hash follows the XXH3 design (multiply-fold of keyed 64-bit lanes, then avalanche) on
+ * 16-byte blocks with two chained accumulators, but is not XXH3 compatible.
+ */
+
+#include "ResultCache.h"
+
+#include <string.h>
+
+using namespace std;
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+
+static const uint64_t HASH_SECRET[4] = {
+    0xBE4BA423396CFEB8ULL,
+    0x1CAD21F72C81017CULL,
+    0xDB979083E96DD4DEULL,
+    0x1F67B3B7A4A44072ULL,
+};
+
+/**
+ * @name multiplyFold
+ * @brief Multiplies two 64-bit values into 128 bits and folds the halves together.
+ *
+ * @param a First factor
+ * @param b Second factor
+ * @return Low half XOR high half of the product
+ */
+static inline uint64_t multiplyFold(uint64_t a, uint64_t b) {
+    __uint128_t product = (__uint128_t)a * b;
+
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+/**
+ * @name avalanche
+ * @brief Spreads every input bit over the whole result.
+ *
+ * @param value The value
+ * @return The mixed value
+ */
+static inline uint64_t avalanche(uint64_t value) {
+    value ^= value >> 37;
+    value *= HASH_PRIME_3;
+    value ^= value >> 32;
+
+    return value;
+}
+
+/**
+ * @name hash128
+ * @brief Computes a 128-bit non-cryptographic hash.
+ *
+ * @param data The bytes to hash
+ * @param length Number of bytes
+ * @param seed Distinguishes hashes of the same bytes in different contexts
+ * @param hash The destination hash
+ */
+void hash128(const char* data, size_t length, uint64_t seed, resultCacheKey_t& hash) {
+    uint64_t low = seed ^ (length * HASH_PRIME_1);
+    uint64_t high = ~seed + length * HASH_PRIME_2;
+    size_t position = 0;
+
+    while (position < length) {
+        uint64_t words[2] = {0, 0};
+
+        if (position + sizeof(words) <= length)
+            memcpy(words, data + position, sizeof(words));
+        else
+            memcpy(words, data + position, length - position);  // Zero padded tail
+
+        low = multiplyFold(words[0] ^ HASH_SECRET[0] ^ low, words[1] ^ HASH_SECRET[1]);
+        high = multiplyFold(words[1] ^ HASH_SECRET[2] ^ high, words[0] ^ HASH_SECRET[3]);
+        position += sizeof(words);
+    }
+
+    hash.low = avalanche(low ^ (high >> 29 | high << 35));
+    hash.high = avalanche(high + low * HASH_PRIME_1);
+}
+
+/**
+ * @name initResultCache
+ * @brief Sets the capacity of a cache.
+ *
+ * @param cache The cache (must be empty)
+ * @param capacity Maximum number of results kept, 0 disables the cache
+ */
+void initResultCache(resultCache_t& cache, size_t capacity) {
+    cache.shardCapacity = (capacity + RESULT_CACHE_SHARDS - 1) / RESULT_CACHE_SHARDS;
+
+    for (auto& shard : cache.shards)
+        shard.index.reserve(cache.shardCapacity);
+}
+
+/**
+ * @name getResultCacheKey
+ * @brief Hashes an identification request: the bytes identification can read (the first
+ * lineLimit lines and the script detection prefix), the settings that change the result and
+ * the model generation.
+ *
+ * @param text String of UTF-8 characters
+ * @param globalSettings The struct containing all the settings data
+ * @param model The language model the request is identified with
+ * @return The key
+ */
+resultCacheKey_t getResultCacheKey(const std::string& text,
+                                   const settings_t& globalSettings,
+                                   const LanguageModel& model) {
+    size_t end = 0;
+    for (unsigned int line = 0; line < globalSettings.lineLimit && end < text.length(); line++) {
+        const void* newline = memchr(text.data() + end, '\n', text.length() - end);
+        end = newline ? (const char*)newline - text.data() + 1 : text.length();
+    }
+    if (end < SCRIPT_DETECTION_BYTES)
+        end = text.length() < SCRIPT_DETECTION_BYTES ? text.length() : SCRIPT_DETECTION_BYTES;
+
+    // One word per field, so no value can spill into the bits of another
+    const uint64_t settings[] = {
+        (uint64_t)globalSettings.algorithmSetting,
+        (uint64_t)globalSettings.valueProcessingSetting,
+        (uint64_t)globalSettings.featureSetting,
+        globalSettings.trigramLimit,
+        globalSettings.lineLimit,
+        globalSettings.clusterBeam,
+        globalSettings.indexCandidates,
+        model.generation,
+    };
+    resultCacheKey_t settingsHash;
+    hash128((const char*)settings, sizeof(settings), 0, settingsHash);
+
+    resultCacheKey_t key;
+    hash128(text.data(), end, settingsHash.low ^ settingsHash.high * HASH_PRIME_2, key);
+
+    return key;
+}
+
+/**
+ * @name lookupResultCache
+ * @brief Looks up a result and marks it as recently used.
+ *
+ * @param cache The cache
+ * @param key The request key
+ * @param languageCode Destination for the cached language code
+ * @return true on a hit
+ */
+bool lookupResultCache(resultCache_t& cache,
+                       const resultCacheKey_t& key,
+                       std::string& languageCode) {
+    if (!cache.shardCapacity)
+        return false;
+
+    resultCacheShard_t& shard = cache.shards[key.high % RESULT_CACHE_SHARDS];
+    {
+        lock_guard<mutex> guard(shard.lock);
+
+        auto entry = shard.index.find(key);
+        if (entry != shard.index.end()) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, entry->second);
+            languageCode = entry->second->second;
+            cache.hits++;
+            return true;
+        }
+    }
+
+    cache.misses++;
+    return false;
+}
+
+/**
+ * @name storeResultCache
+ * @brief Stores a result, evicting the least recently used one of its shard when full.
+ *
+ * @param cache The cache
+ * @param key The request key
+ * @param languageCode The language code
+ */
+void storeResultCache(resultCache_t& cache,
+                      const resultCacheKey_t& key,
+                      const std::string& languageCode) {
+    if (!cache.shardCapacity)
+        return;
+
+    resultCacheShard_t& shard = cache.shards[key.high % RESULT_CACHE_SHARDS];
+    lock_guard<mutex> guard(shard.lock);
+
+    auto entry = shard.index.find(key);
+    if (entry != shard.index.end()) {
+        entry->second->second = languageCode;
+        shard.entries.splice(shard.entries.begin(), shard.entries, entry->second);
+        return;
+    }
+
+    if (shard.entries.size() >= cache.shardCapacity) {
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+    }
+
+    shard.entries.push_front(make_pair(key, languageCode));
+    shard.index[key] = shard.entries.begin();
+}
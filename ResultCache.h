@@ -0,0 +1,75 @@
+/**
+ * @brief Lequel? identification result cache
+ *
+ * Bounded LRU cache of language codes keyed by a 128-bit hash of the part of the text that
+ * identification reads, the settings that change the result and the model generation. The
+ * cache is split into independently locked shards so concurrent workers rarely contend.
+ */
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "Lequel.h"
+
+#define RESULT_CACHE_SHARDS 16
+
+// resultCacheKey_t: 128-bit hash of an identification request
+struct resultCacheKey_t {
+    uint64_t low;
+    uint64_t high;
+
+    bool operator==(const resultCacheKey_t& other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
+// resultCacheKeyHash_t: the key is already a hash, its low half is used as is
+struct resultCacheKeyHash_t {
+    size_t operator()(const resultCacheKey_t& key) const {
+        return (size_t)key.low;
+    }
+};
+
+typedef std::list<std::pair<resultCacheKey_t, std::string>> ResultCacheList;
+
+// resultCacheShard_t: one LRU list (most recent first) and its lookup table
+struct resultCacheShard_t {
+    std::mutex lock;
+    ResultCacheList entries;
+    std::unordered_map<resultCacheKey_t, ResultCacheList::iterator, resultCacheKeyHash_t> index;
+};
+
+// resultCache_t: the sharded cache and its counters
+struct resultCache_t {
+    resultCacheShard_t shards[RESULT_CACHE_SHARDS];
+    size_t shardCapacity = 0;  // 0: disabled
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+};
+
+void hash128(const char* data, size_t length, uint64_t seed, resultCacheKey_t& hash);
+
+void initResultCache(resultCache_t& cache, size_t capacity);
+
+resultCacheKey_t getResultCacheKey(const std::string& text,
+                                   const settings_t& globalSettings,
+                                   const LanguageModel& model);
+
+bool lookupResultCache(resultCache_t& cache,
+                       const resultCacheKey_t& key,
+                       std::string& languageCode);
+
+void storeResultCache(resultCache_t& cache,
+                      const resultCacheKey_t& key,
+                      const std::string& languageCode);
+
+#endif
@@ -0,0 +1,296 @@
+/**
+ * @brief Lequel? multi-language segmentation
+ *
+ * The window holds trigram counts c_t. For a language with normalized frequencies p_t the
+ * cosine similarity is sum(c_t * p_t) / sqrt(sum(c_t^2)), since language profiles already
+ * have unit norm. Both sums are kept up to date as the window slides: a trigram entering adds
+ * its weight to every language in its posting list and 2 * c_t + 1 to the squared norm, a
+ * trigram leaving undoes it. The leader is kept the same way, with an upper bound of the dot
+ * products of the other languages: a trigram leaving only lowers scores, so the bound still
+ * holds, and a trigram entering raises it to the new scores of its posting list. Languages are
+ * only compared again when the score of the leader falls to the bound.
+ *
+ * @cite
+ * https://nlp.stanford.edu/IR-book/html/htmledition/a-first-take-at-building-an-inverted-index-1.html
+ * inverted indexes
+ */
+
+#include "Segmentation.h"
+
+#include <cmath>
+
+#include "TextNormalization.h"
+
+using namespace std;
+
+// windowTrigram_t: a trigram of the text
+struct windowTrigram_t {
+    size_t offset;                                // Byte offset of its first character
+    unsigned int id;                              // Distinct trigram number within the text
+    const vector<trigramPosting_t>* postings;    // nullptr if no language contains it
+};
+
+// windowLeader_t: the language with the highest dot product with the window
+struct windowLeader_t {
+    int language = -1;     // Index into scriptLanguages[SCRIPT_UNKNOWN], -1 if nothing matched
+    double score = 0.0;    // Its dot product
+    double runnerUp = 0.0;  // Not below the dot product of any other language
+};
+
+// languageRun_t: consecutive trigrams labelled with the same language
+struct languageRun_t {
+    int language;  // Index into scriptLanguages[SCRIPT_UNKNOWN], -1 if nothing matched
+    size_t first;  // First trigram
+    size_t count;
+    double scoreSum;  // Similarity of the windows voting for language
+    size_t votes;
+};
+
+/**
+ * @name extractTrigrams
+ * @brief Lists the normalized trigrams of every line of a text, in order, together with their
+ * posting lists. Trigrams never span two lines, as in addToTrigramProfile.
+ *
+ * @param text String of UTF-8 characters, '\n'-separated
+ * @param model The language model
+ * @param trigrams The destination trigrams
+ * @return Number of distinct trigrams
+ */
+static unsigned int extractTrigrams(const string& text,
+                                    LanguageModel& model,
+                                    vector<windowTrigram_t>& trigrams) {
+    unordered_map<string, unsigned int> ids;
+    size_t lineStart = 0;
+
+    trigrams.clear();
+
+    while (lineStart < text.length()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == string::npos)
+            lineEnd = text.length();
+
+        size_t end = lineEnd;
+        if (end > lineStart && text[end - 1] == '\r')
+            end--;
+
+        forEachTrigram(text, lineStart, end, [&](const std::string& trigram, size_t offset) {
+            auto id = ids.insert(make_pair(trigram, (unsigned int)ids.size())).first->second;
+            windowTrigram_t entry = {offset, id, nullptr};
+
+            // Noise (identifiers, URLs, foreign words) is mostly rejected without probing the index
+            if (mayContain(model.trigramFilter, trigram)) {
+                auto postings = model.trigramIndex.find(trigram);
+                if (postings != model.trigramIndex.end())
+                    entry.postings = &postings->second;
+            }
+            trigrams.push_back(entry);
+            return true;
+        });
+
+        lineStart = lineEnd + 1;
+    }
+
+    return (unsigned int)ids.size();
+}
+
+/**
+ * @name moveTrigram
+ * @brief Adds a trigram to the window (direction 1) or removes it (direction -1).
+ *
+ * @param trigram The trigram
+ * @param direction 1 or -1
+ * @param counts Window count of every distinct trigram
+ * @param sumSquares Sum of the squared window counts
+ * @param dots Per-language dot products with the window
+ * @param leader The leader, its score and the bound of the others kept up to date
+ */
+static inline void moveTrigram(const windowTrigram_t& trigram,
+                               int direction,
+                               vector<unsigned int>& counts,
+                               long long& sumSquares,
+                               vector<double>& dots,
+                               windowLeader_t& leader) {
+    if (direction > 0)
+        sumSquares += 2LL * counts[trigram.id]++ + 1;
+    else
+        sumSquares -= 2LL * --counts[trigram.id] + 1;
+
+    if (!trigram.postings)
+        return;
+
+    for (auto& posting : *trigram.postings) {
+        double dot = dots[posting.language] += direction * posting.weight;
+
+        if ((int)posting.language == leader.language)
+            leader.score = dot;
+        else if (dot > leader.runnerUp)
+            leader.runnerUp = dot;
+    }
+}
+
+/**
+ * @name findLeader
+ * @brief Compares every language to find the leader of the window, the first one on ties, and
+ * the best score of the others.
+ *
+ * @param dots Per-language dot products with the window
+ * @param leader The destination leader
+ */
+static void findLeader(const vector<double>& dots, windowLeader_t& leader) {
+    leader.language = -1;
+    leader.score = 0.0;
+    leader.runnerUp = 0.0;
+
+    for (size_t language = 0; language < dots.size(); language++) {
+        if (dots[language] > leader.score) {
+            leader.runnerUp = leader.score;
+            leader.score = dots[language];
+            leader.language = (int)language;
+        } else if (dots[language] > leader.runnerUp)
+            leader.runnerUp = dots[language];
+    }
+}
+
+/**
+ * @name getLineStart
+ * @brief Moves a span boundary back to the start of its line, when that doesn't cross the
+ * previous boundary.
+ *
+ * @param text The text
+ * @param offset The boundary
+ * @param previous The previous boundary
+ * @return The new boundary
+ */
+static size_t getLineStart(const string& text, size_t offset, size_t previous) {
+    size_t newline = text.rfind('\n', offset - 1);
+    size_t lineStart = newline == string::npos ? 0 : newline + 1;
+
+    return lineStart > previous ? lineStart : offset;
+}
+
+/**
+ * @name segmentLanguages
+ * @brief Splits a text into spans of a single language.
+ * Every trigram is labelled with the leader of the window centered on it; runs shorter than
+ * minSpanTrigrams are merged into the previous run. Spans cover the whole text and start at
+ * the beginning of a line when possible.
+ *
+ * @param text String of UTF-8 characters
+ * @param model The language model (indexed)
+ * @param segmentationSettings The window and span sizes
+ * @param spans The destination spans (empty if the text has no trigrams)
+ */
+void segmentLanguages(const std::string& text,
+                      LanguageModel& model,
+                      const segmentationSettings_t& segmentationSettings,
+                      LanguageSpans& spans) {
+    LanguageCandidates& languages = model.scriptLanguages[SCRIPT_UNKNOWN];
+    vector<windowTrigram_t> trigrams;
+    unsigned int distinctCount = extractTrigrams(text, model, trigrams);
+
+    spans.clear();
+    if (trigrams.empty())
+        return;
+
+    size_t trigramCount = trigrams.size();
+    size_t windowSize = segmentationSettings.windowTrigrams;
+    if (windowSize == 0 || windowSize > trigramCount)
+        windowSize = trigramCount;
+    size_t windowCount = trigramCount - windowSize + 1;
+
+    // Slides the window, one trigram at a time
+    vector<unsigned int> counts(distinctCount, 0);
+    vector<double> dots(languages.size(), 0.0);
+    long long sumSquares = 0;
+    windowLeader_t leader;
+    vector<int> windowLeaders(windowCount);
+    vector<float> windowScores(windowCount);
+
+    for (size_t i = 0; i < windowSize; i++)
+        moveTrigram(trigrams[i], 1, counts, sumSquares, dots, leader);
+    findLeader(dots, leader);
+
+    for (size_t window = 0; window < windowCount; window++) {
+        if (window > 0) {
+            moveTrigram(trigrams[window - 1], -1, counts, sumSquares, dots, leader);
+            moveTrigram(trigrams[window + windowSize - 1], 1, counts, sumSquares, dots, leader);
+
+            // Another language may have caught up (a tie goes to the lowest index)
+            if (leader.runnerUp > leader.score || (leader.runnerUp > 0.0 &&
+                                                   leader.runnerUp == leader.score))
+                findLeader(dots, leader);
+        }
+
+        windowLeaders[window] = leader.language;
+        windowScores[window] = (float)(leader.score / sqrt((double)sumSquares));
+    }
+
+    // Labels every trigram with its centered window and groups the labels into runs
+    vector<languageRun_t> runs;
+    languageRun_t pending = {-1, 0, 0, 0.0, 0};
+    bool hasPending = false;
+
+    for (size_t i = 0; i < trigramCount; i++) {
+        size_t window = i < windowSize / 2 ? 0 : i - windowSize / 2;
+        if (window >= windowCount)
+            window = windowCount - 1;
+
+        int language = windowLeaders[window];
+        if (!hasPending || language != pending.language) {
+            if (hasPending)
+                runs.push_back(pending);
+            pending.language = language;
+            pending.first = i;
+            pending.count = 0;
+            pending.scoreSum = 0.0;
+            pending.votes = 0;
+            hasPending = true;
+        }
+        pending.count++;
+        pending.scoreSum += windowScores[window];
+        pending.votes++;
+    }
+    runs.push_back(pending);
+
+    // Merges short runs into their neighbours
+    vector<languageRun_t> merged;
+    for (auto& run : runs) {
+        if (!merged.empty() && (run.count < segmentationSettings.minSpanTrigrams ||
+                                run.language == merged.back().language)) {
+            languageRun_t& previous = merged.back();
+            previous.count += run.count;
+            if (run.language == previous.language) {
+                previous.scoreSum += run.scoreSum;
+                previous.votes += run.votes;
+            }
+            continue;
+        }
+
+        if (merged.size() == 1 && merged[0].count < segmentationSettings.minSpanTrigrams) {
+            // A short first run joins the second
+            run.first = merged[0].first;
+            run.count += merged[0].count;
+            merged.clear();
+        }
+        merged.push_back(run);
+    }
+
+    // Converts the runs into byte spans covering the text
+    size_t begin = 0;
+    for (size_t i = 0; i < merged.size(); i++) {
+        size_t end = text.length();
+        if (i + 1 < merged.size())
+            end = getLineStart(text, trigrams[merged[i + 1].first].offset, begin);
+
+        languageSpan_t span;
+        span.begin = begin;
+        span.end = end;
+        span.languageCode = merged[i].language < 0
+                                ? nullptr
+                                : &languages[merged[i].language]->languageCode;
+        span.confidence = merged[i].votes ? (float)(merged[i].scoreSum / merged[i].votes) : 0.0f;
+        spans.push_back(span);
+
+        begin = end;
+    }
+}
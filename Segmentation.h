@@ -0,0 +1,39 @@
+/**
+ * @brief Lequel? multi-language segmentation
+ *
+ * Splits a text that switches languages (subtitles, forum threads, bilingual documents) into
+ * spans, scoring a sliding window of trigrams with cosine similarity. The per-language dot
+ * products are updated through the inverted trigram index as trigrams enter and leave the
+ * window, so every step costs one posting list instead of a full profile.
+ */
+
+#ifndef SEGMENTATION_H
+#define SEGMENTATION_H
+
+#include <string>
+#include <vector>
+
+#include "Lequel.h"
+
+// languageSpan_t: a byte range of the text and its language
+struct languageSpan_t {
+    size_t begin;                     // First byte
+    size_t end;                       // One past the last byte
+    const std::string* languageCode;  // Points into the model, nullptr if nothing matched
+    float confidence;                 // Mean cosine similarity of the windows voting for it
+};
+
+typedef std::vector<languageSpan_t> LanguageSpans;
+
+// segmentationSettings_t: determines the granularity of the spans
+struct segmentationSettings_t {
+    unsigned int windowTrigrams = 200;  // Trigrams scored together
+    unsigned int minSpanTrigrams = 100;  // Shorter runs are merged into their neighbours
+};
+
+void segmentLanguages(const std::string& text,
+                      LanguageModel& model,
+                      const segmentationSettings_t& segmentationSettings,
+                      LanguageSpans& spans);
+
+#endif
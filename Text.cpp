@@ -7,6 +7,11 @@
 
 #include "Text.h"
 
+#include <stdio.h>
+
+#include "InputStream.h"
+#include "UnicodeScript.h"
+
 using namespace std;
 
 /**
@@ -39,7 +44,8 @@ bool getTextFromString(const string &s, Text &text)
 }
 
 /**
- * @brief Loads a text file as a list of strings.
+ * @brief Loads a text file as a list of strings. Compressed files are decoded (see
+ * InputStream.h) and text in another encoding is converted to UTF-8 (see TextEncoding.h).
  *
  * @param path Path of file to read
  * @param text Destination text
@@ -47,29 +53,46 @@ bool getTextFromString(const string &s, Text &text)
  */
 bool getTextFromFile(const string path, Text &text)
 {
-    ifstream file(path, ios::binary);
+    inputStream_t stream;
+    string fileData;
 
-    if (!file.is_open())
+    if (!openInputStream(path.c_str(), stream))
+        return false;
+
+    peekInputStream(stream, SCRIPT_DETECTION_BYTES, fileData);
+    setInputStreamEncoding(stream, detectEncoding(fileData.data(), fileData.length(), nullptr));
+    fileData.clear();
+
+    if (!readInputStream(stream, fileData, 10000000))
     {
-        perror(("Error while opening file " + path).c_str());
+        fprintf(stderr, "Error while reading file: %s\n", path.c_str());
         return false;
     }
 
-    // Get file size
-    file.seekg(0, ios::end);
-    int fileSize = file.tellg() > 10000000 ? 10000000 : (int)file.tellg();
-    string fileData(fileSize, ' ');
-    file.seekg(0);
+    closeInputStream(stream);
+
+    return getTextFromString(fileData, text);
+}
 
-    file.read(&fileData[0], fileSize);
+/**
+ * @brief Saves a list of strings as a '\n'-separated text file.
+ *
+ * @param text Text to save
+ * @param path Path of file to write
+ * @return Function succeeded
+ */
+bool writeTextToFile(const Text &text, const string path)
+{
+    ofstream file(path, ios::binary);
 
-    if (file.fail())
+    if (!file.is_open())
     {
-        perror(("Error while reading file: " + path).c_str());
+        perror(("Error while opening file " + path).c_str());
         return false;
     }
 
-    file.close();
+    for (auto &line : text)
+        file << line << '\n';
 
-    return getTextFromString(fileData, text);
+    return !file.fail();
 }
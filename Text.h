@@ -18,6 +18,7 @@ typedef std::list<std::string> Text;
 // Functions
 bool getTextFromString(const std::string &s, Text &text);
 bool getTextFromFile(const std::string path, Text &text);
+bool writeTextToFile(const Text &text, const std::string path);
 // FILE * getTextFromFile(const char* path, Text &text);
 
 #endif
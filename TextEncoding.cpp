@@ -0,0 +1,600 @@
+/**
+ * @brief Lequel? character encoding detection and conversion to UTF-8
+ *
+ * @cite https://encoding.spec.whatwg.org/
+ * single-byte code page tables (bytes without a character map to the same codepoint)
+ * @cite http://graphics.stanford.edu/~seander/bithacks.html#HasLessInWord
+ * testing 8 bytes at a time in a 64-bit word
+ */
+
+#include "TextEncoding.h"
+
+#include <string.h>
+
+#include "TextNormalization.h"
+#include "UnicodeScript.h"
+
+using namespace std;
+
+#define WORD_HIGH_BITS 0x8080808080808080ULL
+#define WORD_ONES 0x0101010101010101ULL
+
+// Codepoints of bytes 0x80 to 0xFF, in encoding_t order from ENCODING_WINDOWS1250
+static const uint16_t CODE_PAGES[4][128] = {
+    // Windows-1250
+    {
+        0x20AC, 0x0081, 0x201A, 0x0083, 0x201E, 0x2026, 0x2020, 0x2021,
+        0x0088, 0x2030, 0x0160, 0x2039, 0x015A, 0x0164, 0x017D, 0x0179,
+        0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+        0x0098, 0x2122, 0x0161, 0x203A, 0x015B, 0x0165, 0x017E, 0x017A,
+        0x00A0, 0x02C7, 0x02D8, 0x0141, 0x00A4, 0x0104, 0x00A6, 0x00A7,
+        0x00A8, 0x00A9, 0x015E, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x017B,
+        0x00B0, 0x00B1, 0x02DB, 0x0142, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+        0x00B8, 0x0105, 0x015F, 0x00BB, 0x013D, 0x02DD, 0x013E, 0x017C,
+        0x0154, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7,
+        0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,
+        0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7,
+        0x0158, 0x016E, 0x00DA, 0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF,
+        0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7,
+        0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F,
+        0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x00F7,
+        0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9,
+    },
+    // Windows-1251
+    {
+        0x0402, 0x0403, 0x201A, 0x0453, 0x201E, 0x2026, 0x2020, 0x2021,
+        0x20AC, 0x2030, 0x0409, 0x2039, 0x040A, 0x040C, 0x040B, 0x040F,
+        0x0452, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+        0x0098, 0x2122, 0x0459, 0x203A, 0x045A, 0x045C, 0x045B, 0x045F,
+        0x00A0, 0x040E, 0x045E, 0x0408, 0x00A4, 0x0490, 0x00A6, 0x00A7,
+        0x0401, 0x00A9, 0x0404, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x0407,
+        0x00B0, 0x00B1, 0x0406, 0x0456, 0x0491, 0x00B5, 0x00B6, 0x00B7,
+        0x0451, 0x2116, 0x0454, 0x00BB, 0x0458, 0x0405, 0x0455, 0x0457,
+        0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+        0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+        0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+        0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+        0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+        0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+        0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+        0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+    },
+    // Windows-1252
+    {
+        0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+        0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+        0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+        0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+        0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+        0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+        0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+        0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+        0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+        0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+        0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+        0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+        0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+        0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+        0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+        0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+    },
+    // KOI8-R
+    {
+        0x2500, 0x2502, 0x250C, 0x2510, 0x2514, 0x2518, 0x251C, 0x2524,
+        0x252C, 0x2534, 0x253C, 0x2580, 0x2584, 0x2588, 0x258C, 0x2590,
+        0x2591, 0x2592, 0x2593, 0x2320, 0x25A0, 0x2219, 0x221A, 0x2248,
+        0x2264, 0x2265, 0x00A0, 0x2321, 0x00B0, 0x00B2, 0x00B7, 0x00F7,
+        0x2550, 0x2551, 0x2552, 0x0451, 0x2553, 0x2554, 0x2555, 0x2556,
+        0x2557, 0x2558, 0x2559, 0x255A, 0x255B, 0x255C, 0x255D, 0x255E,
+        0x255F, 0x2560, 0x2561, 0x0401, 0x2562, 0x2563, 0x2564, 0x2565,
+        0x2566, 0x2567, 0x2568, 0x2569, 0x256A, 0x256B, 0x256C, 0x00A9,
+        0x044E, 0x0430, 0x0431, 0x0446, 0x0434, 0x0435, 0x0444, 0x0433,
+        0x0445, 0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E,
+        0x043F, 0x044F, 0x0440, 0x0441, 0x0442, 0x0443, 0x0436, 0x0432,
+        0x044C, 0x044B, 0x0437, 0x0448, 0x044D, 0x0449, 0x0447, 0x044A,
+        0x042E, 0x0410, 0x0411, 0x0426, 0x0414, 0x0415, 0x0424, 0x0413,
+        0x0425, 0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E,
+        0x041F, 0x042F, 0x0420, 0x0421, 0x0422, 0x0423, 0x0416, 0x0412,
+        0x042C, 0x042B, 0x0417, 0x0428, 0x042D, 0x0429, 0x0427, 0x042A,
+    },
+};
+
+// Units of 4 UTF-16 characters that are all ASCII have these bits clear
+static const unsigned char UTF16LE_NON_ASCII_BYTES[8] = {
+    0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF};
+static const unsigned char UTF16BE_NON_ASCII_BYTES[8] = {
+    0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80};
+
+/**
+ * @name loadWord
+ * @brief Reads 8 bytes as a 64-bit word.
+ *
+ * @param data The bytes
+ * @return The word
+ */
+static inline uint64_t loadWord(const void* data) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+
+    return word;
+}
+
+/**
+ * @name hasControlBytes
+ * @brief Checks whether a text has control bytes other than tabs and line breaks, as UTF-16
+ * and binary data do.
+ *
+ * @param bytes The text
+ * @param length Number of bytes
+ * @return true if a byte below 0x20 other than '\t', '\n', '\v', '\f' or '\r' was found
+ */
+static bool hasControlBytes(const unsigned char* bytes, size_t length) {
+    size_t position = 0;
+
+    while (position < length) {
+        // Skips 8 bytes at a time while none is below 0x20
+        while (position + 8 <= length) {
+            uint64_t word = loadWord(bytes + position);
+            if ((word - 0x20 * WORD_ONES) & ~word & WORD_HIGH_BITS)
+                break;
+            position += 8;
+        }
+
+        size_t end = position + 8 < length ? position + 8 : length;
+        for (; position < end; position++) {
+            if (bytes[position] < 0x20 && (bytes[position] < '\t' || bytes[position] > '\r'))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @name detectUTF16
+ * @brief Recognizes UTF-16 text without a byte order mark: the high bytes of its characters
+ * mostly repeat one value, the low bytes vary.
+ *
+ * @param bytes The text
+ * @param length Number of bytes
+ * @param encoding The destination encoding
+ * @return true if the text looks like UTF-16
+ */
+static bool detectUTF16(const unsigned char* bytes, size_t length, encoding_t& encoding) {
+    size_t counts[2][256] = {};
+    size_t pairs = length / 2;
+    if (!pairs)
+        return false;
+
+    for (size_t position = 0; position + 1 < length; position += 2) {
+        counts[0][bytes[position]]++;
+        counts[1][bytes[position + 1]]++;
+    }
+
+    size_t repeated[2] = {0, 0};
+    for (int parity = 0; parity < 2; parity++) {
+        for (int value = 0; value < 256; value++)
+            repeated[parity] = counts[parity][value] > repeated[parity] ? counts[parity][value]
+                                                                        : repeated[parity];
+    }
+
+    for (int parity = 0; parity < 2; parity++) {
+        if (repeated[parity] >= UTF16_REPEATED_SHARE * pairs &&
+            repeated[1 - parity] < UTF16_VARIED_SHARE * pairs) {
+            // High bytes at odd offsets: little endian
+            encoding = parity ? ENCODING_UTF16LE : ENCODING_UTF16BE;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @name isValidUTF8
+ * @brief Checks whether a text is valid UTF-8, skipping ASCII 8 bytes at a time. A sequence
+ * cut by the end of the text is accepted.
+ *
+ * @param bytes The text
+ * @param length Number of bytes
+ * @return true if valid
+ */
+static bool isValidUTF8(const unsigned char* bytes, size_t length) {
+    size_t position = 0;
+
+    while (position < length) {
+        while (position + 8 <= length && !(loadWord(bytes + position) & WORD_HIGH_BITS))
+            position += 8;
+        if (position >= length)
+            break;
+
+        unsigned char lead = bytes[position];
+        if (lead < 0x80) {
+            position++;
+            continue;
+        }
+
+        size_t continuationCount;
+        uint32_t codepoint;
+        uint32_t minimum;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            continuationCount = 1;
+            codepoint = lead & 0x1F;
+            minimum = 0x80;
+        } else if ((lead & 0xF0) == 0xE0) {
+            continuationCount = 2;
+            codepoint = lead & 0x0F;
+            minimum = 0x800;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            continuationCount = 3;
+            codepoint = lead & 0x07;
+            minimum = 0x10000;
+        } else
+            return false;
+
+        size_t end = position + 1 + continuationCount;
+        for (position++; position < end; position++) {
+            if (position == length)
+                return true;  // Cut by the end of the text
+            if ((bytes[position] & 0xC0) != 0x80)
+                return false;
+            codepoint = codepoint << 6 | (bytes[position] & 0x3F);
+        }
+
+        if (codepoint < minimum || codepoint > 0x10FFFF ||
+            (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @name encodeUTF8
+ * @brief Writes a codepoint as UTF-8.
+ *
+ * @param codepoint The codepoint (at most 0x10FFFF)
+ * @param output The destination (at least 4 bytes)
+ * @return Number of bytes written
+ */
+static inline size_t encodeUTF8(uint32_t codepoint, char* output) {
+    if (codepoint < 0x80) {
+        output[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        output[0] = (char)(0xC0 | codepoint >> 6);
+        output[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        output[0] = (char)(0xE0 | codepoint >> 12);
+        output[1] = (char)(0x80 | (codepoint >> 6 & 0x3F));
+        output[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    output[0] = (char)(0xF0 | codepoint >> 18);
+    output[1] = (char)(0x80 | (codepoint >> 12 & 0x3F));
+    output[2] = (char)(0x80 | (codepoint >> 6 & 0x3F));
+    output[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+/**
+ * @name getByteCodepoint
+ * @brief Decodes a byte of a single-byte code page.
+ *
+ * @param encoding The code page (ENCODING_WINDOWS1250 or later)
+ * @param byte The byte
+ * @return Its codepoint
+ */
+static inline uint32_t getByteCodepoint(encoding_t encoding, unsigned char byte) {
+    return byte < 0x80 ? byte : CODE_PAGES[encoding - ENCODING_WINDOWS1250][byte - 0x80];
+}
+
+/**
+ * @name isLetter
+ * @brief Checks whether a codepoint is a letter of a known script.
+ *
+ * @param codepoint The codepoint
+ * @return true for letters
+ */
+static inline bool isLetter(uint32_t codepoint) {
+    return getCodepointScript(codepoint) != SCRIPT_UNKNOWN;
+}
+
+/**
+ * @name countWordLetters
+ * @brief Counts the bytes above 0x7F that a code page decodes into a lowercase letter right
+ * after another letter: text read with the right code page has many, since accented and
+ * non-Latin letters mostly continue words.
+ *
+ * @param bytes The text
+ * @param length Number of bytes
+ * @param encoding The code page
+ * @return The count
+ */
+static size_t countWordLetters(const unsigned char* bytes, size_t length, encoding_t encoding) {
+    size_t count = 0;
+    bool afterLetter = false;
+
+    for (size_t position = 0; position < length; position++) {
+        uint32_t codepoint = getByteCodepoint(encoding, bytes[position]);
+        bool isCurrentLetter = isLetter(codepoint);
+
+        if (bytes[position] >= 0x80 && afterLetter && isCurrentLetter &&
+            foldCodepoint(codepoint) == codepoint)
+            count++;
+        afterLetter = isCurrentLetter;
+    }
+
+    return count;
+}
+
+/**
+ * @name getVocabularyShare
+ * @brief Returns the share of the trigrams with a non-ASCII character of a text read with a
+ * code page that are in the vocabulary. A share, not a count: a code page that decodes
+ * punctuation into letters yields more trigrams, not more known ones.
+ *
+ * @param bytes The text
+ * @param length Number of bytes
+ * @param encoding The code page
+ * @param vocabulary Filter of the trigrams of the model
+ * @return The share (0 without such trigrams)
+ */
+static float getVocabularyShare(const unsigned char* bytes,
+                                size_t length,
+                                encoding_t encoding,
+                                const bloomFilter_t& vocabulary) {
+    string text;
+    transcodeText(string((const char*)bytes, length), encoding, text);
+
+    size_t known = 0;
+    size_t total = 0;
+    forEachTrigram(text, 0, text.length(), [&](const string& trigram, size_t) {
+        for (unsigned char byte : trigram) {
+            if (byte >= 0x80) {
+                known += mayContain(vocabulary, trigram);
+                total++;
+                break;
+            }
+        }
+        return true;
+    });
+
+    return total ? (float)known / total : 0.0f;
+}
+
+/**
+ * @name detectCodePage
+ * @brief Picks the single-byte code page of a text that is not UTF-8.
+ *
+ * @param bytes The text
+ * @param length Number of bytes
+ * @param vocabulary Optional filter of the trigrams of the model
+ * @return The code page
+ */
+static encoding_t detectCodePage(const unsigned char* bytes,
+                                 size_t length,
+                                 const bloomFilter_t* vocabulary) {
+    size_t asciiLetters = 0;
+    size_t highBytes = 0;
+    for (size_t position = 0; position < length; position++) {
+        unsigned char byte = bytes[position];
+        highBytes += byte >= 0x80;
+        asciiLetters += (byte | 0x20) >= 'a' && (byte | 0x20) <= 'z';
+    }
+
+    encoding_t candidates[2] = {ENCODING_WINDOWS1252, ENCODING_WINDOWS1250};
+    if (highBytes > asciiLetters) {
+        candidates[0] = ENCODING_WINDOWS1251;
+        candidates[1] = ENCODING_KOI8R;
+    }
+
+    if (vocabulary) {
+        float first = getVocabularyShare(bytes, length, candidates[0], *vocabulary);
+        float second = getVocabularyShare(bytes, length, candidates[1], *vocabulary);
+        if (first != second)
+            return first > second ? candidates[0] : candidates[1];
+    }
+
+    return countWordLetters(bytes, length, candidates[1]) >
+                   countWordLetters(bytes, length, candidates[0])
+               ? candidates[1]
+               : candidates[0];
+}
+
+/**
+ * @name detectEncoding
+ * @brief Detects the encoding of a text from its first bytes (see TextEncoding.h).
+ *
+ * @param data The first bytes of the text (SCRIPT_DETECTION_BYTES are enough)
+ * @param length Number of bytes
+ * @param vocabulary Optional filter of the trigrams of the model, to pick the code page
+ * @return The encoding
+ */
+encoding_t detectEncoding(const char* data, size_t length, const bloomFilter_t* vocabulary) {
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+        return ENCODING_UTF8;
+    if (length >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE)
+        return ENCODING_UTF16LE;
+    if (length >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF)
+        return ENCODING_UTF16BE;
+
+    encoding_t encoding;
+    if (hasControlBytes(bytes, length) && detectUTF16(bytes, length, encoding))
+        return encoding;
+
+    if (isValidUTF8(bytes, length))
+        return ENCODING_UTF8;
+
+    return detectCodePage(bytes, length, vocabulary);
+}
+
+/**
+ * @name getEncodingName
+ * @brief Returns the name of an encoding.
+ *
+ * @param encoding The encoding
+ * @return Its name
+ */
+const char* getEncodingName(encoding_t encoding) {
+    static const char* ENCODING_NAMES[ENCODING_COUNT] = {
+        "UTF-8", "UTF-16LE", "UTF-16BE", "Windows-1250", "Windows-1251", "Windows-1252", "KOI8-R"};
+
+    return ENCODING_NAMES[encoding];
+}
+
+/**
+ * @name writeUTF16Unit
+ * @brief Converts a UTF-16 code unit, pairing surrogates. Unpaired surrogates become U+FFFD.
+ *
+ * @param transcoder The transcoder
+ * @param unit The code unit
+ * @param output The destination (at least 7 bytes)
+ * @return Number of bytes written
+ */
+static inline size_t writeUTF16Unit(transcoder_t& transcoder, uint32_t unit, char* output) {
+    size_t written = 0;
+
+    if (transcoder.highSurrogate) {
+        if (unit >= 0xDC00 && unit <= 0xDFFF) {
+            uint32_t codepoint =
+                0x10000 + ((transcoder.highSurrogate - 0xD800) << 10) + (unit - 0xDC00);
+            transcoder.highSurrogate = 0;
+            return encodeUTF8(codepoint, output);
+        }
+
+        written = encodeUTF8(0xFFFD, output);
+        transcoder.highSurrogate = 0;
+    }
+
+    if (unit >= 0xD800 && unit <= 0xDBFF) {
+        transcoder.highSurrogate = unit;
+        return written;
+    }
+    if (unit >= 0xDC00 && unit <= 0xDFFF)
+        unit = 0xFFFD;
+
+    bool isStart = transcoder.isStart;
+    transcoder.isStart = false;
+    if (isStart && unit == 0xFEFF)
+        return written;  // Byte order mark
+
+    return written + encodeUTF8(unit, output + written);
+}
+
+/**
+ * @name transcodeUTF16
+ * @brief Converts a chunk of UTF-16 text, 4 ASCII characters at a time when possible.
+ *
+ * @param transcoder The transcoder
+ * @param bytes The chunk
+ * @param length Number of bytes
+ * @param output The destination
+ * @return Number of bytes written
+ */
+static size_t transcodeUTF16(transcoder_t& transcoder,
+                             const unsigned char* bytes,
+                             size_t length,
+                             char* output) {
+    bool isBigEndian = transcoder.encoding == ENCODING_UTF16BE;
+    uint64_t nonASCII = loadWord(isBigEndian ? UTF16BE_NON_ASCII_BYTES : UTF16LE_NON_ASCII_BYTES);
+    size_t low = isBigEndian ? 1 : 0;
+    char* start = output;
+    size_t position = 0;
+
+    if (transcoder.pendingByte >= 0 && length) {
+        unsigned char first = (unsigned char)transcoder.pendingByte;
+        uint32_t unit = isBigEndian ? (first << 8 | bytes[0]) : (bytes[0] << 8 | first);
+        transcoder.pendingByte = -1;
+        output += writeUTF16Unit(transcoder, unit, output);
+        position = 1;
+    }
+
+    while (position + 1 < length) {
+        if (position + 8 <= length && !transcoder.highSurrogate && !transcoder.isStart &&
+            !(loadWord(bytes + position) & nonASCII)) {
+            for (size_t i = 0; i < 8; i += 2)
+                *output++ = (char)bytes[position + i + low];
+            position += 8;
+            continue;
+        }
+
+        uint32_t unit = isBigEndian ? (bytes[position] << 8 | bytes[position + 1])
+                                    : (bytes[position + 1] << 8 | bytes[position]);
+        output += writeUTF16Unit(transcoder, unit, output);
+        position += 2;
+    }
+
+    if (position < length)
+        transcoder.pendingByte = bytes[position];
+
+    return output - start;
+}
+
+/**
+ * @name transcodeToUTF8
+ * @brief Converts a chunk of text to UTF-8. Chunks may split characters; a byte order mark at
+ * the start of the text is dropped.
+ *
+ * @param transcoder The transcoder (encoding set, state kept between chunks)
+ * @param data The chunk
+ * @param length Number of bytes
+ * @param output The destination (at least TRANSCODED_MAX_BYTES(length) bytes)
+ * @return Number of bytes written
+ */
+size_t transcodeToUTF8(transcoder_t& transcoder, const char* data, size_t length, char* output) {
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    if (transcoder.encoding == ENCODING_UTF16LE || transcoder.encoding == ENCODING_UTF16BE)
+        return transcodeUTF16(transcoder, bytes, length, output);
+
+    size_t position = 0;
+    if (transcoder.isStart && length) {
+        transcoder.isStart = false;
+        if (transcoder.encoding == ENCODING_UTF8 && length >= 3 && bytes[0] == 0xEF &&
+            bytes[1] == 0xBB && bytes[2] == 0xBF)
+            position = 3;
+    }
+
+    if (transcoder.encoding == ENCODING_UTF8) {
+        memcpy(output, bytes + position, length - position);
+        return length - position;
+    }
+
+    char* start = output;
+    while (position < length) {
+        // Copies ASCII 8 bytes at a time
+        while (position + 8 <= length && !(loadWord(bytes + position) & WORD_HIGH_BITS)) {
+            memcpy(output, bytes + position, 8);
+            output += 8;
+            position += 8;
+        }
+
+        for (size_t end = position + 8 < length ? position + 8 : length; position < end;
+             position++)
+            output += encodeUTF8(getByteCodepoint(transcoder.encoding, bytes[position]), output);
+    }
+
+    return output - start;
+}
+
+/**
+ * @name transcodeText
+ * @brief Converts a whole text to UTF-8.
+ *
+ * @param text The text
+ * @param encoding Its encoding
+ * @param output The destination text
+ */
+void transcodeText(const std::string& text, encoding_t encoding, std::string& output) {
+    transcoder_t transcoder;
+    transcoder.encoding = encoding;
+
+    output.resize(TRANSCODED_MAX_BYTES(text.length()));
+    output.resize(transcodeToUTF8(transcoder, text.data(), text.length(), &output[0]));
+}
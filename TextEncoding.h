@@ -0,0 +1,62 @@
+/**
+ * @brief Lequel? character encoding detection and conversion to UTF-8
+ *
+ * Trigrams are extracted from UTF-8 text. Text in another encoding is recognized from its
+ * first bytes and converted in chunks before extraction:
+ * - A byte order mark names UTF-8, UTF-16LE or UTF-16BE.
+ * - Text with control bytes is UTF-16 when the bytes at one parity repeat a single value (the
+ *   high byte of the script, or 0 for Latin letters) and the other parity doesn't.
+ * - Valid UTF-8 is UTF-8; ASCII runs are checked 8 bytes at a time.
+ * - Otherwise the text uses a single-byte code page. Mostly non-ASCII letters mean Cyrillic
+ *   (Windows-1251 or KOI8-R), otherwise Latin (Windows-1252, which covers Latin-1, or
+ *   Windows-1250). Within the family, the code page whose non-ASCII trigrams the model
+ *   vocabulary knows best wins; without a vocabulary, the one that decodes more non-ASCII
+ *   bytes into lowercase letters continuing a word.
+ */
+
+#ifndef TEXTENCODING_H
+#define TEXTENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "BloomFilter.h"
+
+// encoding_t: character encoding of a text
+typedef enum {
+    ENCODING_UTF8 = 0,
+    ENCODING_UTF16LE,
+    ENCODING_UTF16BE,
+    ENCODING_WINDOWS1250,  // Central European
+    ENCODING_WINDOWS1251,  // Cyrillic
+    ENCODING_WINDOWS1252,  // Western European, a superset of the printable Latin-1 (ISO-8859-1)
+    ENCODING_KOI8R         // Russian
+} encoding_t;
+
+#define ENCODING_COUNT 7
+
+// Minimum share of the bytes at one parity holding the same value in UTF-16 text
+#define UTF16_REPEATED_SHARE 0.5f
+// Maximum share of the most repeated byte at the other parity
+#define UTF16_VARIED_SHARE 0.3f
+
+// Most bytes a conversion writes for length input bytes
+#define TRANSCODED_MAX_BYTES(length) (3 * (length) + 6)
+
+// transcoder_t: state of a text converted to UTF-8 in chunks
+struct transcoder_t {
+    encoding_t encoding = ENCODING_UTF8;
+    bool isStart = true;          // A byte order mark at the start is dropped
+    int pendingByte = -1;         // First byte of a UTF-16 code unit split between two chunks
+    uint32_t highSurrogate = 0;   // First half of a UTF-16 surrogate pair
+};
+
+// Functions
+encoding_t detectEncoding(const char* data, size_t length, const bloomFilter_t* vocabulary);
+const char* getEncodingName(encoding_t encoding);
+size_t transcodeToUTF8(transcoder_t& transcoder, const char* data, size_t length, char* output);
+void transcodeText(const std::string& text, encoding_t encoding, std::string& output);
+
+#endif
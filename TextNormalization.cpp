@@ -0,0 +1,130 @@
+/**
+ * @brief Lequel? text normalization fused with trigram extraction
+ *
+ * @cite https://www.unicode.org/charts/PDF/U0080.pdf
+ * @cite https://www.unicode.org/charts/PDF/U0100.pdf
+ * @cite https://www.unicode.org/charts/PDF/U0370.pdf
+ * @cite https://www.unicode.org/charts/PDF/U0400.pdf
+ * Latin-1, Latin Extended-A, Greek and Cyrillic case pairs
+ */
+
+#include "TextNormalization.h"
+
+/**
+ * @name foldPairs
+ * @brief Maps the uppercase letter of every upper/lowercase pair in a range to its
+ * lowercase letter.
+ *
+ * @param table The fold table
+ * @param first First codepoint of the range
+ * @param last Last codepoint of the range
+ * @param upperIsEven Whether uppercase letters have even codepoints in the range
+ */
+static void foldPairs(uint16_t* table, uint16_t first, uint16_t last, bool upperIsEven) {
+    for (uint16_t codepoint = first; codepoint <= last; codepoint++) {
+        if ((codepoint % 2 == 0) == upperIsEven)
+            table[codepoint] = codepoint + 1;
+    }
+}
+
+/**
+ * @name foldRange
+ * @brief Maps a range of codepoints by a constant offset.
+ *
+ * @param table The fold table
+ * @param first First codepoint of the range
+ * @param last Last codepoint of the range
+ * @param target Codepoint first maps to
+ */
+static void foldRange(uint16_t* table, uint16_t first, uint16_t last, uint16_t target) {
+    for (uint16_t codepoint = first; codepoint <= last; codepoint++)
+        table[codepoint] = target + (codepoint - first);
+}
+
+/**
+ * @name buildFoldTable
+ * @brief Builds the codepoint -> normalized codepoint table for 1 and 2-byte characters.
+ *
+ * @return The table
+ */
+static const uint16_t* buildFoldTable() {
+    static uint16_t table[FOLD_TABLE_SIZE];
+
+    for (uint16_t codepoint = 0; codepoint < FOLD_TABLE_SIZE; codepoint++)
+        table[codepoint] = codepoint;
+
+    // ASCII: everything but letters and the apostrophe (a letter in Guarani, Hawaiian, ...)
+    // is a separator
+    for (uint16_t codepoint = 0; codepoint < 0x80; codepoint++) {
+        bool isLetter = (unsigned int)((codepoint | 0x20) - 'a') < 26;
+        if (!isLetter && codepoint != '\'')
+            table[codepoint] = ' ';
+    }
+    foldRange(table, 'A', 'Z', 'a');
+
+    // Latin-1: controls, NBSP and symbols are separators, except ª µ º
+    for (uint16_t codepoint = 0x80; codepoint < 0xC0; codepoint++) {
+        if (codepoint != 0xAA && codepoint != 0xB5 && codepoint != 0xBA)
+            table[codepoint] = ' ';
+    }
+    foldRange(table, 0xC0, 0xDE, 0xE0);
+    table[0xD7] = ' ';  // ×
+    table[0xF7] = ' ';  // ÷
+
+    // Latin Extended-A
+    foldPairs(table, 0x100, 0x12F, true);
+    table[0x130] = 'i';  // İ
+    foldPairs(table, 0x132, 0x137, true);
+    foldPairs(table, 0x139, 0x148, false);
+    foldPairs(table, 0x14A, 0x177, true);
+    table[0x178] = 0xFF;  // Ÿ
+    foldPairs(table, 0x179, 0x17E, false);
+
+    // Latin Extended-B: Romanian, Livonian and other comma/macron letters
+    foldPairs(table, 0x200, 0x21F, true);
+    foldPairs(table, 0x222, 0x233, true);
+
+    // Greek
+    table[0x37E] = ' ';  // Question mark
+    table[0x387] = ' ';  // Ano teleia
+    table[0x386] = 0x3AC;
+    foldRange(table, 0x388, 0x38A, 0x3AD);
+    table[0x38C] = 0x3CC;
+    foldRange(table, 0x38E, 0x38F, 0x3CD);
+    foldRange(table, 0x391, 0x3A1, 0x3B1);
+    foldRange(table, 0x3A3, 0x3AB, 0x3C3);
+
+    // Cyrillic
+    foldRange(table, 0x400, 0x40F, 0x450);
+    foldRange(table, 0x410, 0x42F, 0x430);
+    foldPairs(table, 0x460, 0x481, true);
+    foldPairs(table, 0x48A, 0x4BF, true);
+    table[0x4C0] = 0x4CF;
+    foldPairs(table, 0x4C1, 0x4CE, false);
+    foldPairs(table, 0x4D0, 0x52F, true);
+
+    return table;
+}
+
+const uint16_t* FOLD_TABLE = buildFoldTable();
+
+/**
+ * @name foldTrigram
+ * @brief Normalizes a trigram read from a profile built before normalization existed.
+ *
+ * @param trigram The trigram
+ * @param folded The normalized trigram
+ * @return false if the trigram can't appear in normalized text (e.g. ", a" collapses into two
+ * characters)
+ */
+bool foldTrigram(const std::string& trigram, std::string& folded) {
+    unsigned int count = 0;
+
+    forEachTrigram(trigram, 0, trigram.length(), [&](const std::string& result, size_t) {
+        folded = result;
+        count++;
+        return true;
+    });
+
+    return count == 1;
+}
@@ -0,0 +1,140 @@
+/**
+ * @brief Lequel? text normalization fused with trigram extraction
+ *
+ * Trigrams are extracted from a single UTF-8 decoding pass that also lowercases Latin, Greek
+ * and Cyrillic letters and turns punctuation, digits and whitespace into a single space, so
+ * "IT WAS THE AGE" and "it was the age" produce the same trigrams. Everything is driven by
+ * one table indexed by codepoint, without a separate normalized copy of the text.
+ */
+
+#ifndef TEXTNORMALIZATION_H
+#define TEXTNORMALIZATION_H
+
+#include <stdint.h>
+
+#include <string>
+
+// Codepoints covered by the fold table (every 1 and 2-byte UTF-8 character)
+#define FOLD_TABLE_SIZE 0x800
+
+extern const uint16_t* FOLD_TABLE;
+
+/**
+ * @name foldCodepoint
+ * @brief Normalizes a single codepoint.
+ *
+ * @param codepoint The codepoint
+ * @return Its lowercase form, ' ' for separators
+ */
+inline uint32_t foldCodepoint(uint32_t codepoint) {
+    if (codepoint < FOLD_TABLE_SIZE)
+        return FOLD_TABLE[codepoint];
+
+    // General punctuation and CJK symbols
+    if ((codepoint >= 0x2000 && codepoint <= 0x206F) ||
+        (codepoint >= 0x3000 && codepoint <= 0x303F))
+        return ' ';
+
+    return codepoint;
+}
+
+// normalizedCharacter_t: a character of the normalized text
+struct normalizedCharacter_t {
+    char bytes[4];
+    unsigned char length;
+    size_t offset;  // Byte offset of the original character
+};
+
+/**
+ * @name forEachTrigram
+ * @brief Decodes, normalizes and splits a line into trigrams in one pass.
+ * Runs of separators count as a single space. Stray UTF-8 middle bytes are skipped and a
+ * truncated last character ends the line.
+ *
+ * @param text String of UTF-8 characters
+ * @param begin First byte of the line
+ * @param end One past the last byte of the line (without '\n')
+ * @param handler Called as handler(const std::string& trigram, size_t offset) for every
+ * trigram, offset being the byte offset of its first character in text. Returns false to stop
+ * @return false if the handler stopped the extraction
+ */
+template <typename TrigramHandler>
+bool forEachTrigram(const std::string& text, size_t begin, size_t end, TrigramHandler handler) {
+    thread_local std::string trigram;
+    normalizedCharacter_t window[3];
+    size_t characterCount = 0;
+    bool lastWasSpace = false;
+    const unsigned char* data = (const unsigned char*)text.data();
+
+    size_t position = begin;
+    while (position < end) {
+        unsigned char character = data[position];
+        uint32_t codepoint;
+        size_t characterLength;
+
+        if (!(character & 0b10000000)) {
+            codepoint = character;
+            characterLength = 1;
+        } else if ((character & 0b11100000) == 0b11000000) {
+            codepoint = character & 0b00011111;
+            characterLength = 2;
+        } else if ((character & 0b11110000) == 0b11100000) {
+            codepoint = character & 0b00001111;
+            characterLength = 3;
+        } else if ((character & 0b11111000) == 0b11110000) {
+            codepoint = character & 0b00000111;
+            characterLength = 4;
+        } else {
+            position++;  // Stray middle byte
+            continue;
+        }
+
+        if (position + characterLength > end)
+            break;
+
+        for (size_t i = 1; i < characterLength; i++)
+            codepoint = (codepoint << 6) | (data[position + i] & 0b00111111);
+
+        uint32_t folded = foldCodepoint(codepoint);
+        bool isSpace = folded == ' ';
+
+        if (isSpace && lastWasSpace) {
+            position += characterLength;
+            continue;
+        }
+        lastWasSpace = isSpace;
+
+        normalizedCharacter_t& output = window[characterCount % 3];
+        output.offset = position;
+        if (folded == codepoint) {
+            for (size_t i = 0; i < characterLength; i++)
+                output.bytes[i] = text[position + i];
+            output.length = (unsigned char)characterLength;
+        } else if (folded < 0x80) {
+            output.bytes[0] = (char)folded;
+            output.length = 1;
+        } else {
+            // The fold table only maps onto 2-byte characters
+            output.bytes[0] = (char)(0b11000000 | (folded >> 6));
+            output.bytes[1] = (char)(0b10000000 | (folded & 0b00111111));
+            output.length = 2;
+        }
+        position += characterLength;
+
+        if (++characterCount < 3)
+            continue;
+
+        trigram.clear();
+        for (size_t i = characterCount - 3; i < characterCount; i++)
+            trigram.append(window[i % 3].bytes, window[i % 3].length);
+
+        if (!handler(trigram, window[(characterCount - 3) % 3].offset))
+            return false;
+    }
+
+    return true;
+}
+
+bool foldTrigram(const std::string& trigram, std::string& folded);
+
+#endif
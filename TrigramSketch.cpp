@@ -0,0 +1,186 @@
+/**
+ * @brief Lequel? fixed-memory trigram counting
+ */
+
+#include "TrigramSketch.h"
+
+#include "BloomFilter.h"
+#include "TextNormalization.h"
+
+using namespace std;
+
+/**
+ * @name initTrigramSketch
+ * @brief Sizes an empty sketch.
+ *
+ * @param sketch The sketch
+ * @param counterBytes Memory of the count-min sketch
+ * @param topK Number of keys monitored
+ */
+void initTrigramSketch(trigramSketch_t& sketch, size_t counterBytes, size_t topK) {
+    sketch.width = counterBytes / (SKETCH_DEPTH * sizeof(uint32_t));
+    if (sketch.width == 0)
+        sketch.width = 1;
+    sketch.counters.assign(SKETCH_DEPTH * sketch.width, 0);
+
+    sketch.topK = topK;
+    sketch.heap.clear();
+    sketch.heap.reserve(topK);
+    sketch.heapPositions.clear();
+    sketch.heapPositions.reserve(topK);
+}
+
+/**
+ * @name swapHeapEntries
+ * @brief Swaps two heap entries and updates their positions.
+ *
+ * @param sketch The sketch
+ * @param a First position
+ * @param b Second position
+ */
+static void swapHeapEntries(trigramSketch_t& sketch, size_t a, size_t b) {
+    swap(sketch.heap[a], sketch.heap[b]);
+    sketch.heapPositions[sketch.heap[a].key] = a;
+    sketch.heapPositions[sketch.heap[b].key] = b;
+}
+
+/**
+ * @name siftUp
+ * @brief Moves an entry toward the root while it is smaller than its parent.
+ *
+ * @param sketch The sketch
+ * @param position The entry
+ */
+static void siftUp(trigramSketch_t& sketch, size_t position) {
+    while (position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (sketch.heap[parent].count <= sketch.heap[position].count)
+            break;
+
+        swapHeapEntries(sketch, parent, position);
+        position = parent;
+    }
+}
+
+/**
+ * @name siftDown
+ * @brief Moves an entry away from the root while it is larger than a child.
+ *
+ * @param sketch The sketch
+ * @param position The entry
+ */
+static void siftDown(trigramSketch_t& sketch, size_t position) {
+    size_t size = sketch.heap.size();
+
+    while (true) {
+        size_t smallest = position;
+        size_t left = 2 * position + 1;
+        size_t right = left + 1;
+
+        if (left < size && sketch.heap[left].count < sketch.heap[smallest].count)
+            smallest = left;
+        if (right < size && sketch.heap[right].count < sketch.heap[smallest].count)
+            smallest = right;
+        if (smallest == position)
+            break;
+
+        swapHeapEntries(sketch, smallest, position);
+        position = smallest;
+    }
+}
+
+/**
+ * @name addKeyToTrigramSketch
+ * @brief Counts a key.
+ * Conservative update: only the counters holding the current estimate grow, which keeps
+ * the overestimation from collisions low. A key that isn't monitored replaces the monitored
+ * key with the lowest count once its estimate is higher.
+ *
+ * @param sketch The sketch (initialized)
+ * @param key The key
+ * @param weight Amount added to its count
+ */
+void addKeyToTrigramSketch(trigramSketch_t& sketch, const std::string& key, uint32_t weight) {
+    uint64_t hash = hashBloomKey(key);
+    uint64_t step = (hash >> 32 | hash << 32) | 1;  // Double hashing, one row each
+    size_t cells[SKETCH_DEPTH];
+
+    uint32_t estimate = 0;
+    for (int row = 0; row < SKETCH_DEPTH; row++) {
+        cells[row] = row * sketch.width + (size_t)((hash + row * step) % sketch.width);
+        if (row == 0 || sketch.counters[cells[row]] < estimate)
+            estimate = sketch.counters[cells[row]];
+    }
+
+    estimate = weight > SKETCH_MAX_COUNT - estimate ? SKETCH_MAX_COUNT : estimate + weight;
+    for (int row = 0; row < SKETCH_DEPTH; row++) {
+        if (sketch.counters[cells[row]] < estimate)
+            sketch.counters[cells[row]] = estimate;
+    }
+
+    if (!sketch.topK)
+        return;
+
+    auto position = sketch.heapPositions.find(key);
+    if (position != sketch.heapPositions.end()) {
+        sketch.heap[position->second].count = estimate;
+        siftDown(sketch, position->second);
+    } else if (sketch.heap.size() < sketch.topK) {
+        sketchEntry_t entry = {key, estimate};
+        sketch.heap.push_back(entry);
+        sketch.heapPositions[key] = sketch.heap.size() - 1;
+        siftUp(sketch, sketch.heap.size() - 1);
+    } else if (estimate > sketch.heap[0].count) {
+        sketch.heapPositions.erase(sketch.heap[0].key);
+        sketch.heap[0].key = key;
+        sketch.heap[0].count = estimate;
+        sketch.heapPositions[key] = 0;
+        siftDown(sketch, 0);
+    }
+}
+
+/**
+ * @name addToTrigramSketch
+ * @brief Counts the trigrams of a text, normalized as in addToTrigramProfile.
+ *
+ * @param text String of UTF-8 characters
+ * @param sketch The sketch (initialized)
+ */
+void addToTrigramSketch(const std::string& text, trigramSketch_t& sketch) {
+    if (text.length() < 3)
+        return;
+
+    forEachTrigram(text, 0, text.length(), [&](const std::string& trigram, size_t) {
+        addKeyToTrigramSketch(sketch, trigram, 1);
+        return true;
+    });
+}
+
+/**
+ * @name addProfileToTrigramSketch
+ * @brief Counts every entry of a small profile (e.g. the code features of a line).
+ *
+ * @param profile The profile
+ * @param sketch The sketch (initialized)
+ */
+void addProfileToTrigramSketch(const TrigramProfile& profile, trigramSketch_t& sketch) {
+    for (auto& entry : profile)
+        addKeyToTrigramSketch(sketch, entry.first, (uint32_t)entry.second.real);
+}
+
+/**
+ * @name getSketchCounts
+ * @brief Copies the monitored keys and their estimated counts, which stay integers until the
+ * profile is written.
+ *
+ * @param sketch The sketch
+ * @param counts The destination key-count pairs
+ */
+void getSketchCounts(const trigramSketch_t& sketch,
+                     std::vector<std::pair<std::string, uint64_t>>& counts) {
+    counts.clear();
+    counts.reserve(sketch.heap.size());
+
+    for (auto& entry : sketch.heap)
+        counts.emplace_back(entry.key, entry.count);
+}
@@ -0,0 +1,56 @@
+/**
+ * @brief Lequel? fixed-memory trigram counting
+ *
+ * Counts the trigrams of an unbounded stream (a corpus, a long text) in constant memory: a
+ * count-min sketch estimates the count of every key and a table of the topK keys with the
+ * highest estimates, in the spirit of Space-Saving, keeps the heavy hitters a profile is
+ * made of. Estimates never fall below the true count.
+ *
+ * @cite http://dimacs.rutgers.edu/~graham/pubs/papers/cm-full.pdf
+ * count-min sketch (with conservative update)
+ * @cite https://www.cs.ucsb.edu/sites/default/files/documents/2005-23.pdf
+ * Space-Saving: frequent and top-k elements in data streams
+ */
+
+#ifndef TRIGRAMSKETCH_H
+#define TRIGRAMSKETCH_H
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Lequel.h"
+
+#define SKETCH_DEPTH 4  // Rows of the count-min sketch
+#define SKETCH_MAX_COUNT UINT32_MAX  // Counters saturate instead of wrapping around
+
+// sketchEntry_t: a monitored key and its estimated count
+struct sketchEntry_t {
+    std::string key;
+    uint32_t count;
+};
+
+// trigramSketch_t: count-min sketch plus the topK keys with the highest estimates
+struct trigramSketch_t {
+    std::vector<uint32_t> counters;  // SKETCH_DEPTH rows of width counters
+    size_t width = 0;
+    size_t topK = 0;
+    std::vector<sketchEntry_t> heap;  // Min-heap of the monitored keys by count
+    std::unordered_map<std::string, size_t> heapPositions;
+};
+
+void initTrigramSketch(trigramSketch_t& sketch, size_t counterBytes, size_t topK);
+
+void addKeyToTrigramSketch(trigramSketch_t& sketch, const std::string& key, uint32_t weight);
+
+void addToTrigramSketch(const std::string& text, trigramSketch_t& sketch);
+
+void addProfileToTrigramSketch(const TrigramProfile& profile, trigramSketch_t& sketch);
+
+void getSketchCounts(const trigramSketch_t& sketch,
+                     std::vector<std::pair<std::string, uint64_t>>& counts);
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ * @brief Unicode script detection
+ *
+ * @cite https://www.unicode.org/charts/
+ *
+ * @cite
+ * https://graphics.stanford.edu/~seander/bithacks.html#HasBetweenInWord
+ * SWAR byte range tests
+ */
+
+#include "UnicodeScript.h"
+
+#include <string.h>
+
+#define ASCII_MASK 0x8080808080808080ULL
+#define ONES 0x0101010101010101ULL
+
+// scriptRange_t: inclusive range of codepoints belonging to a script
+struct scriptRange_t {
+    uint32_t first;
+    uint32_t last;
+    script_t script;
+};
+
+// Sorted by first codepoint, for binary search
+static const scriptRange_t SCRIPT_RANGES[] = {
+    {0x0041, 0x005A, SCRIPT_LATIN},
+    {0x0061, 0x007A, SCRIPT_LATIN},
+    {0x00C0, 0x00D6, SCRIPT_LATIN},
+    {0x00D8, 0x00F6, SCRIPT_LATIN},
+    {0x00F8, 0x02AF, SCRIPT_LATIN},
+    {0x0370, 0x03E1, SCRIPT_GREEK},
+    {0x03E2, 0x03EF, SCRIPT_COPTIC},
+    {0x03F0, 0x03FF, SCRIPT_GREEK},
+    {0x0400, 0x052F, SCRIPT_CYRILLIC},
+    {0x0531, 0x058F, SCRIPT_ARMENIAN},
+    {0x0591, 0x05FF, SCRIPT_HEBREW},
+    {0x0600, 0x06FF, SCRIPT_ARABIC},
+    {0x0700, 0x074F, SCRIPT_SYRIAC},
+    {0x0750, 0x077F, SCRIPT_ARABIC},
+    {0x0900, 0x097F, SCRIPT_DEVANAGARI},
+    {0x0A80, 0x0AFF, SCRIPT_GUJARATI},
+    {0x0C00, 0x0C7F, SCRIPT_TELUGU},
+    {0x0C80, 0x0CFF, SCRIPT_KANNADA},
+    {0x0D00, 0x0D7F, SCRIPT_MALAYALAM},
+    {0x0E00, 0x0E7F, SCRIPT_THAI},
+    {0x1000, 0x109F, SCRIPT_MYANMAR},
+    {0x10A0, 0x10FF, SCRIPT_GEORGIAN},
+    {0x1100, 0x11FF, SCRIPT_HANGUL},
+    {0x1200, 0x139F, SCRIPT_ETHIOPIC},
+    {0x13A0, 0x13FF, SCRIPT_CHEROKEE},
+    {0x1400, 0x167F, SCRIPT_CANADIAN_SYLLABICS},
+    {0x1E00, 0x1EFF, SCRIPT_LATIN},
+    {0x1F00, 0x1FFF, SCRIPT_GREEK},
+    {0x2C80, 0x2CFF, SCRIPT_COPTIC},
+    {0x2D30, 0x2D7F, SCRIPT_TIFINAGH},
+    {0x3041, 0x30FF, SCRIPT_KANA},
+    {0x3130, 0x318F, SCRIPT_HANGUL},
+    {0x31F0, 0x31FF, SCRIPT_KANA},
+    {0x3400, 0x4DBF, SCRIPT_HAN},
+    {0x4E00, 0x9FFF, SCRIPT_HAN},
+    {0xAB70, 0xABBF, SCRIPT_CHEROKEE},
+    {0xAC00, 0xD7AF, SCRIPT_HANGUL},
+    {0xF900, 0xFAFF, SCRIPT_HAN},
+    {0xFB1D, 0xFB4F, SCRIPT_HEBREW},
+    {0xFB50, 0xFDFF, SCRIPT_ARABIC},
+    {0xFE70, 0xFEFF, SCRIPT_ARABIC},
+    {0xFF21, 0xFF3A, SCRIPT_LATIN},
+    {0xFF41, 0xFF5A, SCRIPT_LATIN},
+    {0xFF66, 0xFF9F, SCRIPT_KANA},
+};
+
+/**
+ * @name getCodepointScript
+ * @brief Finds the script of a Unicode codepoint.
+ *
+ * @param codepoint The codepoint
+ * @return The script, SCRIPT_UNKNOWN for non-letters and unlisted scripts
+ */
+script_t getCodepointScript(uint32_t codepoint) {
+    size_t low = 0;
+    size_t high = sizeof(SCRIPT_RANGES) / sizeof(SCRIPT_RANGES[0]);
+
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+
+        if (codepoint < SCRIPT_RANGES[middle].first)
+            high = middle;
+        else if (codepoint > SCRIPT_RANGES[middle].last)
+            low = middle + 1;
+        else
+            return SCRIPT_RANGES[middle].script;
+    }
+
+    return SCRIPT_UNKNOWN;
+}
+
+/**
+ * @name countAsciiLetters
+ * @brief Counts the ASCII letters in 8 ASCII bytes at once.
+ *
+ * @param word 8 bytes, all below 0x80
+ * @return Number of bytes in [A-Za-z]
+ */
+static inline unsigned int countAsciiLetters(uint64_t word) {
+    // Folds uppercase onto lowercase, then tests 'a' <= byte <= 'z' on every byte
+    uint64_t folded = word | (0x20 * ONES);
+    uint64_t atLeastA = folded + (0x80 - 'a') * ONES;
+    uint64_t aboveZ = folded + (0x80 - 'z' - 1) * ONES;
+
+    return __builtin_popcountll(atLeastA & ~aboveZ & ASCII_MASK);
+}
+
+/**
+ * @name countScripts
+ * @brief Counts the letters of each script in the first bytes of a UTF-8 text.
+ * Runs of ASCII are processed 8 bytes at a time.
+ *
+ * @param text String of UTF-8 characters
+ * @param maxBytes Maximum number of bytes to inspect
+ * @param counts Counters to add to
+ * @param weight Value added per letter
+ * @return Bytes inspected (always ends at a character boundary)
+ */
+size_t countScripts(const std::string& text,
+                    size_t maxBytes,
+                    scriptCounts_t& counts,
+                    float weight) {
+    const unsigned char* data = (const unsigned char*)text.data();
+    size_t length = text.length() < maxBytes ? text.length() : maxBytes;
+    size_t position = 0;
+    unsigned int asciiLetters = 0;
+
+    while (position < length) {
+        // ASCII fast path
+        if (position + 8 <= length) {
+            uint64_t word;
+            memcpy(&word, data + position, sizeof(word));
+            if (!(word & ASCII_MASK)) {
+                asciiLetters += countAsciiLetters(word);
+                position += 8;
+                continue;
+            }
+        }
+
+        unsigned char character = data[position];
+        uint32_t codepoint;
+        size_t characterLength;
+
+        if (!(character & 0b10000000)) {
+            if ((unsigned int)((character | 0x20) - 'a') < 26)
+                asciiLetters++;
+            position++;
+            continue;
+        } else if ((character & 0b11100000) == 0b11000000) {
+            codepoint = character & 0b00011111;
+            characterLength = 2;
+        } else if ((character & 0b11110000) == 0b11100000) {
+            codepoint = character & 0b00001111;
+            characterLength = 3;
+        } else if ((character & 0b11111000) == 0b11110000) {
+            codepoint = character & 0b00000111;
+            characterLength = 4;
+        } else {
+            position++;  // Stray middle byte
+            continue;
+        }
+
+        if (position + characterLength > length)
+            break;
+
+        for (size_t i = 1; i < characterLength; i++)
+            codepoint = (codepoint << 6) | (data[position + i] & 0b00111111);
+
+        counts.letters[getCodepointScript(codepoint)] += weight;
+        position += characterLength;
+    }
+
+    counts.letters[SCRIPT_LATIN] += asciiLetters * weight;
+
+    return position;
+}
+
+/**
+ * @name getDominantScript
+ * @brief Finds the script with most letters.
+ *
+ * @param counts The letter counters
+ * @param minShare Minimum fraction of all letters the dominant script must reach
+ * @return The dominant script, SCRIPT_UNKNOWN if there are no letters or no script reaches
+ * minShare
+ */
+script_t getDominantScript(const scriptCounts_t& counts, float minShare) {
+    float total = 0.0f;
+    float best = 0.0f;
+    int dominant = SCRIPT_UNKNOWN;
+
+    for (int script = SCRIPT_UNKNOWN + 1; script < SCRIPT_COUNT; script++) {
+        total += counts.letters[script];
+        if (counts.letters[script] > best) {
+            best = counts.letters[script];
+            dominant = script;
+        }
+    }
+
+    if (total == 0.0f || best < minShare * total)
+        return SCRIPT_UNKNOWN;
+
+    return (script_t)dominant;
+}
@@ -0,0 +1,60 @@
+/**
+ * @brief Unicode script detection
+ *
+ * @cite https://www.unicode.org/charts/
+ */
+
+#ifndef UNICODESCRIPT_H
+#define UNICODESCRIPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Bytes of input inspected to detect its script
+#define SCRIPT_DETECTION_BYTES 4096
+
+// script_t: writing systems found in the language profiles
+typedef enum {
+    SCRIPT_UNKNOWN = 0,  // Digits, punctuation, symbols and unlisted scripts
+    SCRIPT_LATIN,
+    SCRIPT_GREEK,
+    SCRIPT_CYRILLIC,
+    SCRIPT_ARMENIAN,
+    SCRIPT_HEBREW,
+    SCRIPT_ARABIC,
+    SCRIPT_SYRIAC,
+    SCRIPT_DEVANAGARI,
+    SCRIPT_GUJARATI,
+    SCRIPT_TELUGU,
+    SCRIPT_KANNADA,
+    SCRIPT_MALAYALAM,
+    SCRIPT_THAI,
+    SCRIPT_MYANMAR,
+    SCRIPT_GEORGIAN,
+    SCRIPT_HANGUL,
+    SCRIPT_ETHIOPIC,
+    SCRIPT_CHEROKEE,
+    SCRIPT_CANADIAN_SYLLABICS,
+    SCRIPT_COPTIC,
+    SCRIPT_TIFINAGH,
+    SCRIPT_KANA,
+    SCRIPT_HAN,
+    SCRIPT_COUNT
+} script_t;
+
+// scriptCounts_t: letters seen per script
+struct scriptCounts_t {
+    float letters[SCRIPT_COUNT] = {};
+};
+
+// Functions
+script_t getCodepointScript(uint32_t codepoint);
+size_t countScripts(const std::string& text,
+                    size_t maxBytes,
+                    scriptCounts_t& counts,
+                    float weight = 1.0f);
+script_t getDominantScript(const scriptCounts_t& counts, float minShare);
+
+#endif
@@ -6,11 +6,14 @@
  */
 
 #include <chrono>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <map>
 #include <string>
 
 #include "CSVData.h"
+#include "LanguageModelStore.h"
 #include "Lequel.h"
 #include "raylib.h"
 
@@ -28,71 +31,20 @@ struct buttons_t {
     Rectangle algoCosine;
     Rectangle algoJaccard;
     Rectangle algoCavnarTrenkle;
-#ifdef NORMAL_TOGGLE_ENABLE
+    Rectangle algoBayes;
     Rectangle toggleNormalize;
-#else
     Rectangle trigramLimit;
-#endif
     Rectangle lineLimit;
 };
 
-/**
- * @brief Loads trigram data.
- *
- * @param languageCodeNames Map of language code vs. language name (in i18n locale).
- * @param languages The trigram profiles.
- * @return true Succeeded
- * @return false Failed
- */
-bool loadLanguagesData(unordered_map<string, string>& languageCodeNames,
-                       LanguageProfiles& languages) {
-    // Reads available language codes
-    cout << "Reading language codes..." << endl;
-
-    CSVData languageCodesCSVData;
-    if (!readCSV(LANGUAGECODE_NAMES_FILE, languageCodesCSVData))
-        return false;
-
-    // Reads trigram profile for each language code
-    for (auto& fields : languageCodesCSVData) {
-        if (fields.size() != 2)
-            continue;
-
-        string languageCode = fields[0];
-        string languageName = fields[1];
-
-        languageCodeNames[languageCode] = languageName;
-
-        cout << "Reading trigram profile for language code \"" << languageCode << "\"..." << endl;
-
-        CSVData languageCSVData;
-        if (!readCSV(TRIGRAMS_PATH + languageCode + ".csv", languageCSVData))
-            return false;
-
-        languages.push_back(LanguageProfile());
-        LanguageProfile& language = languages.back();
-
-        language.languageCode = languageCode;
-
-        for (auto& fields : languageCSVData) {
-            if (fields.size() != 2)
-                continue;
-
-            string trigram = fields[0];
-            float frequency = (float)stoi(fields[1]);
-
-#ifdef NORMAL_TOGGLE_ENABLE
-            language.trigramProfile[trigram].real = frequency;
-#else
-            language.trigramProfile[trigram] = frequency;
-#endif
-        }
-
-        normalizeTrigramProfile(language.trigramProfile);
-    }
-
-    return true;
-}
+// identificationJob_t: an identification running on a background worker
+struct identificationJob_t {
+    std::shared_ptr<LanguageModel> model;  // Kept alive until the job is done, even on reload
+    std::future<std::string> result;
+    identificationProgress_t progress;
+    double timerStart = 0;  // Written by the worker, read once the result is ready
+    double timerEnd = 0;
+};
 
 /**
  * @name timestamp_millis
@@ -112,6 +64,45 @@ double timestamp_millis_high_resolution() {
     return ns.time_since_epoch().count() / 1000000.0;  // Convert ns to ms
 }
 
+/**
+ * @name startIdentification
+ * @brief Runs an identification on a background worker, so the window keeps redrawing.
+ * The timer only measures the identification itself.
+ *
+ * @param job The job to (re)start, must not be running
+ * @param model The language model to identify with
+ * @param identify The identification to run, receives the model and the job progress
+ */
+void startIdentification(
+    identificationJob_t& job,
+    std::shared_ptr<LanguageModel> model,
+    std::function<std::string(LanguageModel&, identificationProgress_t*)> identify) {
+    job.model = model;
+    job.progress.bytesProcessed = 0;
+    job.progress.bytesTotal = 0;
+    job.progress.leader = nullptr;
+    job.progress.cancelRequested = false;
+
+    job.result = std::async(std::launch::async, [&job, identify]() {
+        job.timerStart = timestamp_millis_high_resolution();
+        std::string languageCode = identify(*job.model, &job.progress);
+        job.timerEnd = timestamp_millis_high_resolution();
+        return languageCode;
+    });
+}
+
+/**
+ * @name isIdentificationRunning
+ * @brief Checks whether the job still has work in progress.
+ *
+ * @param job The job
+ * @return true if the result is not ready yet
+ */
+bool isIdentificationRunning(identificationJob_t& job) {
+    return job.result.valid() &&
+           job.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
 /**
  * @name setupButtons
  * @brief Sets the position, height and width for all buttons
@@ -145,17 +136,21 @@ void setupButtons(buttons_t& buttons) {
 
     buttons.lineLimit.x = buttons.algoCavnarTrenkle.x + buttons.algoCavnarTrenkle.width + 160;
 
-#ifdef NORMAL_TOGGLE_ENABLE
-    buttons.toggleNormalize.y = 220;
+    buttons.toggleNormalize.y = buttons.algoCavnarTrenkle.y;
     buttons.toggleNormalize.height = buttons.algoJaccard.height;
-    buttons.toggleNormalize.width = buttons.algoCavnarTrenkle.width - 45;
-    buttons.toggleNormalize.x = buttons.algoCavnarTrenkle.x;
-#else
+    buttons.toggleNormalize.width = buttons.algoCavnarTrenkle.width - 55;
+    buttons.toggleNormalize.x = buttons.algoJaccard.x + buttons.algoJaccard.width + 20;
+
     buttons.trigramLimit.y = 220;
     buttons.trigramLimit.height = buttons.algoJaccard.height;
     buttons.trigramLimit.width = buttons.algoCavnarTrenkle.width - 45;
     buttons.trigramLimit.x = buttons.algoCavnarTrenkle.x;
-#endif
+
+    // Between the limits: the first row is full
+    buttons.algoBayes.y = buttons.trigramLimit.y;
+    buttons.algoBayes.height = buttons.trigramLimit.height;
+    buttons.algoBayes.width = buttons.algoCosine.width;
+    buttons.algoBayes.x = buttons.trigramLimit.x + buttons.trigramLimit.width + 30;
 }
 
 /**
@@ -169,18 +164,18 @@ void drawButtons(buttons_t& buttons, settings_t& globalSettings) {
     Color CavTrenkle;
     Color Cosine;
     Color Jaccard;
+    Color Bayes = BROWN;
     static char lineBuffer[8];
     static char trigramBuffer[8];
     sprintf(lineBuffer, "%d", globalSettings.lineLimit);
-#ifndef NORMAL_TOGGLE_ENABLE
     sprintf(trigramBuffer, "%d", globalSettings.trigramLimit);
-#endif
 
     switch (globalSettings.algorithmSetting) {
         case ALGORITHM_CAVNARTRENKLE:
             DrawRectangleRec(buttons.algoCavnarTrenkle, BROWN);
             DrawRectangleLinesEx(buttons.algoCosine, LINE_WIDTH, BROWN);
             DrawRectangleLinesEx(buttons.algoJaccard, LINE_WIDTH, BROWN);
+            DrawRectangleLinesEx(buttons.algoBayes, LINE_WIDTH, BROWN);
             CavTrenkle = BEIGE;
             Cosine = BROWN;
             Jaccard = BROWN;
@@ -190,6 +185,7 @@ void drawButtons(buttons_t& buttons, settings_t& globalSettings) {
             DrawRectangleRec(buttons.algoCosine, BROWN);
             DrawRectangleLinesEx(buttons.algoCavnarTrenkle, LINE_WIDTH, BROWN);
             DrawRectangleLinesEx(buttons.algoJaccard, LINE_WIDTH, BROWN);
+            DrawRectangleLinesEx(buttons.algoBayes, LINE_WIDTH, BROWN);
             CavTrenkle = BROWN;
             Cosine = BEIGE;
             Jaccard = BROWN;
@@ -199,11 +195,23 @@ void drawButtons(buttons_t& buttons, settings_t& globalSettings) {
             DrawRectangleRec(buttons.algoJaccard, BROWN);
             DrawRectangleLinesEx(buttons.algoCavnarTrenkle, LINE_WIDTH, BROWN);
             DrawRectangleLinesEx(buttons.algoCosine, LINE_WIDTH, BROWN);
+            DrawRectangleLinesEx(buttons.algoBayes, LINE_WIDTH, BROWN);
             CavTrenkle = BROWN;
             Cosine = BROWN;
             Jaccard = BEIGE;
             break;
 
+        case ALGORITHM_NAIVE_BAYES:
+            DrawRectangleRec(buttons.algoBayes, BROWN);
+            DrawRectangleLinesEx(buttons.algoCavnarTrenkle, LINE_WIDTH, BROWN);
+            DrawRectangleLinesEx(buttons.algoCosine, LINE_WIDTH, BROWN);
+            DrawRectangleLinesEx(buttons.algoJaccard, LINE_WIDTH, BROWN);
+            CavTrenkle = BROWN;
+            Cosine = BROWN;
+            Jaccard = BROWN;
+            Bayes = BEIGE;
+            break;
+
         default:
             break;
     }
@@ -221,9 +229,9 @@ void drawButtons(buttons_t& buttons, settings_t& globalSettings) {
              CavTrenkle);
     DrawText("Coseno", buttons.algoCosine.x + 10, buttons.algoCosine.y + 10, 30, Cosine);
     DrawText("Jaccard", buttons.algoJaccard.x + 10, buttons.algoJaccard.y + 10, 30, Jaccard);
+    DrawText("Bayes", buttons.algoBayes.x + 10, buttons.algoBayes.y + 10, 30, Bayes);
 
-#ifdef NORMAL_TOGGLE_ENABLE
-    DrawText("Valores de frecuencia",
+    DrawText("Valores",
              buttons.toggleNormalize.x,
              buttons.toggleNormalize.y - 30,
              28,
@@ -239,9 +247,9 @@ void drawButtons(buttons_t& buttons, settings_t& globalSettings) {
     } else {
         DrawRectangleLinesEx(buttons.toggleNormalize, LINE_WIDTH, BROWN);
         DrawText(
-            "Reales", buttons.toggleNormalize.x + 60, buttons.toggleNormalize.y + 10, 30, BROWN);
+            "Reales", buttons.toggleNormalize.x + 55, buttons.toggleNormalize.y + 10, 30, BROWN);
     }
-#else
+
     DrawText("Límite de trigramas (scroll)",
              buttons.trigramLimit.x,
              buttons.trigramLimit.y - 30,
@@ -249,7 +257,6 @@ void drawButtons(buttons_t& buttons, settings_t& globalSettings) {
              BROWN);
     DrawRectangleLinesEx(buttons.trigramLimit, LINE_WIDTH, BROWN);
     DrawText(trigramBuffer, buttons.trigramLimit.x + 15, buttons.trigramLimit.y + 10, 30, BROWN);
-#endif
 
     DrawText("Límite de líneas (scroll)", buttons.lineLimit.x, buttons.lineLimit.y - 30, 28, BROWN);
     DrawRectangleLinesEx(buttons.lineLimit, LINE_WIDTH, BROWN);
@@ -257,9 +264,7 @@ void drawButtons(buttons_t& buttons, settings_t& globalSettings) {
 }
 
 int main(int, char*[]) {
-    // Swapped map for unordered_map
-    unordered_map<string, string> languageCodeNames;
-    LanguageProfiles languages;
+    languageModelStore_t store;
 
     settings_t globalSettings;
 
@@ -273,7 +278,7 @@ int main(int, char*[]) {
 
     float mouseWheel;
 
-    if (!loadLanguagesData(languageCodeNames, languages)) {
+    if (!initLanguageModelStore(store, LANGUAGECODE_NAMES_FILE, TRIGRAMS_PATH)) {
         cout << "Could not load trigram data." << endl;
         return 1;
     }
@@ -287,27 +292,74 @@ int main(int, char*[]) {
 
     string languageCode = "---";
 
+    identificationJob_t job;
+    std::future<bool> reload;  // Background model reload (F5)
+
+    // Escape cancels a running identification instead of closing the window
+    SetExitKey(KEY_NULL);
+
     while (!WindowShouldClose()) {
-        if (IsKeyPressed(KEY_V) && (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL) ||
-                                    IsKeyDown(KEY_LEFT_SUPER) || IsKeyDown(KEY_RIGHT_SUPER))) {
-            timer_start = timestamp_millis_high_resolution();
+        bool running = isIdentificationRunning(job);
+
+        if (!running && job.result.valid()) {
+            bool cancelled = job.progress.cancelRequested;
+            string result = job.result.get();
+
+            if (!cancelled) {
+                languageCode = result;
+                timer_start = job.timerStart;
+                timer_end = job.timerEnd;
+            }
+        }
+
+        if (running && IsKeyPressed(KEY_ESCAPE))
+            job.progress.cancelRequested = true;
+
+        // Reloads the language profiles without closing the window; identifications keep
+        // using the model they started with
+        bool reloading = reload.valid() &&
+                         reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+        if (!reloading && reload.valid() && !reload.get())
+            cout << "Could not reload trigram data." << endl;
+        if (!reloading && IsKeyPressed(KEY_F5)) {
+            reload = std::async(std::launch::async, reloadLanguageModel, std::ref(store));
+            reloading = true;
+        }
+
+        if (!running && IsKeyPressed(KEY_V) &&
+            (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL) ||
+             IsKeyDown(KEY_LEFT_SUPER) || IsKeyDown(KEY_RIGHT_SUPER))) {
             std::string clipboard = GetClipboardText();
-            languageCode = identifyLanguageFromClipboard(clipboard, languages, globalSettings);
-            timer_end = timestamp_millis_high_resolution();
+            settings_t settings = globalSettings;
+
+            startIdentification(
+                job,
+                acquireLanguageModel(store),
+                [clipboard, settings](LanguageModel& model,
+                                      identificationProgress_t* progress) mutable {
+                    return identifyLanguageFromClipboard(clipboard, model, settings, progress);
+                });
+            running = true;
         }
 
         if (IsFileDropped()) {
             FilePathList droppedFiles = LoadDroppedFiles();
-            timer_start = timestamp_millis_high_resolution();
-
-            if (droppedFiles.count == 1) {
-
-                languageCode =
-                    identifyLanguageFromPath(droppedFiles.paths[0], languages, globalSettings);
-                timer_end = timestamp_millis_high_resolution();
 
-                UnloadDroppedFiles(droppedFiles);
+            if (!running && droppedFiles.count == 1) {
+                std::string path = droppedFiles.paths[0];
+                settings_t settings = globalSettings;
+
+                startIdentification(
+                    job,
+                    acquireLanguageModel(store),
+                    [path, settings](LanguageModel& model,
+                                     identificationProgress_t* progress) mutable {
+                        return identifyLanguageFromPath(&path[0], model, settings, progress);
+                    });
+                running = true;
             }
+
+            UnloadDroppedFiles(droppedFiles);
         }
         if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
             mousePosition = GetMousePosition();
@@ -318,15 +370,24 @@ int main(int, char*[]) {
                 globalSettings.algorithmSetting = ALGORITHM_COSINE;
             else if (CheckCollisionPointRec(mousePosition, buttons.algoJaccard))
                 globalSettings.algorithmSetting = ALGORITHM_JACCARD;
-#ifdef NORMAL_TOGGLE_ENABLE
-            else if (CheckCollisionPointRec(mousePosition, buttons.toggleNormalize))
-                if (globalSettings.algorithmSetting != ALGORITHM_COSINE) {
-                    if (globalSettings.valueProcessingSetting == VALUE_NORMALIZE)
-                        globalSettings.valueProcessingSetting = VALUE_REAL;
-                    else
-                        globalSettings.valueProcessingSetting = VALUE_NORMALIZE;
-                }
-#endif
+            else if (CheckCollisionPointRec(mousePosition, buttons.algoBayes))
+                globalSettings.algorithmSetting = ALGORITHM_NAIVE_BAYES;
+            else if (CheckCollisionPointRec(mousePosition, buttons.toggleNormalize)) {
+                if (globalSettings.valueProcessingSetting == VALUE_NORMALIZE)
+                    globalSettings.valueProcessingSetting = VALUE_REAL;
+                else
+                    globalSettings.valueProcessingSetting = VALUE_NORMALIZE;
+            }
+        }
+
+        // Dropped files are read from the start, sampled across the whole file or read whole
+        if (IsKeyPressed(KEY_M)) {
+            if (globalSettings.samplingSetting == SAMPLING_NONE)
+                globalSettings.samplingSetting = SAMPLING_EVEN;
+            else if (globalSettings.samplingSetting == SAMPLING_EVEN)
+                globalSettings.samplingSetting = SAMPLING_FULL;
+            else
+                globalSettings.samplingSetting = SAMPLING_NONE;
         }
 
         if ((mouseWheel = GetMouseWheelMove())) {
@@ -357,7 +418,6 @@ int main(int, char*[]) {
                 if (globalSettings.lineLimit == 0)
                     globalSettings.lineLimit = 1;
             }
-#ifndef NORMAL_TOGGLE_ENABLE
             else if (CheckCollisionPointRec(mousePosition, buttons.trigramLimit)) {
                 if (mouseWheel > 0) {
                     if (globalSettings.trigramLimit < MIN_LIMIT)
@@ -384,31 +444,54 @@ int main(int, char*[]) {
                 if (globalSettings.trigramLimit == 0)
                     globalSettings.trigramLimit = 1;
             }
-#endif
         }
 
-#ifdef NORMAL_TOGGLE_ENABLE
-        if (globalSettings.algorithmSetting == ALGORITHM_COSINE)
-            globalSettings.valueProcessingSetting = VALUE_NORMALIZE;
-#endif
-
         BeginDrawing();
 
         ClearBackground(BEIGE);
 
         DrawText("Lequel?", 20, 10, 50, BROWN);
         DrawText("Copia y pega con Ctrl+V, o arrastra un archivo...", 20, 60, 20, BROWN);
+        if (reloading)
+            DrawText("Recargando idiomas...", 560, 60, 20, BROWN);
+        DrawText(globalSettings.samplingSetting == SAMPLING_NONE   ? "Archivos: inicio (M)"
+                 : globalSettings.samplingSetting == SAMPLING_FULL ? "Archivos: completos (M)"
+                                                                   : "Archivos: muestreo (M)",
+                 560,
+                 20,
+                 20,
+                 BROWN);
+
+        shared_ptr<LanguageModel> model = running ? job.model : acquireLanguageModel(store);
+        unordered_map<string, string>& languageCodeNames = model->languageCodeNames;
 
         string languageString;
-        if (languageCode != "---") {
-            if (languageCodeNames.find(languageCode) != languageCodeNames.end())
-                languageString = languageCodeNames[languageCode];
-            else
-                languageString = "Desconocido";
+        if (running) {
+            char progressBuffer[48];
+            sprintf(progressBuffer,
+                    "%zu / %zu KB",
+                    job.progress.bytesProcessed.load() / 1024,
+                    job.progress.bytesTotal.load() / 1024);
+
+            const string* leader = job.progress.leader.load();
+            if (leader && languageCodeNames.find(*leader) != languageCodeNames.end())
+                languageString = languageCodeNames[*leader];
+
+            DrawText("Procesando... (Esc para cancelar)", 20, 280, 24, BROWN);
+            DrawText(languageString.c_str(), 20, 310, 48, BROWN);
+            DrawText("Datos procesados:", 20, 365, 24, BROWN);
+            DrawText(progressBuffer, 20, 400, 36, BROWN);
+        } else {
+            if (languageCode != "---") {
+                if (languageCodeNames.find(languageCode) != languageCodeNames.end())
+                    languageString = languageCodeNames[languageCode];
+                else
+                    languageString = "Desconocido";
+            }
+            DrawText(languageString.c_str(), 20, 310, 48, BROWN);
         }
-        DrawText(languageString.c_str(), 20, 310, 48, BROWN);
 
-        if (timer_end != 0) {
+        if (!running && timer_end != 0) {
             char result[20];
             sprintf(result, "%.4f", timer_end - timer_start);
             DrawText("Resultado:", 20, 280, 24, BROWN);
@@ -421,6 +504,11 @@ int main(int, char*[]) {
         EndDrawing();
     }
 
+    if (job.result.valid()) {
+        job.progress.cancelRequested = true;
+        job.result.wait();
+    }
+
     CloseWindow();
 
     return 0;